@@ -0,0 +1,28 @@
+#include "Arena.h"
+#include "Argument.h"
+#include "BasicBlock.h"
+#include "Comdat.h"
+#include "Function.h"
+#include "GlobalAlias.h"
+#include "GlobalVariable.h"
+#include "Instruction.h"
+#include "MDNode.h"
+#include "StructType.h"
+
+namespace lb {
+
+Arena::Arena() : strings(bytes) {
+  ;
+}
+
+// The destructors of the allocators call the destructors of everything
+// allocated from them, so they must be instantiated where all the types are
+// complete
+Arena::~Arena() = default;
+
+llvm::StringRef
+Arena::save(llvm::StringRef s) {
+  return strings.save(s);
+}
+
+} // namespace lb
@@ -0,0 +1,73 @@
+#ifndef LLVM_BROWSE_ARENA_H
+#define LLVM_BROWSE_ARENA_H
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/StringSaver.h>
+
+#include <tuple>
+
+#include "Typedefs.h"
+
+namespace lb {
+
+class Argument;
+class BasicBlock;
+class Comdat;
+class Function;
+class GlobalAlias;
+class GlobalVariable;
+class Instruction;
+class MDNode;
+class StructType;
+
+// The memory for all the wrappers of a module. A large module has millions
+// of these and allocating each one separately is slow, both when the module
+// is loaded and when it is freed. Objects of the same kind are carved out of
+// the same slabs, so they also end up next to each other in memory which
+// helps when they are sorted or searched.
+//
+// The arena also keeps the tags of the entities. Most of them are slot
+// numbers and opcodes that repeat in every function, so each distinct tag is
+// only stored once.
+//
+// The objects are only destroyed when the arena is, which must happen after
+// anything that could refer to them has gone. Nothing allocated here can be
+// freed on its own
+//
+class alignas(ALIGN_OBJ) Arena {
+protected:
+  std::tuple<llvm::SpecificBumpPtrAllocator<Argument>,
+             llvm::SpecificBumpPtrAllocator<BasicBlock>,
+             llvm::SpecificBumpPtrAllocator<Comdat>,
+             llvm::SpecificBumpPtrAllocator<Function>,
+             llvm::SpecificBumpPtrAllocator<GlobalAlias>,
+             llvm::SpecificBumpPtrAllocator<GlobalVariable>,
+             llvm::SpecificBumpPtrAllocator<Instruction>,
+             llvm::SpecificBumpPtrAllocator<MDNode>,
+             llvm::SpecificBumpPtrAllocator<StructType>>
+      allocators;
+  llvm::BumpPtrAllocator bytes;
+  llvm::UniqueStringSaver strings;
+
+public:
+  Arena();
+  Arena(const Arena&) = delete;
+  Arena(Arena&&)      = delete;
+  virtual ~Arena();
+
+  // Uninitialized memory for one object of type T. The object must be
+  // constructed in it with placement new right away because the arena will
+  // call its destructor when it is destroyed
+  template<typename T>
+  void* allocate() {
+    return std::get<llvm::SpecificBumpPtrAllocator<T>>(allocators).Allocate();
+  }
+
+  // A copy of the string that lives as long as the arena
+  llvm::StringRef save(llvm::StringRef s);
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_ARENA_H
@@ -65,7 +65,8 @@ Argument::get_function() const {
 
 Argument&
 Argument::make(const llvm::Argument& llvm_a, Function& f, Module& module) {
-  auto* arg = new Argument(llvm_a, f, module);
+  void* mem = module.arena.allocate<Argument>();
+  auto* arg = new(mem) Argument(llvm_a, f, module);
   f.m_args.emplace_back(arg);
   module.vmap[&llvm_a] = arg;
   
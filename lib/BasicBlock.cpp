@@ -55,7 +55,8 @@ BasicBlock::has_source_info() const {
 
 BasicBlock&
 BasicBlock::make(const llvm::BasicBlock& llvm_bb, Function& f, Module& module) {
-  auto* bb = new BasicBlock(llvm_bb, f, module);
+  void* mem = module.arena.allocate<BasicBlock>();
+  auto* bb  = new(mem) BasicBlock(llvm_bb, f, module);
   f.m_blocks.emplace_back(bb);
   module.vmap[&llvm_bb] = bb;
 
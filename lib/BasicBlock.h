@@ -24,7 +24,7 @@ class BasicBlock :
     public INavigable,
     public IWrapper<llvm::BasicBlock> {
 protected:
-  std::vector<std::unique_ptr<Instruction>> m_insts;
+  std::vector<Instruction*> m_insts;
   Function& parent;
 
 public:
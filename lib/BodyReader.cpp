@@ -0,0 +1,240 @@
+#include "BodyReader.h"
+#include "Document.h"
+#include "Function.h"
+#include "Logging.h"
+#include "MDNode.h"
+#include "MetadataLinker.h"
+#include "Module.h"
+#include "Parser.h"
+
+#include <llvm/IR/Attributes.h>
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <set>
+#include <vector>
+
+using llvm::dyn_cast;
+
+namespace lb {
+
+BodyReader::BodyReader(Module& module, const LoadOptions& options) :
+    module(module), options(options) {
+  ;
+}
+
+void
+BodyReader::find_attribute_groups(llvm::StringRef text,
+                                  llvm::StringMap<unsigned>& groups,
+                                  Offset& at) const {
+  // Each group is printed on a line of its own as
+  //
+  //   attributes #<n> = { <attributes> }
+  //
+  at = 0;
+  for(Offset pos = 0; pos < text.size();) {
+    Offset eol = text.find('\n', pos);
+    if(eol == llvm::StringRef::npos)
+      eol = text.size();
+    llvm::StringRef line = text.slice(pos, eol);
+    if(line.consume_front("attributes #")) {
+      unsigned slot = 0;
+      line.consumeInteger(10, slot);
+      if(line.consume_front(" = { ") and line.consume_back(" }"))
+        groups[line] = slot;
+      at = eol + 1;
+    }
+    pos = eol + 1;
+  }
+}
+
+std::string
+BodyReader::print_attribute_groups(const llvm::Function& llvm_f,
+                                   llvm::StringMap<unsigned>& groups) const {
+  std::string s;
+  llvm::raw_string_ostream ss(s);
+  for(const llvm::BasicBlock& llvm_bb : llvm_f) {
+    for(const llvm::Instruction& llvm_inst : llvm_bb) {
+      const auto* call = dyn_cast<llvm::CallBase>(&llvm_inst);
+      if(not call)
+        continue;
+
+      llvm::AttributeSet attrs = call->getAttributes().getAttributes(
+          llvm::AttributeList::FunctionIndex);
+      if(not attrs.hasAttributes())
+        continue;
+
+      std::string printed = attrs.getAsString(true);
+      unsigned slot       = groups.size();
+      if(groups.try_emplace(printed, slot).second)
+        ss << "attributes #" << slot << " = { " << printed << " }\n";
+    }
+  }
+  ss.flush();
+
+  return s;
+}
+
+bool
+BodyReader::read(const Function& f) {
+  if(f.is_body_read())
+    return true;
+
+  message() << "Reading body of " << f.get_tag() << "\n";
+  Document& document   = *module.document;
+  const Fragment* frag = nullptr;
+  if(f.has_llvm_defn())
+    frag = document.get_fragment_at(f.get_llvm_defn().get_begin());
+  if(not frag or (frag->entity != &f)) {
+    critical() << "Could not find function in document: " << f.get_tag()
+               << "\n";
+    return false;
+  }
+  Offset f_begin = frag->begin;
+  Offset f_end   = frag->end;
+
+  // The attribute groups are in the text that follows the last function.
+  // If there are none yet, that text might not even be there
+  llvm::ArrayRef<Fragment> fragments = document.get_fragments();
+  unsigned last                      = fragments.size() - 1;
+  while(last and fragments[last].kind != FragmentKind::Function)
+    last--;
+  Offset t_begin = fragments[last].end;
+  Offset t_end   = t_begin;
+  if((last + 1 < fragments.size())
+     and (fragments[last + 1].kind == FragmentKind::Text))
+    t_end = fragments[last + 1].end;
+  std::string text = document.get_text(t_begin, t_end);
+  llvm::StringMap<unsigned> groups;
+  Offset at = 0;
+  find_attribute_groups(text, groups, at);
+  bool had_groups = groups.size();
+
+  // The module is owned by the wrapper, so it can be changed even though
+  // the wrapper only hands it out as const
+  llvm::Function& llvm_f = const_cast<llvm::Function&>(f.get_llvm());
+  unsigned num_md        = module.m_metadata.size();
+  if(llvm::Error err = llvm_f.materialize()) {
+    critical() << "Error reading function " << f.get_tag() << ": "
+               << llvm::toString(std::move(err)) << "\n";
+    return false;
+  }
+
+  // Printing the function numbers the metadata nodes that are new to the
+  // module after all the others, so they are printed after all the others
+  std::string body = document.print(llvm_f);
+  std::vector<const llvm::MDNode*> mds = document.get_metadata(num_md);
+  std::string added                    = print_attribute_groups(llvm_f, groups);
+  if(added.size() and not had_groups)
+    added.insert(0, "\n");
+  text.insert(at, added);
+
+  // LLVM separates the metadata nodes from whatever precedes them with a
+  // blank line
+  std::string md_text;
+  std::vector<Fragment> md_frags;
+  std::vector<std::pair<MDNode*, Offset>> md_defns;
+  if(mds.size() and not num_md)
+    md_text = "\n";
+  Offset size = document.get_size();
+  if(md_text.size())
+    md_frags.push_back(Fragment{FragmentKind::Text, size, size + 1, nullptr});
+  for(unsigned i = 0; i < mds.size(); i++) {
+    MDNode& md = MDNode::make(*mds[i], num_md + i, module);
+    md_defns.emplace_back(&md, md_text.size());
+    Offset begin = size + md_text.size();
+    md_text += document.print(*mds[i]);
+    md_frags.push_back(
+        Fragment{FragmentKind::Metadata, begin, size + md_text.size(), &md});
+  }
+
+  // If the document is a view over the IR, the IR is copied once with
+  // everything in place
+  Offset new_size = size - (f_end - f_begin) + body.size() + added.size()
+                    + md_text.size();
+  std::unique_ptr<llvm::WritableMemoryBuffer> ir(nullptr);
+  llvm::StringRef all;
+  if(not document.is_virtual()) {
+    ir = llvm::WritableMemoryBuffer::getNewUninitMemBuffer(
+        new_size, document.get_name());
+    char* out = ir->getBufferStart();
+    out       = document.copy(0, f_begin, out);
+    out       = std::copy(body.begin(), body.end(), out);
+    out       = document.copy(f_end, t_begin, out);
+    out       = std::copy(text.begin(), text.end(), out);
+    out       = document.copy(t_end, size, out);
+    std::copy(md_text.begin(), md_text.end(), out);
+    all = llvm::StringRef(ir->getBufferStart(), ir->getBufferSize());
+  }
+
+  // The changes are made from the end of the document backwards, so the
+  // offsets of the ones that are still to be made stay the same
+  if(md_text.size())
+    document.splice(size, size, md_text, md_frags, all);
+  if(added.size()) {
+    module.move(t_begin + at, t_begin + at, added.size());
+    document.splice(t_begin,
+                    t_end,
+                    text,
+                    {Fragment{FragmentKind::Text,
+                              t_begin,
+                              t_begin + text.size(),
+                              nullptr}},
+                    all);
+  }
+  module.move(f_begin, f_end, body.size());
+  document.splice(
+      f_begin,
+      f_end,
+      body,
+      {Fragment{FragmentKind::Function, f_begin, f_begin + body.size(), &f}},
+      all);
+
+  if(ir) {
+    module.buffer = std::move(ir);
+    if(module.md_linker)
+      module.md_linker->moved(all);
+  } else {
+    std::lock_guard<std::mutex> lock(module.assembling);
+    module.buffer.reset();
+  }
+
+  // The new metadata nodes are at the end of the document
+  Offset md_base = new_size - md_text.size();
+  for(const auto& i : md_defns) {
+    Offset begin = md_base + i.second;
+    module.add_definition(*i.first, begin, begin + i.first->get_tag().size());
+  }
+
+  Parser parser(options);
+  std::set<INavigable*> touched;
+  std::set<const llvm::MDNode*> reachable;
+  bool linked = parser.link_read(
+      llvm_f, body, f_begin, module, touched, reachable);
+
+  std::set<const llvm::MDNode*> fresh(mds.begin(), mds.end());
+  MetadataLinker md_linker(md_text, module, md_base);
+  for(const llvm::MDNode* md : reachable)
+    if(fresh.count(md))
+      md_linker.add(module.get(*md));
+  md_linker.link_all();
+
+  module.sort_late();
+  for(INavigable* n : touched)
+    n->sort_uses();
+  module.sort_functions();
+  for(const INavigable* n : {static_cast<const INavigable*>(&f),
+                             static_cast<const INavigable*>(f.get_comdat())}) {
+    auto it = n ? module.kept_defs.find(n) : module.kept_defs.end();
+    if(it != module.kept_defs.end())
+      it->second = Definition(
+          n->get_llvm_defn().get_begin(), n->get_llvm_defn().get_end(), *n);
+  }
+
+  if(not linked)
+    critical() << "Could not link body of function: " << f.get_tag() << "\n";
+  return linked;
+}
+
+} // namespace lb
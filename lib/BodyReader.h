@@ -0,0 +1,58 @@
+#ifndef LLVM_BROWSE_BODY_READER_H
+#define LLVM_BROWSE_BODY_READER_H
+
+#include "LoadOptions.h"
+#include "Typedefs.h"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/Function.h>
+
+#include <string>
+
+namespace lb {
+
+class Function;
+class Module;
+
+// Reads the bodies of functions into a module that was read lazily from
+// bitcode. The functions of such a module are printed with empty bodies.
+// When a body is read, only that function is materialized, printed and
+// linked and its text replaces the empty body in the document. The metadata
+// nodes and the attribute groups of the calls that are new to the module
+// are added where LLVM would print them if it printed the module again.
+// Everything after the function is moved instead of being linked again, so
+// nothing else is parsed or printed and the cost of reading a body does not
+// grow with the number of bodies that have been read.
+//
+class BodyReader {
+protected:
+  Module& module;
+  LoadOptions options;
+
+protected:
+  // Find the attribute groups in the text that follows the last function.
+  // They are keyed by what is printed between the braces. at is set to
+  // where the next one would go
+  void find_attribute_groups(llvm::StringRef text,
+                             llvm::StringMap<unsigned>& groups,
+                             Offset& at) const;
+
+  // The attribute groups of the calls in the function that have not been
+  // printed. They are numbered in the order in which they are first seen,
+  // which is the order in which LLVM numbers them
+  std::string print_attribute_groups(const llvm::Function& llvm_f,
+                                     llvm::StringMap<unsigned>& groups) const;
+
+public:
+  BodyReader(Module& module, const LoadOptions& options);
+  virtual ~BodyReader() = default;
+
+  // Read the body of the function into the module. Returns false if it
+  // could not be read or linked
+  bool read(const Function& f);
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_BODY_READER_H
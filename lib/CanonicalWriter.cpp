@@ -0,0 +1,65 @@
+#include "CanonicalWriter.h"
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instruction.h>
+#include <llvm/Support/FormattedStream.h>
+
+using llvm::isa;
+
+namespace lb {
+
+// The stream that is passed to the hooks wraps the stream that the module
+// is being printed to, so its position is the number of bytes printed so far
+
+void
+CanonicalWriter::emitFunctionAnnot(const llvm::Function* f,
+                                   llvm::formatted_raw_ostream& os) {
+  begins[f] = os.tell();
+}
+
+void
+CanonicalWriter::emitBasicBlockStartAnnot(const llvm::BasicBlock* bb,
+                                          llvm::formatted_raw_ostream& os) {
+  begins[bb] = os.tell();
+}
+
+void
+CanonicalWriter::emitBasicBlockEndAnnot(const llvm::BasicBlock* bb,
+                                        llvm::formatted_raw_ostream& os) {
+  ends[bb] = os.tell();
+}
+
+void
+CanonicalWriter::emitInstructionAnnot(const llvm::Instruction* inst,
+                                      llvm::formatted_raw_ostream& os) {
+  begins[inst] = os.tell();
+}
+
+void
+CanonicalWriter::printInfoComment(const llvm::Value& v,
+                                  llvm::formatted_raw_ostream& os) {
+  // This also gets called for global variables, but those are found using
+  // the declaration index
+  if(isa<llvm::Instruction>(v))
+    ends[&v] = os.tell();
+}
+
+Offset
+CanonicalWriter::get_begin(const llvm::Value& v) const {
+  auto it = begins.find(&v);
+  if(it != begins.end())
+    return it->second;
+  return llvm::StringRef::npos;
+}
+
+Offset
+CanonicalWriter::get_end(const llvm::Value& v) const {
+  auto it = ends.find(&v);
+  if(it != ends.end())
+    return it->second;
+  return llvm::StringRef::npos;
+}
+
+} // namespace lb
@@ -0,0 +1,55 @@
+#ifndef LLVM_BROWSE_CANONICAL_WRITER_H
+#define LLVM_BROWSE_CANONICAL_WRITER_H
+
+#include "Typedefs.h"
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/IR/AssemblyAnnotationWriter.h>
+
+namespace lb {
+
+// When the module is printed through this writer, it records the exact
+// offsets in the printed text at which every function, basic block and
+// instruction starts and ends. The writer does not add anything to the text
+// itself, so the output is identical to what would be printed without it.
+//
+// The offsets are only meaningful for the text printed by the most recent
+// call to llvm::Module::print() with this writer. They can be read
+// concurrently once printing is complete
+//
+class CanonicalWriter : public llvm::AssemblyAnnotationWriter {
+protected:
+  // For instructions, the beginning is the start of the line containing the
+  // instruction and the end is the position just after the last character
+  // of the instruction. For basic blocks, the beginning is the start of the
+  // line of the first instruction and the end is just past the newline
+  // at the end of the last instruction. For functions, only the beginning
+  // is recorded which is the start of the first line that is printed
+  // for the function
+  llvm::DenseMap<const llvm::Value*, Offset> begins;
+  llvm::DenseMap<const llvm::Value*, Offset> ends;
+
+public:
+  CanonicalWriter()          = default;
+  virtual ~CanonicalWriter() = default;
+
+  virtual void emitFunctionAnnot(const llvm::Function* f,
+                                 llvm::formatted_raw_ostream& os) override;
+  virtual void
+  emitBasicBlockStartAnnot(const llvm::BasicBlock* bb,
+                           llvm::formatted_raw_ostream& os) override;
+  virtual void emitBasicBlockEndAnnot(const llvm::BasicBlock* bb,
+                                      llvm::formatted_raw_ostream& os) override;
+  virtual void emitInstructionAnnot(const llvm::Instruction* inst,
+                                    llvm::formatted_raw_ostream& os) override;
+  virtual void printInfoComment(const llvm::Value& v,
+                                llvm::formatted_raw_ostream& os) override;
+
+  // These return llvm::StringRef::npos if the value was not printed
+  Offset get_begin(const llvm::Value& v) const;
+  Offset get_end(const llvm::Value& v) const;
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_CANONICAL_WRITER_H
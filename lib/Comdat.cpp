@@ -17,7 +17,7 @@ Comdat::Comdat(const llvm::Comdat& llvm_c,
     INavigable(EntityKind::Comdat),
     IWrapper<llvm::Comdat>(llvm_c, module),
     target(target) {
-  set_tag(llvm_c.getName(), "$");
+  set_tag(module.get_arena(), llvm_c.getName(), "$");
 }
 
 void
@@ -55,7 +55,8 @@ Comdat&
 Comdat::make(const llvm::Comdat& llvm_c,
              const llvm::GlobalObject& target,
              Module& module) {
-  auto* comdat = new Comdat(llvm_c, target, module);
+  void* mem    = module.arena.allocate<Comdat>();
+  auto* comdat = new(mem) Comdat(llvm_c, target, module);
   module.m_comdats.emplace_back(comdat);
   module.cmap[&llvm_c] = comdat;
 
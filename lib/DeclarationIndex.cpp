@@ -0,0 +1,121 @@
+#include "DeclarationIndex.h"
+#include "Lexer.h"
+#include "Token.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lb {
+
+void
+DeclarationIndex::add_definition(llvm::StringRef ir, Offset line) {
+  // Top-level definitions are always of the form <tag> = ...
+  Token name, equals;
+  Lexer lexer(ir, line);
+  if(not lexer.next(name) or not name.is_identifier()
+     or (name.get_begin() != line))
+    return;
+  if(not lexer.next(equals) or not equals.is(TokenKind::Equals))
+    return;
+
+  llvm::StringRef tag = name.get_text(ir);
+  unsigned slot       = 0;
+  if(name.is(TokenKind::Metadata)
+     and not tag.drop_front().getAsInteger(10, slot)) {
+    if(slot >= metadata.size())
+      metadata.resize(slot + 1, llvm::StringRef::npos);
+    metadata[slot] = line;
+  } else {
+    // If there are duplicates, which there shouldn't be, keep the first one
+    decls.insert(std::make_pair(tag, line));
+  }
+}
+
+void
+DeclarationIndex::add_function(llvm::StringRef ir, Offset line) {
+  // The function name is the first global identifier on the line. Everything
+  // before it is the linkage, attributes and return type, none of which
+  // can contain a global identifier. The lexer skips over string attributes
+  // so nothing inside them will be mistaken for the name
+  Token tok;
+  Lexer lexer(ir, line);
+  while(lexer.next(tok)) {
+    if(tok.is(TokenKind::Line))
+      return;
+    if(tok.is(TokenKind::Global)) {
+      decls.insert(std::make_pair(tok.get_text(ir), tok.get_begin()));
+      return;
+    }
+  }
+}
+
+void
+DeclarationIndex::build(llvm::StringRef ir) {
+  clear();
+
+  // memchr is much faster at finding newlines than a byte-at-a-time loop
+  // because the standard library will use whatever vector instructions are
+  // available. Everything we care about is at the start of a line, so
+  // the rest of the line never needs to be looked at
+  const char* data = ir.data();
+  Offset size      = ir.size();
+  Offset line      = 0;
+  while(line < size) {
+    switch(data[line]) {
+    case '%':
+    case '$':
+    case '@':
+    case '!':
+      add_definition(ir, line);
+      break;
+    case 'd':
+      if(ir.substr(line).startswith("define ")
+         or ir.substr(line).startswith("declare "))
+        add_function(ir, line);
+      break;
+    case '}':
+      braces.push_back(line);
+      break;
+    default:
+      break;
+    }
+
+    const void* eol = std::memchr(data + line, '\n', size - line);
+    if(not eol)
+      break;
+    line = static_cast<const char*>(eol) - data + 1;
+  }
+}
+
+void
+DeclarationIndex::clear() {
+  decls.clear();
+  metadata.clear();
+  braces.clear();
+}
+
+Offset
+DeclarationIndex::get(llvm::StringRef tag) const {
+  auto it = decls.find(tag);
+  if(it != decls.end())
+    return it->second;
+  return llvm::StringRef::npos;
+}
+
+Offset
+DeclarationIndex::get_metadata(unsigned slot) const {
+  if(slot < metadata.size())
+    return metadata[slot];
+  return llvm::StringRef::npos;
+}
+
+Offset
+DeclarationIndex::get_closing_brace(Offset begin) const {
+  // The lines are scanned in order, so the braces are already sorted
+  auto it = std::upper_bound(braces.begin(), braces.end(), begin);
+  if(it != braces.end())
+    return *it;
+  return llvm::StringRef::npos;
+}
+
+} // namespace lb
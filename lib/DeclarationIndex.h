@@ -0,0 +1,61 @@
+#ifndef LLVM_BROWSE_DECLARATION_INDEX_H
+#define LLVM_BROWSE_DECLARATION_INDEX_H
+
+#include "Typedefs.h"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+
+#include <vector>
+
+namespace lb {
+
+// An index of the top-level declarations in the IR. All the top-level
+// entities - struct types, comdats, global variables, aliases, functions and
+// metadata nodes - are defined at the start of a line, so a single scan over
+// the lines of the IR is enough to find all of them. Once the index is
+// built, finding the definition of any top-level entity is a constant time
+// lookup instead of a string search over the whole buffer.
+//
+// The keys are the tags of the entities exactly as they appear in the IR,
+// including the sigil (%, $, @ or !), so struct types, comdats and globals
+// can share a table without clashing. Metadata nodes are numbered densely,
+// so they are kept in a vector indexed by slot.
+//
+// The closing brace of a function body is the only thing on a line that
+// starts with a brace, so those are recorded too. This gives the extent of
+// every function without having to look inside it.
+//
+class DeclarationIndex {
+protected:
+  llvm::StringMap<Offset> decls;
+  std::vector<Offset> metadata;
+  std::vector<Offset> braces;
+
+protected:
+  void add_definition(llvm::StringRef ir, Offset line);
+  void add_function(llvm::StringRef ir, Offset line);
+
+public:
+  DeclarationIndex() = default;
+  virtual ~DeclarationIndex() = default;
+
+  // Scan the IR and record the offsets of all the top-level definitions.
+  // Any previous contents of the index are discarded. This only reads the
+  // IR, so it is safe to call while something else is parsing it
+  void build(llvm::StringRef ir);
+  void clear();
+
+  // These return llvm::StringRef::npos if the tag is not in the index.
+  // The tag must include the sigil
+  Offset get(llvm::StringRef tag) const;
+  Offset get_metadata(unsigned slot) const;
+
+  // Returns the offset of the first closing brace at the start of a line
+  // after begin or llvm::StringRef::npos if there isn't one
+  Offset get_closing_brace(Offset begin) const;
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_DECLARATION_INDEX_H
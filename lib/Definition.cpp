@@ -1,5 +1,4 @@
 #include "Definition.h"
-#include "Module.h"
 
 namespace lb {
 
@@ -25,15 +24,4 @@ Definition::get_defined() const {
   return *defined;
 }
 
-Definition&
-Definition::make(uint64_t begin,
-                 uint64_t end,
-                 const INavigable& defined,
-                 Module& module) {
-  auto* def = new Definition(begin, end, defined);
-  module.defs.emplace_back(def);
-
-  return *def;
-}
-
-} // namespace lb
\ No newline at end of file
+} // namespace lb
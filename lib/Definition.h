@@ -8,25 +8,26 @@
 namespace lb {
 
 class INavigable;
-class Module;
 
 // This corresponds to a definition for a single entity in the IR.
 // It contains the begin and end offsets of the definition within the IR
-// as well as the entity to which that corresponds to that definition
+// as well as the entity to which that corresponds to that definition.
+// Like a Use, the module doesn't keep these as objects. The range is kept
+// in the entity and in the tables of the module and a Definition is made
+// from them when it is asked for
 class alignas(ALIGN_OBJ) Definition {
 protected:
   uint64_t begin;
   uint64_t end;
   const INavigable* defined;
 
-protected:
+public:
   Definition(uint64_t begin, uint64_t end, const INavigable& defined);
+  Definition()                  = delete;
+  Definition(const Definition&) = default;
+  ~Definition()                 = default;
 
-public:
-  Definition()             = delete;
-  Definition(Definition&)  = delete;
-  Definition(Definition&&) = delete;
-  virtual ~Definition()    = default;
+  Definition& operator=(const Definition&) = default;
 
   uint64_t get_begin() const;
   uint64_t get_end() const;
@@ -39,12 +40,8 @@ public:
   operator bool() const {
     return (begin > 0) and (end > 0);
   }
-
-public:
-  static Definition&
-  make(uint64_t begin, uint64_t end, const INavigable& defined, Module& module);
 };
 
 } // namespace lb
 
-#endif // LLVM_BROWSE_DEFINITION_H
\ No newline at end of file
+#endif // LLVM_BROWSE_DEFINITION_H
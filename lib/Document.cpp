@@ -0,0 +1,463 @@
+#include "Document.h"
+#include "Function.h"
+#include "GlobalVariable.h"
+#include "Logging.h"
+#include "MDNode.h"
+#include "Module.h"
+
+#include <llvm/ADT/Hashing.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <tuple>
+
+using llvm::cast;
+
+namespace lb {
+
+constexpr Offset Document::NOT_KEPT;
+
+static bool
+has_unread_bodies(const llvm::Module& llvm) {
+  for(const llvm::Function& f : llvm.functions())
+    if(f.isMaterializable())
+      return true;
+  return false;
+}
+
+Document::Document(const llvm::Module& llvm,
+                   llvm::StringRef name,
+                   llvm::StringRef text,
+                   Offset budget) :
+    llvm(llvm),
+    name(name.str()),
+    size(text.size()),
+    text(text),
+    slots(new llvm::ModuleSlotTracker(&llvm, not has_unread_bodies(llvm))),
+    cached_size(0),
+    budget(budget) {
+  ;
+}
+
+static Offset
+get_line_end(llvm::StringRef text, Offset pos) {
+  Offset eol = text.find('\n', pos);
+  if(eol == llvm::StringRef::npos)
+    return text.size();
+  return eol + 1;
+}
+
+// The start of the line that ends just before pos
+static Offset
+get_prev_line_begin(llvm::StringRef text, Offset pos) {
+  if(not pos)
+    return 0;
+  return text.rfind('\n', pos - 1) + 1;
+}
+
+void
+Document::split(const Module& module, llvm::StringRef text) {
+  std::vector<Fragment> found;
+  auto add_line = [&](FragmentKind kind, const INavigable& n) {
+    if(n.has_llvm_defn()) {
+      Offset begin = text.rfind('\n', n.get_llvm_defn().get_begin()) + 1;
+      found.push_back(Fragment{kind, begin, get_line_end(text, begin), &n});
+    }
+  };
+
+  for(const GlobalVariable& g : module.globals())
+    add_line(FragmentKind::Global, g);
+  for(const MDNode& md : module.metadata())
+    add_line(FragmentKind::Metadata, md);
+  auto add_function = [&](const Function& f) {
+    if(not f.has_llvm_defn())
+      return;
+
+    // LLVM prints a blank line and the comments about the attributes
+    // before every function, so they belong to the function
+    Offset begin = text.rfind('\n', f.get_llvm_defn().get_begin()) + 1;
+    while(begin) {
+      Offset prev = get_prev_line_begin(text, begin);
+      if(not text.substr(prev).startswith(";"))
+        break;
+      begin = prev;
+    }
+    if(begin and get_prev_line_begin(text, begin) == begin - 1)
+      begin -= 1;
+
+    Offset last = f.get_llvm_defn().get_begin();
+    if(f.has_llvm_span())
+      last = f.get_llvm_span().get_end();
+    found.push_back(Fragment{
+        FragmentKind::Function, begin, get_line_end(text, last), &f});
+  };
+  for(const Function& f : module.functions())
+    add_function(f);
+  for(const Function& f : module.decls())
+    add_function(f);
+
+  std::sort(found.begin(),
+            found.end(),
+            [](const Fragment& l, const Fragment& r) {
+              return std::tie(l.begin, l.end) < std::tie(r.begin, r.end);
+            });
+
+  // Whatever is not covered by an entity is text. Anything that overlaps
+  // an entity that is already in the document is left as part of it
+  Offset pos = 0;
+  for(const Fragment& f : found) {
+    if(f.begin < pos)
+      continue;
+    if(f.begin > pos)
+      fragments.push_back(Fragment{fragments.empty() ? FragmentKind::Header
+                                                     : FragmentKind::Text,
+                                   pos,
+                                   f.begin,
+                                   nullptr});
+    fragments.push_back(f);
+    pos = f.end;
+  }
+  if(pos < size or fragments.empty())
+    fragments.push_back(Fragment{fragments.empty() ? FragmentKind::Header
+                                                   : FragmentKind::Text,
+                                 pos,
+                                 size,
+                                 nullptr});
+}
+
+void
+Document::keep(llvm::StringRef text) {
+  // Only global variables, functions and metadata nodes can be printed on
+  // their own. Printing them all to check that they come out the same would
+  // take far longer than printing the module did because LLVM walks the
+  // whole module every time something is printed, so they are only checked
+  // against the hash when they are printed again
+  stored.resize(fragments.size(), NOT_KEPT);
+  hashes.resize(fragments.size(), 0);
+  for(unsigned i = 0; i < fragments.size(); i++) {
+    const Fragment& f    = fragments[i];
+    llvm::StringRef orig = text.slice(f.begin, f.end);
+    if(f.entity) {
+      hashes[i] = llvm::hash_value(orig);
+    } else {
+      stored[i] = kept.size();
+      kept.append(orig.begin(), orig.end());
+    }
+  }
+  kept.shrink_to_fit();
+  message() << "Kept " << kept.size() << " of " << size << " bytes of IR\n";
+}
+
+unsigned
+Document::find(Offset offset) const {
+  auto it = std::upper_bound(
+      fragments.begin(),
+      fragments.end(),
+      offset,
+      [](Offset offset, const Fragment& f) { return offset < f.begin; });
+  return std::distance(fragments.begin(), it) - 1;
+}
+
+std::string
+Document::print(unsigned idx) const {
+  const Fragment& f = fragments[idx];
+  std::string s;
+  llvm::raw_string_ostream ss(s);
+  switch(f.kind) {
+  case FragmentKind::Function:
+    print(ss, cast<Function>(f.entity)->get_llvm());
+    break;
+  case FragmentKind::Global:
+    static_cast<const llvm::Value&>(
+        cast<GlobalVariable>(f.entity)->get_llvm())
+        .print(ss, *slots);
+    ss << "\n";
+    break;
+  case FragmentKind::Metadata:
+    print(ss, cast<MDNode>(f.entity)->get_llvm());
+    break;
+  default:
+    break;
+  }
+  ss.flush();
+
+  return s;
+}
+
+void
+Document::print(llvm::raw_ostream& os, const llvm::Function& f) const {
+  // llvm::Function::print() hides the overload that takes a slot tracker
+  os << "\n";
+  static_cast<const llvm::Value&>(f).print(os, *slots);
+}
+
+void
+Document::print(llvm::raw_ostream& os, const llvm::MDNode& md) const {
+  md.print(os, *slots, &llvm);
+  os << "\n";
+}
+
+llvm::StringRef
+Document::get(unsigned idx) const {
+  const Fragment& f = fragments[idx];
+  if(not is_virtual())
+    return text.slice(f.begin, f.end);
+  if(stored[idx] != NOT_KEPT)
+    return llvm::StringRef(kept).substr(stored[idx], f.end - f.begin);
+
+  auto it = cached.find(idx);
+  if(it != cached.end()) {
+    printed.splice(printed.begin(), printed, it->second);
+    return printed.front().second;
+  }
+
+  std::string s = print(idx);
+  if(s.size() != f.end - f.begin
+     or static_cast<size_t>(llvm::hash_value(s)) != hashes[idx]) {
+    // This should never happen, but if LLVM prints the fragment differently
+    // on its own than it did as part of the module, the whole module is
+    // printed again and the fragment is kept from then on
+    warning() << "Fragment at " << f.begin << " could not be printed again. "
+              << "Printing module\n";
+    std::string all;
+    llvm::raw_string_ostream ss(all);
+    llvm.print(ss, nullptr);
+    ss.flush();
+    stored[idx] = kept.size();
+    kept.append(all, f.begin, f.end - f.begin);
+    return llvm::StringRef(kept).substr(stored[idx], f.end - f.begin);
+  }
+
+  printed.emplace_front(idx, std::move(s));
+  cached[idx] = printed.begin();
+  cached_size += printed.front().second.size();
+
+  // The fragment that was just printed is never dropped, however large it
+  // is, because the caller is about to use it
+  while(cached_size > budget and printed.size() > 1) {
+    cached_size -= printed.back().second.size();
+    cached.erase(printed.back().first);
+    printed.pop_back();
+  }
+
+  return printed.front().second;
+}
+
+template<typename F>
+void
+Document::visit(Offset begin, Offset end, F f) const {
+  end = std::min(end, size);
+  if(begin >= end)
+    return;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for(unsigned i = find(begin);
+      i < fragments.size() and fragments[i].begin < end;
+      i++) {
+    const Fragment& frag = fragments[i];
+    Offset from          = std::max(begin, frag.begin) - frag.begin;
+    Offset to            = std::min(end, frag.end) - frag.begin;
+    f(get(i).slice(from, to));
+  }
+}
+
+llvm::StringRef
+Document::get_name() const {
+  return name;
+}
+
+Offset
+Document::get_size() const {
+  return size;
+}
+
+bool
+Document::is_virtual() const {
+  return not stored.empty();
+}
+
+llvm::ArrayRef<Fragment>
+Document::get_fragments() const {
+  return fragments;
+}
+
+const Fragment*
+Document::get_fragment_at(Offset offset) const {
+  if(offset >= size)
+    return nullptr;
+  return &fragments[find(offset)];
+}
+
+Offset
+Document::get_line_begin(Offset offset) const {
+  if(offset >= size)
+    offset = size ? size - 1 : 0;
+  if(not size)
+    return 0;
+
+  // Every fragment starts at the beginning of a line, so the line cannot
+  // start in an earlier fragment
+  std::lock_guard<std::mutex> lock(mutex);
+  unsigned idx      = find(offset);
+  const Fragment& f = fragments[idx];
+  if(offset == f.begin)
+    return offset;
+  Offset nl = get(idx).rfind('\n', offset - f.begin);
+  if(nl == llvm::StringRef::npos)
+    return f.begin;
+  return f.begin + nl + 1;
+}
+
+std::string
+Document::get_text(Offset begin, Offset end) const {
+  std::string s;
+  visit(begin, end, [&s](llvm::StringRef piece) {
+    s.append(piece.begin(), piece.end());
+  });
+  return s;
+}
+
+char*
+Document::copy(Offset begin, Offset end, char* out) const {
+  visit(begin, end, [&out](llvm::StringRef piece) {
+    out = std::copy(piece.begin(), piece.end(), out);
+  });
+  return out;
+}
+
+bool
+Document::equals(Offset begin, Offset end, llvm::StringRef other) const {
+  if(end > size or begin > end or end - begin != other.size())
+    return false;
+
+  bool same = true;
+  visit(begin, end, [&same, &other](llvm::StringRef piece) {
+    same  = same and other.startswith(piece);
+    other = other.drop_front(piece.size());
+  });
+  return same;
+}
+
+void
+Document::drop() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  printed.clear();
+  cached.clear();
+  cached_size = 0;
+}
+
+std::string
+Document::print(const llvm::Function& f) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::string s;
+  llvm::raw_string_ostream ss(s);
+  print(ss, f);
+  ss.flush();
+  return s;
+}
+
+std::string
+Document::print(const llvm::MDNode& md) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::string s;
+  llvm::raw_string_ostream ss(s);
+  print(ss, md);
+  ss.flush();
+  return s;
+}
+
+std::vector<const llvm::MDNode*>
+Document::get_metadata(unsigned slot) const {
+  std::vector<const llvm::MDNode*> mds;
+#if LLVM_VERSION_MAJOR >= 13
+  std::lock_guard<std::mutex> lock(mutex);
+  llvm::ModuleSlotTracker::MachineMDNodeListType found;
+  slots->getMachine();
+  slots->collectMDNodes(found, slot, ~0U);
+  std::sort(found.begin(), found.end());
+  for(const auto& i : found)
+    mds.push_back(i.second);
+#endif // LLVM_VERSION_MAJOR >= 13
+  return mds;
+}
+
+void
+Document::splice(Offset begin,
+                 Offset end,
+                 llvm::StringRef text,
+                 llvm::ArrayRef<Fragment> added,
+                 llvm::StringRef all) {
+  std::lock_guard<std::mutex> lock(mutex);
+  unsigned first = begin < size ? find(begin) : fragments.size();
+  unsigned last  = end < size ? find(end) : fragments.size();
+  auto moved     = [&](Offset o) { return o - end + begin + text.size(); };
+
+  std::vector<Fragment> spliced(fragments.begin(), fragments.begin() + first);
+  spliced.insert(spliced.end(), added.begin(), added.end());
+  for(unsigned i = last; i < fragments.size(); i++) {
+    const Fragment& f = fragments[i];
+    spliced.push_back(
+        Fragment{f.kind, moved(f.begin), moved(f.end), f.entity});
+  }
+
+  if(is_virtual()) {
+    // The text of the fragments that were replaced stays in kept. That is
+    // only ever a few lines of attribute groups and the like
+    std::vector<Offset> new_stored(stored.begin(), stored.begin() + first);
+    std::vector<size_t> new_hashes(hashes.begin(), hashes.begin() + first);
+    for(const Fragment& f : added) {
+      llvm::StringRef orig = text.slice(f.begin - begin, f.end - begin);
+      if(f.entity) {
+        new_stored.push_back(NOT_KEPT);
+        new_hashes.push_back(llvm::hash_value(orig));
+      } else {
+        new_stored.push_back(kept.size());
+        new_hashes.push_back(0);
+        kept.append(orig.begin(), orig.end());
+      }
+    }
+    new_stored.insert(new_stored.end(), stored.begin() + last, stored.end());
+    new_hashes.insert(new_hashes.end(), hashes.begin() + last, hashes.end());
+    stored.swap(new_stored);
+    hashes.swap(new_hashes);
+
+    // The printed fragments are cached by their index, which may have
+    // changed
+    printed.clear();
+    cached.clear();
+    cached_size = 0;
+  } else {
+    this->text = all;
+  }
+  fragments.swap(spliced);
+  size = size - (end - begin) + text.size();
+}
+
+std::unique_ptr<Document>
+Document::create(const Module& module,
+                 llvm::StringRef name,
+                 llvm::StringRef text) {
+  std::unique_ptr<Document> document(
+      new Document(module.get_llvm(), name, text, 0));
+  document->split(module, text);
+
+  return document;
+}
+
+std::unique_ptr<Document>
+Document::create_virtual(const Module& module,
+                         llvm::StringRef name,
+                         llvm::StringRef text,
+                         Offset budget) {
+  message() << "Creating virtual document\n";
+  std::unique_ptr<Document> document(
+      new Document(module.get_llvm(), name, llvm::StringRef(), budget));
+  document->size = text.size();
+  document->split(module, text);
+  document->keep(text);
+
+  return document;
+}
+
+} // namespace lb
@@ -0,0 +1,200 @@
+#ifndef LLVM_BROWSE_DOCUMENT_H
+#define LLVM_BROWSE_DOCUMENT_H
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/ModuleSlotTracker.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Typedefs.h"
+
+namespace lb {
+
+class INavigable;
+class Module;
+
+enum class FragmentKind {
+  // Everything before the first global variable, function or metadata
+  // node: the target, the struct types and so on
+  Header,
+  Global,
+  Function,
+  Metadata,
+  // Whatever is between the other fragments. This is usually blank lines,
+  // attribute groups and named metadata
+  Text,
+};
+
+// A contiguous range of lines in the IR. The fragments of a document always
+// start at the beginning of a line and cover all of the text without
+// overlapping
+struct Fragment {
+  FragmentKind kind;
+  Offset begin;
+  Offset end;
+
+  // The global variable, function or metadata node printed in the fragment.
+  // This is nullptr for the header and for text fragments
+  const INavigable* entity;
+};
+
+// The text of a module split into fragments. Every offset in the module is
+// an offset into the document, but the document need not keep the text.
+//
+// When the IR is printed by LLVM - because the file is bitcode or it is
+// loaded in canonical mode or with passes - the text of a function, a
+// global variable or a metadata node can be printed again from the LLVM
+// module exactly as it was the first time. Such a document is virtual. Only
+// the fragments that cannot be printed on their own are kept. The others
+// are printed when they are asked for and the most recently used are kept
+// until they add up to more than the budget. So the memory needed is
+// proportional to what is being looked at and not to the size of the
+// module. Everything that reads the text of a module must go through the
+// document since the text as a whole is only ever assembled on request.
+//
+// Otherwise, the document is just a view over the text from which the
+// module was linked and must not outlive it
+//
+class alignas(ALIGN_OBJ) Document {
+protected:
+  static constexpr Offset NOT_KEPT = ~static_cast<Offset>(0);
+
+  const llvm::Module& llvm;
+  std::string name;
+  Offset size;
+  std::vector<Fragment> fragments;
+
+  // If the document is not virtual, this is all of the text
+  llvm::StringRef text;
+
+  // The offset in kept of the text of each fragment or NOT_KEPT if the
+  // fragment is printed again when it is needed, in which case what is
+  // printed is checked against the hash of the text that was dropped. These
+  // are empty if the document is not virtual
+  mutable std::vector<Offset> stored;
+  mutable std::string kept;
+  std::vector<size_t> hashes;
+
+  // The fragments that have been printed again, most recently used first,
+  // and where each one is in the list. The slot tracker numbers the
+  // unnamed values and metadata nodes exactly as they were numbered when
+  // the module was printed. If the module was read lazily from bitcode, the
+  // metadata in a body is numbered when the body is first printed, so the
+  // nodes in a body that is read later follow all the others just as they
+  // would if the module were printed again. None of this can be shared
+  // between threads
+  mutable std::mutex mutex;
+  mutable std::unique_ptr<llvm::ModuleSlotTracker> slots;
+  mutable std::list<std::pair<unsigned, std::string>> printed;
+  mutable llvm::DenseMap<unsigned, decltype(printed)::iterator> cached;
+  mutable Offset cached_size;
+  Offset budget;
+
+protected:
+  Document(const llvm::Module& llvm,
+           llvm::StringRef name,
+           llvm::StringRef text,
+           Offset budget);
+
+  void split(const Module& module, llvm::StringRef text);
+  void keep(llvm::StringRef text);
+
+  // The index of the fragment containing the offset
+  unsigned find(Offset offset) const;
+
+  // Print the fragment again from the LLVM module
+  std::string print(unsigned idx) const;
+  void print(llvm::raw_ostream& os, const llvm::Function& f) const;
+  void print(llvm::raw_ostream& os, const llvm::MDNode& md) const;
+
+  // The text of the fragment. If the fragment has been printed again, this
+  // is only valid until the next fragment is printed. The mutex must be held
+  llvm::StringRef get(unsigned idx) const;
+
+  // Call f with each piece of the text in [begin, end) in order. The pieces
+  // are only valid while f is running
+  template<typename F>
+  void visit(Offset begin, Offset end, F f) const;
+
+public:
+  Document()                = delete;
+  Document(const Document&) = delete;
+  Document(Document&&)      = delete;
+  virtual ~Document()       = default;
+
+  llvm::StringRef get_name() const;
+  Offset get_size() const;
+  bool is_virtual() const;
+
+  llvm::ArrayRef<Fragment> get_fragments() const;
+
+  // The fragment containing the offset or nullptr if the offset is past
+  // the end of the document
+  const Fragment* get_fragment_at(Offset offset) const;
+
+  // The start of the line containing the offset. A newline is part of the
+  // line that it ends
+  Offset get_line_begin(Offset offset) const;
+
+  // The text in [begin, end). The range is clamped to the document
+  std::string get_text(Offset begin, Offset end) const;
+
+  // Copy the text in [begin, end) to out and return the end of what was
+  // copied
+  char* copy(Offset begin, Offset end, char* out) const;
+
+  // True if the text in [begin, end) is the same as the given text. Nothing
+  // is copied unless fragments have to be printed again
+  bool equals(Offset begin, Offset end, llvm::StringRef text) const;
+
+  // Drop all the fragments that have been printed again
+  void drop() const;
+
+  // The text of the function or metadata node as it is printed in the
+  // module. This is how the body of a function that has just been read
+  // from the bitcode is printed. The metadata nodes reachable from it that
+  // had not been printed before are numbered after all the others
+  std::string print(const llvm::Function& f) const;
+  std::string print(const llvm::MDNode& md) const;
+
+  // The metadata nodes that have been numbered at or after slot in the
+  // order of their numbers
+  std::vector<const llvm::MDNode*> get_metadata(unsigned slot) const;
+
+  // Replace the fragments in [begin, end) with the text, which is split
+  // into the given fragments. The fragments must cover all of the text and
+  // their offsets are those in the document that results. The fragments
+  // after the range move with it. If the document is not virtual, all is
+  // the whole of the text that results and it must outlive the document
+  void splice(Offset begin,
+              Offset end,
+              llvm::StringRef text,
+              llvm::ArrayRef<Fragment> added,
+              llvm::StringRef all);
+
+public:
+  // The text must outlive the document
+  static std::unique_ptr<Document>
+  create(const Module& module, llvm::StringRef name, llvm::StringRef text);
+
+  // The text must have been printed by LLVM from the module and is only
+  // read while the document is being created. At most budget bytes of the
+  // fragments that are printed again are kept
+  static std::unique_ptr<Document> create_virtual(const Module& module,
+                                                  llvm::StringRef name,
+                                                  llvm::StringRef text,
+                                                  Offset budget);
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_DOCUMENT_H
@@ -18,26 +18,54 @@ Function::Function(const llvm::Function& llvm_f, Module& module) :
     Value(EntityKind::Function),
     INavigable(EntityKind::Function),
     IWrapper<llvm::Function>(llvm_f, module),
+    materialized(false),
     comdat(nullptr),
     di(llvm_f.getSubprogram()) {
-  for(const llvm::Argument& arg : llvm_f.args())
-    Argument::make(arg, *this, module);
-  for(const llvm::BasicBlock& bb : llvm_f)
-    BasicBlock::make(bb, *this, module);
   if(const llvm::Comdat* llvm_c = llvm_f.getComdat())
     // There is a
     comdat = &(static_cast<const Module&>(module).get(*llvm_c));
 
-  set_tag(llvm_f.getName(), "@");
-  if(di) {
-    source_name    = DebugInfo::get_name(di);
-    full_name      = DebugInfo::get_full_name(di);
-    qualified_name = DebugInfo::get_qualified_name(di);
-    set_source_defn(
-        SourceRange(module.get_full_path(di->getDirectory(), di->getFilename()),
-                    di->getLine(),
-                    1));
-  }
+  set_tag(module.get_arena(), llvm_f.getName(), "@");
+  if(di)
+    set_source_info(module);
+}
+
+void
+Function::set_source_info(Module& module) {
+  source_name    = DebugInfo::get_name(di);
+  full_name      = DebugInfo::get_full_name(di);
+  qualified_name = DebugInfo::get_qualified_name(di);
+  set_source_defn(SourceLocation(
+      module.get_file_id(di->getDirectory(), di->getFilename()),
+      di->getLine(),
+      1));
+}
+
+void
+Function::make_body() {
+  if(materialized)
+    return;
+
+  // The debug information attached to a function that was read lazily from
+  // bitcode is only read along with its body
+  Module& module = get_module();
+  if(not di and (di = get_llvm().getSubprogram()))
+    set_source_info(module);
+  for(const llvm::Argument& arg : get_llvm().args())
+    Argument::make(arg, *this, module);
+  for(const llvm::BasicBlock& bb : get_llvm())
+    BasicBlock::make(bb, *this, module);
+  materialized = true;
+}
+
+bool
+Function::is_materialized() const {
+  return materialized;
+}
+
+bool
+Function::is_body_read() const {
+  return not get_llvm().isMaterializable();
 }
 
 bool
@@ -143,45 +171,65 @@ Function::get_arg(unsigned i) {
 
 const Argument&
 Function::get_arg(unsigned i) const {
+  get_module().link_function(*this);
   return *m_args.at(i);
 }
 
 Function::BlockIterator
 Function::begin() const {
+  get_module().link_function(*this);
   return m_blocks.begin();
 }
 
 Function::BlockIterator
 Function::end() const {
+  get_module().link_function(*this);
   return m_blocks.end();
 }
 
 llvm::iterator_range<Function::BlockIterator>
 Function::blocks() const {
+  get_module().link_function(*this);
   return llvm::iterator_range<BlockIterator>(BlockIterator(m_blocks.begin()),
                                              BlockIterator(m_blocks.end()));
 }
 
 Function::ArgIterator
 Function::arg_begin() const {
+  get_module().link_function(*this);
   return ArgIterator(m_args.begin());
 }
 
 Function::ArgIterator
 Function::arg_end() const {
+  get_module().link_function(*this);
   return ArgIterator(m_args.end());
 }
 
 llvm::iterator_range<Function::ArgIterator>
 Function::arguments() const {
+  get_module().link_function(*this);
   return llvm::iterator_range<ArgIterator>(ArgIterator(m_args.begin()),
                                            ArgIterator(m_args.end()));
 }
 
+std::vector<Use>
+Function::uses() const {
+  get_module().link_uses(get_llvm());
+  return INavigable::uses();
+}
+
+unsigned
+Function::get_num_uses() const {
+  get_module().link_uses(get_llvm());
+  return INavigable::get_num_uses();
+}
+
 Function&
 Function::make(const llvm::Function& llvm_f, Module& module) {
-  auto* f = new Function(llvm_f, module);
-  if(llvm_f.size())
+  void* mem = module.arena.allocate<Function>();
+  auto* f   = new(mem) Function(llvm_f, module);
+  if(not llvm_f.isDeclaration())
     module.m_functions.emplace_back(f);
   else
     module.m_decls.emplace_back(f);
@@ -27,8 +27,9 @@ class alignas(ALIGN_OBJ) Function :
     public INavigable,
     public IWrapper<llvm::Function> {
 protected:
-  std::vector<std::unique_ptr<Argument>> m_args;
-  std::vector<std::unique_ptr<BasicBlock>> m_blocks;
+  std::vector<Argument*> m_args;
+  std::vector<BasicBlock*> m_blocks;
+  bool materialized;
   const Comdat* comdat;
   const llvm::DISubprogram* di;
   std::string source_name;
@@ -49,12 +50,25 @@ public:
 protected:
   Function(const llvm::Function& llvm_f, Module& module);
 
+  // Set the names and the location in the source from the debug information
+  void set_source_info(Module& module);
+
 public:
   Function()           = delete;
   Function(Function&)  = delete;
   Function(Function&&) = delete;
   virtual ~Function()  = default;
 
+  // Create the wrappers for the arguments, basic blocks and instructions.
+  // When a module is loaded lazily, this is only done for a defined function
+  // when its body is linked
+  void make_body();
+  bool is_materialized() const;
+
+  // False if the module was read lazily from bitcode and the body of this
+  // function is still in the bitcode, in which case it is empty in the IR
+  bool is_body_read() const;
+
   bool has_source_info() const;
   bool has_source_name() const;
   bool has_full_name() const;
@@ -86,6 +100,12 @@ public:
   ArgIterator arg_end() const;
   llvm::iterator_range<ArgIterator> arguments() const;
 
+  // The bodies of the functions that use this one may not have been linked
+  // if the module was loaded lazily. These hide the ones in INavigable so
+  // they get linked first
+  std::vector<Use> uses() const;
+  unsigned get_num_uses() const;
+
 public:
   static bool classof(const Value* v) {
     return v->get_kind() == EntityKind::Function;
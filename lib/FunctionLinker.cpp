@@ -0,0 +1,135 @@
+#include "FunctionLinker.h"
+#include "Function.h"
+#include "INavigable.h"
+#include "Module.h"
+#include "Parser.h"
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instruction.h>
+#include <llvm/Support/Casting.h>
+
+using llvm::dyn_cast;
+using llvm::isa;
+
+namespace lb {
+
+FunctionLinker::FunctionLinker(Parser& parser, Module& module) :
+    parser(parser), module(module) {
+  ;
+}
+
+void
+FunctionLinker::add(Function& f) {
+  pending.emplace(f.get_llvm_span().get_begin(), &f);
+}
+
+void
+FunctionLinker::add_attachment(const llvm::MDNode& md,
+                               const llvm::Function& llvm_f) {
+  // All the instructions in a function are seen together, so checking the
+  // last function is enough to avoid duplicates
+  std::vector<const llvm::Function*>& fns = attached[&md];
+  if(fns.empty() or (fns.back() != &llvm_f))
+    fns.push_back(&llvm_f);
+}
+
+void
+FunctionLinker::link_pending(std::map<Offset, Function*>::iterator it,
+                             std::set<INavigable*>& touched) {
+  Function& f = *it->second;
+  pending.erase(it);
+  parser.link_lazily(f.get_llvm(), module, touched);
+}
+
+void
+FunctionLinker::link_pending(const llvm::Function& llvm_f,
+                             std::set<INavigable*>& touched) {
+  Function& f = module.get(llvm_f);
+  if(f.is_materialized())
+    return;
+
+  auto it = pending.find(f.get_llvm_span().get_begin());
+  if((it != pending.end()) and (it->second == &f))
+    link_pending(it, touched);
+}
+
+void
+FunctionLinker::commit(const std::set<INavigable*>& touched) {
+  module.sort_late();
+  for(INavigable* navigable : touched)
+    navigable->sort_uses();
+}
+
+void
+FunctionLinker::link(const Function& f) {
+  if(f.is_materialized())
+    return;
+
+  std::set<INavigable*> touched;
+  link_pending(f.get_llvm(), touched);
+  commit(touched);
+}
+
+void
+FunctionLinker::link_at(Offset offset) {
+  auto it = pending.upper_bound(offset);
+  if(it == pending.begin())
+    return;
+
+  --it;
+  if(offset > it->second->get_llvm_span().get_end())
+    return;
+
+  std::set<INavigable*> touched;
+  link_pending(it, touched);
+  commit(touched);
+}
+
+void
+FunctionLinker::link_users(const llvm::Value& llvm) {
+  if(pending.empty())
+    return;
+
+  // Global values can be used by instructions directly or through any
+  // number of constant expressions and aggregates. Uses in the initializers
+  // of global variables will already have been linked, so those are not
+  // followed
+  std::set<INavigable*> touched;
+  std::set<const llvm::Value*> seen;
+  std::vector<const llvm::Value*> wl = {&llvm};
+  while(wl.size()) {
+    const llvm::Value* v = wl.back();
+    wl.pop_back();
+    for(const llvm::User* user : v->users())
+      if(const auto* inst = dyn_cast<llvm::Instruction>(user))
+        link_pending(*inst->getFunction(), touched);
+      else if(isa<llvm::Constant>(user) and not isa<llvm::GlobalValue>(user)
+              and seen.insert(user).second)
+        wl.push_back(user);
+  }
+  commit(touched);
+}
+
+void
+FunctionLinker::link_attached(const llvm::MDNode& md) {
+  auto it = attached.find(&md);
+  if(it == attached.end())
+    return;
+
+  std::set<INavigable*> touched;
+  for(const llvm::Function* llvm_f : it->second)
+    link_pending(*llvm_f, touched);
+  attached.erase(it);
+  commit(touched);
+}
+
+void
+FunctionLinker::link_all() {
+  std::set<INavigable*> touched;
+  while(pending.size())
+    link_pending(pending.begin(), touched);
+  attached.clear();
+  commit(touched);
+}
+
+} // namespace lb
@@ -0,0 +1,87 @@
+#ifndef LLVM_BROWSE_FUNCTION_LINKER_H
+#define LLVM_BROWSE_FUNCTION_LINKER_H
+
+#include "Typedefs.h"
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Metadata.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+namespace lb {
+
+class Function;
+class INavigable;
+class Module;
+class Parser;
+
+// Links the bodies of functions when they are first needed. When a module
+// is loaded lazily, only the top-level entities are linked up front. The
+// wrappers for the arguments, basic blocks and instructions of a function
+// and the uses in its body are created the first time one of these happens:
+//
+//   - the body of the function is asked for,
+//   - the cursor is somewhere in the body of the function,
+//   - the uses of a global value or metadata node used in the function are
+//     asked for.
+//
+// The uses and definitions that are created are merged into the sorted
+// lists in the module, so the module always looks as if everything was
+// linked when it was loaded.
+//
+class FunctionLinker {
+protected:
+  Parser& parser;
+  Module& module;
+
+  // The functions whose bodies have not been linked, keyed by the offset of
+  // the opening brace of the body
+  std::map<Offset, Function*> pending;
+
+  // The functions containing instructions to which a metadata node is
+  // attached
+  llvm::DenseMap<const llvm::MDNode*, std::vector<const llvm::Function*>>
+      attached;
+
+protected:
+  void link_pending(std::map<Offset, Function*>::iterator it,
+                    std::set<INavigable*>& touched);
+  void link_pending(const llvm::Function& llvm_f,
+                    std::set<INavigable*>& touched);
+  void commit(const std::set<INavigable*>& touched);
+
+public:
+  FunctionLinker(Parser& parser, Module& module);
+  virtual ~FunctionLinker() = default;
+
+  // Add a function whose body should be linked later. The span of the
+  // function must have been set
+  void add(Function& f);
+
+  // Record that the metadata node is attached to an instruction in the
+  // function
+  void add_attachment(const llvm::MDNode& md, const llvm::Function& llvm_f);
+
+  // Link the body of the function if it hasn't been linked yet
+  void link(const Function& f);
+
+  // Link the body of the function containing the offset if there is one
+  void link_at(Offset offset);
+
+  // Link the bodies of all the functions that use the value
+  void link_users(const llvm::Value& llvm);
+
+  // Link the bodies of all the functions with instructions to which the
+  // metadata node is attached
+  void link_attached(const llvm::MDNode& md);
+
+  // Link the bodies of all the functions that haven't been linked yet
+  void link_all();
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_FUNCTION_LINKER_H
@@ -13,7 +13,7 @@ GlobalAlias::GlobalAlias(const llvm::GlobalAlias& llvm_a, Module& module) :
     Value(EntityKind::GlobalAlias),
     INavigable(EntityKind::GlobalAlias),
     IWrapper<llvm::GlobalAlias>(llvm_a, module) {
-  set_tag(get_llvm().getName(), "@");
+  set_tag(module.get_arena(), get_llvm().getName(), "@");
 }
 
 bool
@@ -36,9 +36,22 @@ GlobalAlias::get_llvm_name() const {
   return get_llvm().getName();
 }
 
+std::vector<Use>
+GlobalAlias::uses() const {
+  get_module().link_uses(get_llvm());
+  return INavigable::uses();
+}
+
+unsigned
+GlobalAlias::get_num_uses() const {
+  get_module().link_uses(get_llvm());
+  return INavigable::get_num_uses();
+}
+
 GlobalAlias&
 GlobalAlias::make(const llvm::GlobalAlias& llvm_a, Module& module) {
-  auto* alias = new GlobalAlias(llvm_a, module);
+  void* mem   = module.arena.allocate<GlobalAlias>();
+  auto* alias = new(mem) GlobalAlias(llvm_a, module);
   module.m_aliases.emplace_back(alias);
   module.vmap[&llvm_a] = alias;
 
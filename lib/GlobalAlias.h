@@ -1,6 +1,7 @@
 #ifndef LLVM_BROWSE_GLOBAL_ALIAS_H
 #define LLVM_BROWSE_GLOBAL_ALIAS_H
 
+#include <llvm/ADT/iterator_range.h>
 #include <llvm/IR/GlobalAlias.h>
 
 #include "INavigable.h"
@@ -29,6 +30,12 @@ public:
   llvm::StringRef get_source_name() const;
   llvm::StringRef get_llvm_name() const;
 
+  // The bodies of the functions that use this may not have been linked if
+  // the module was loaded lazily. These hide the ones in INavigable so they
+  // get linked first
+  std::vector<Use> uses() const;
+  unsigned get_num_uses() const;
+
 public:
   static bool classof(const Value* v) {
     return v->get_kind() == EntityKind::GlobalAlias;
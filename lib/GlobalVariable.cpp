@@ -22,7 +22,7 @@ GlobalVariable::GlobalVariable(const llvm::GlobalVariable& llvm_g,
     comdat(nullptr),
     di(nullptr) {
   if(llvm_g.hasName())
-    set_tag(llvm_g.getName(), "@");
+    set_tag(module.get_arena(), llvm_g.getName(), "@");
   else
     critical() << "Cannot set tag for unnamed global" << llvm_g << "\n";
   if(const llvm::Comdat* llvm_c = llvm_g.getComdat())
@@ -32,10 +32,10 @@ GlobalVariable::GlobalVariable(const llvm::GlobalVariable& llvm_g,
   llvm_g.getDebugInfo(dis);
   if(dis.size() == 1) {
     di = dis[0]->getVariable();
-    set_source_defn(
-        SourceRange(module.get_full_path(di->getDirectory(), di->getFilename()),
-                    di->getLine(),
-                    1));
+    set_source_defn(SourceLocation(
+        module.get_file_id(di->getDirectory(), di->getFilename()),
+        di->getLine(),
+        1));
     source_name    = DebugInfo::get_name(di);
     full_name      = DebugInfo::get_full_name(di);
     qualified_name = DebugInfo::get_qualified_name(di);
@@ -102,9 +102,22 @@ GlobalVariable::is_mangled() const {
   return false;
 }
 
+std::vector<Use>
+GlobalVariable::uses() const {
+  get_module().link_uses(get_llvm());
+  return INavigable::uses();
+}
+
+unsigned
+GlobalVariable::get_num_uses() const {
+  get_module().link_uses(get_llvm());
+  return INavigable::get_num_uses();
+}
+
 GlobalVariable&
 GlobalVariable::make(const llvm::GlobalVariable& llvm_g, Module& module) {
-  auto* global = new GlobalVariable(llvm_g, module);
+  void* mem    = module.arena.allocate<GlobalVariable>();
+  auto* global = new(mem) GlobalVariable(llvm_g, module);
   module.m_globals.emplace_back(global);
   module.vmap[&llvm_g] = global;
 
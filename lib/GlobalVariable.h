@@ -1,6 +1,7 @@
 #ifndef LLVM_BROWSE_GLOBAL_VARIABLE_H
 #define LLVM_BROWSE_GLOBAL_VARIABLE_H
 
+#include <llvm/ADT/iterator_range.h>
 #include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/ModuleSlotTracker.h>
@@ -18,7 +19,7 @@ class Module;
 class alignas(ALIGN_OBJ) GlobalVariable :
     public Value,
     public INavigable,
-    IWrapper<llvm::GlobalVariable> {
+    public IWrapper<llvm::GlobalVariable> {
 protected:
   const Comdat* comdat;
   const llvm::DIGlobalVariable* di;
@@ -47,6 +48,12 @@ public:
   bool is_artificial() const;
   bool is_mangled() const;
 
+  // The bodies of the functions that use this may not have been linked if
+  // the module was loaded lazily. These hide the ones in INavigable so they
+  // get linked first
+  std::vector<Use> uses() const;
+  unsigned get_num_uses() const;
+
 public:
   static bool classof(const Value* v) {
     return v->get_kind() == EntityKind::GlobalVariable;
@@ -1,5 +1,10 @@
 #include "INavigable.h"
-#include "String.h"
+#include "Arena.h"
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
 
 namespace lb {
 
@@ -11,7 +16,7 @@ needs_quotes(llvm::StringRef str) {
   return false;
 }
 
-INavigable::INavigable(EntityKind kind) : kind(kind), llvm_defn(nullptr) {
+INavigable::INavigable(EntityKind kind) : kind(kind) {
   ;
 }
 
@@ -22,41 +27,70 @@ INavigable::get_kind() const {
 
 void
 INavigable::sort_uses() {
-  std::sort(m_uses.begin(), m_uses.end(), [](const Use* l, const Use* r) {
-    // Uses are guaranteed not to overlap with any other uses, so we only need
-    // to look at the beginning to keep them sorted
-    return l->get_begin() < r->get_begin();
-  });
+  // When functions are linked lazily, the uses that were already sorted are
+  // followed by the few that were just added. Only those need to be sorted
+  auto mid = std::is_sorted_until(m_uses.begin(), m_uses.end());
+  std::sort(mid, m_uses.end());
+  std::inplace_merge(m_uses.begin(), mid, m_uses.end());
 }
 
 void
-INavigable::add_use(const Use& use) {
-  m_uses.emplace_back(&use);
+INavigable::add_use(Offset begin) {
+  m_uses.push_back(begin);
+}
+
+static LLVMRange
+move(const LLVMRange& range, Offset begin, Offset end, Offset size) {
+  if(not range or (range.get_begin() < end))
+    return range;
+  return LLVMRange(range.get_begin() - end + begin + size,
+                   range.get_end() - end + begin + size);
 }
 
 void
-INavigable::set_tag(unsigned slot, llvm::StringRef prefix) {
-  tag = String::concat(prefix, slot);
+INavigable::move(Offset begin, Offset end, Offset size) {
+  llvm_defn = lb::move(llvm_defn, begin, end, size);
+  llvm_span = lb::move(llvm_span, begin, end, size);
+
+  auto first = std::lower_bound(m_uses.begin(), m_uses.end(), begin);
+  auto last  = std::lower_bound(first, m_uses.end(), end);
+  for(auto it = last; it != m_uses.end(); it++)
+    *it = *it - end + begin + size;
+  m_uses.erase(first, last);
 }
 
+// The tags are formatted on the stack, so nothing is allocated unless the
+// arena hasn't seen the tag before
 void
-INavigable::set_tag(llvm::StringRef name) {
-  tag = name;
+INavigable::set_tag(Arena& arena, unsigned slot, llvm::StringRef prefix) {
+  llvm::SmallString<32> buf;
+  llvm::raw_svector_ostream ss(buf);
+  ss << prefix << slot;
+  tag = arena.save(ss.str());
 }
 
 void
-INavigable::set_tag(llvm::StringRef name,
+INavigable::set_tag(Arena& arena,
+                    llvm::StringRef name,
                     llvm::StringRef prefix,
                     bool may_need_quotes) {
+  llvm::SmallString<128> buf;
+  llvm::raw_svector_ostream ss(buf);
   if(may_need_quotes and needs_quotes(name))
-    tag = String::concat(prefix, "\"", name, "\"");
+    ss << prefix << "\"" << name << "\"";
   else
-    tag = String::concat(prefix, name);
+    ss << prefix << name;
+  tag = arena.save(ss.str());
+}
+
+void
+INavigable::set_tag(llvm::StringRef name) {
+  tag = name;
 }
 
 void
-INavigable::set_llvm_defn(const Definition& defn) {
-  llvm_defn = &defn;
+INavigable::set_llvm_defn(const LLVMRange& defn) {
+  llvm_defn = defn;
 }
 
 void
@@ -65,38 +99,32 @@ INavigable::set_llvm_span(const LLVMRange& range) {
 }
 
 void
-INavigable::set_source_defn(const SourceRange& range) {
-  source_defn = range;
+INavigable::set_source_defn(const SourceLocation& loc) {
+  source_defn = loc;
 }
 
 void
-INavigable::set_source_span(const SourceRange& range) {
-  source_span = range;
+INavigable::set_source_span(const SourceLocation& loc) {
+  source_span = loc;
 }
 
 bool
 INavigable::has_tag() const {
-  return tag.length();
+  return tag.size();
 }
 
 llvm::StringRef
 INavigable::get_tag() const {
-  return llvm::StringRef(tag);
-}
-
-INavigable::Iterator
-INavigable::begin() const {
-  return m_uses.cbegin();
+  return tag;
 }
 
-INavigable::Iterator
-INavigable::end() const {
-  return m_uses.cend();
-}
-
-llvm::iterator_range<INavigable::Iterator>
+std::vector<Use>
 INavigable::uses() const {
-  return llvm::iterator_range<Iterator>(m_uses);
+  std::vector<Use> uses;
+  uses.reserve(m_uses.size());
+  for(Offset begin : m_uses)
+    uses.emplace_back(begin, begin + tag.size(), *this);
+  return uses;
 }
 
 unsigned
@@ -124,9 +152,9 @@ INavigable::has_source_span() const {
   return source_span;
 }
 
-const Definition&
+const LLVMRange&
 INavigable::get_llvm_defn() const {
-  return *llvm_defn;
+  return llvm_defn;
 }
 
 const LLVMRange&
@@ -134,11 +162,11 @@ INavigable::get_llvm_span() const {
   return llvm_span;
 }
 
-const SourceRange&
+const SourceLocation&
 INavigable::get_source_defn() const {
   return source_defn;
 }
-const SourceRange&
+const SourceLocation&
 INavigable::get_source_span() const {
   return source_span;
 }
@@ -9,11 +9,12 @@
 #include "Definition.h"
 #include "Entities.h"
 #include "LLVMRange.h"
-#include "SourceRange.h"
+#include "SourceLocation.h"
 #include "Use.h"
 
 namespace lb {
 
+class Arena;
 class Instruction;
 
 // Base for objects that are navigable. This essentially means that they
@@ -38,7 +39,8 @@ protected:
   // this might have the form "^%.+$" where the characters after the percent
   // sign are typically numbers but they don't have to be.
   // For struct types, this will be "%.+", for globals, this will be "^@.+$"
-  std::string tag;
+  // The text is kept in the arena of the module
+  llvm::StringRef tag;
 
   // The defn range is the range of characters in the IR that correspond to
   // the "definition" of an entity. The "definition" is where the cursor must
@@ -49,7 +51,7 @@ protected:
   // that don't return a value, it may cover the instruction opcode although
   // it might be better if it is of length 0 and positioned just at the start
   // of the op code
-  const Definition* llvm_defn;
+  LLVMRange llvm_defn;
 
   // The LLVM span is the range in characters that the entity covers in
   // the IR. For functions, this is the entire body, for basic blocks, all
@@ -60,7 +62,7 @@ protected:
   // The source defn is the range in characters in the source code that
   // the definition of the entity covers. For functions and globals, this
   // will simply span the beginning to the end of the name in the source code
-  SourceRange source_defn;
+  SourceLocation source_defn;
 
   // The source span is the range in characters in the source code that the
   // entity covers. This is a somewhat more nebulous range because there may not
@@ -70,17 +72,16 @@ protected:
   // Still, this is mainly here so we have a decent starting point at which
   // to position the cursor in the source even if we can't do anything else
   // beyond that
-  SourceRange source_span;
+  SourceLocation source_span;
 
   // This is sort of messy because not everything that is navigable ought to
   // have a use. The exeception are struct types that also have a definition
   // but it doesn't make sense to have any uses for them. But it's a bit messy
   // to separate the two and still keep the type system straight (or - and this
   // is more likely - I am being particuarly dense)
-  std::vector<const Use*> m_uses;
-
-public:
-  using Iterator = decltype(m_uses)::const_iterator;
+  // A use covers exactly the text of the tag, so only the offsets at which
+  // the uses begin are kept
+  std::vector<Offset> m_uses;
 
 protected:
   INavigable(EntityKind kind);
@@ -90,24 +91,31 @@ public:
 
   // This gets used for both instructions and metadata nodes and for metadata
   // nodes, we have a different prefix
-  void set_tag(unsigned slot, llvm::StringRef prefix = "%");
-  void set_tag(llvm::StringRef name);
-  void set_tag(llvm::StringRef name,
+  void set_tag(Arena& arena, unsigned slot, llvm::StringRef prefix = "%");
+  void set_tag(Arena& arena,
+               llvm::StringRef name,
                llvm::StringRef prefix,
                bool may_need_quotes = true);
 
+  // The name is not copied and must outlive the entity. This is used for
+  // instructions that don't return a value whose tag is their opcode
+  void set_tag(llvm::StringRef name);
+
   void sort_uses();
-  void add_use(const Use&);
+  void add_use(Offset begin);
+
+  // The text in [begin, end) of the IR was replaced with size bytes of
+  // other text. Whatever is after the range moves with it. The uses in the
+  // range are dropped
+  void move(Offset begin, Offset end, Offset size);
 
-  void set_llvm_defn(const Definition& defn);
+  void set_llvm_defn(const LLVMRange& defn);
   void set_llvm_span(const LLVMRange& range);
-  void set_source_defn(const SourceRange& range);
-  void set_source_span(const SourceRange& range);
+  void set_source_defn(const SourceLocation& loc);
+  void set_source_span(const SourceLocation& loc);
 
   EntityKind get_kind() const;
-  Iterator begin() const;
-  Iterator end() const;
-  llvm::iterator_range<Iterator> uses() const;
+  std::vector<Use> uses() const;
   unsigned get_num_uses() const;
   bool has_tag() const;
   llvm::StringRef get_tag() const;
@@ -115,10 +123,10 @@ public:
   bool has_llvm_span() const;
   bool has_source_defn() const;
   bool has_source_span() const;
-  const Definition& get_llvm_defn() const;
+  const LLVMRange& get_llvm_defn() const;
   const LLVMRange& get_llvm_span() const;
-  const SourceRange& get_source_defn() const;
-  const SourceRange& get_source_span() const;
+  const SourceLocation& get_source_defn() const;
+  const SourceLocation& get_source_span() const;
 };
 
 } // namespace lb
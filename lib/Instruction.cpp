@@ -27,8 +27,8 @@ Instruction::Instruction(const llvm::Instruction& llvm_i,
     di(llvm_i.getDebugLoc()) {
   if(di) {
     if(const auto* scope = dyn_cast<llvm::DIScope>(di.getScope())) {
-      SourceRange defn = SourceRange(
-          module.get_full_path(scope->getDirectory(), scope->getFilename()),
+      SourceLocation defn(
+          module.get_file_id(scope->getDirectory(), scope->getFilename()),
           di.getLine(),
           di.getCol());
       set_source_defn(defn);
@@ -69,11 +69,11 @@ Instruction::get_llvm_name() const {
 }
 
 void
-Instruction::add_operand(const SourceRange& range) {
-  ops.emplace_back(range);
+Instruction::add_operand(const SourceLocation& loc) {
+  ops.emplace_back(loc);
 }
 
-SourceRange
+SourceLocation
 Instruction::get_operand(unsigned i) const {
   return ops.at(i);
 }
@@ -131,7 +131,8 @@ Instruction::make(const llvm::Instruction& llvm_i,
                   BasicBlock& bb,
                   Function& f,
                   Module& module) {
-  auto* inst = new Instruction(llvm_i, bb, f, module);
+  void* mem  = module.arena.allocate<Instruction>();
+  auto* inst = new(mem) Instruction(llvm_i, bb, f, module);
   bb.m_insts.emplace_back(inst);
   module.vmap[&llvm_i] = inst;
 
@@ -9,7 +9,7 @@
 
 #include "INavigable.h"
 #include "IWrapper.h"
-#include "SourceRange.h"
+#include "SourceLocation.h"
 #include "Value.h"
 
 namespace lb {
@@ -22,7 +22,7 @@ class Instruction :
     public INavigable,
     public IWrapper<llvm::Instruction> {
 protected:
-  std::vector<SourceRange> ops;
+  std::vector<SourceLocation> ops;
   BasicBlock& parent;
   llvm::DebugLoc di;
 
@@ -42,11 +42,11 @@ public:
   Instruction(Instruction&&) = delete;
   virtual ~Instruction()     = default;
 
-  void add_operand(const SourceRange& = SourceRange());
+  void add_operand(const SourceLocation& = SourceLocation());
 
   bool has_source_info() const;
   llvm::StringRef get_llvm_name() const;
-  SourceRange get_operand(unsigned i) const;
+  SourceLocation get_operand(unsigned i) const;
   Iterator begin() const;
   Iterator end() const;
   llvm::iterator_range<Iterator> operands() const;
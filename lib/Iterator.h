@@ -1,13 +1,18 @@
 #ifndef LLVM_BROWSE_ITERATOR_H
 #define LLVM_BROWSE_ITERATOR_H
 
+#include <memory>
+
 namespace lb {
 
+// An iterator over a container of pointers, smart or otherwise, that
+// exposes references to the objects being pointed to
 template<typename BaseIterator>
 class DerefIterator : public BaseIterator {
 public:
   using iterator_category = typename BaseIterator::iterator_category;
-  using value_type        = typename BaseIterator::value_type::element_type;
+  using value_type        = typename std::pointer_traits<
+      typename BaseIterator::value_type>::element_type;
   using difference_type   = typename BaseIterator::difference_type;
   using pointer           = value_type*;
   using reference         = value_type&;
@@ -21,7 +26,7 @@ public:
   }
 
   pointer operator->() const {
-    return this->BaseIterator::operator*().get();
+    return &**this;
   }
 
   reference operator[](size_t n) const {
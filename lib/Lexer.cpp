@@ -0,0 +1,135 @@
+#include "Lexer.h"
+
+#include <cctype>
+
+namespace lb {
+
+static bool
+is_name_char(char c) {
+  return std::isalnum(c) or (c == '-') or (c == '$') or (c == '.')
+         or (c == '_');
+}
+
+Lexer::Lexer(llvm::StringRef ir, Offset cursor) : ir(ir), cursor(cursor) {
+  ;
+}
+
+void
+Lexer::reset(Offset cursor) {
+  this->cursor = cursor;
+}
+
+Offset
+Lexer::get_cursor() const {
+  return cursor;
+}
+
+Offset
+Lexer::skip_string(Offset pos) const {
+  // LLVM escapes quotes inside strings, so the first quote after the opening
+  // quote always closes the string
+  Offset end = ir.find('"', pos + 1);
+  if(end == llvm::StringRef::npos)
+    return ir.size();
+  return end + 1;
+}
+
+Offset
+Lexer::skip_comment(Offset pos) const {
+  // Stop at the newline so the start of the next line is still returned
+  Offset end = ir.find('\n', pos);
+  if(end == llvm::StringRef::npos)
+    return ir.size();
+  return end;
+}
+
+Offset
+Lexer::skip_indent(Offset pos) const {
+  while((pos < ir.size()) and ((ir[pos] == ' ') or (ir[pos] == '\t')))
+    pos++;
+  return pos;
+}
+
+Offset
+Lexer::lex_name(Offset pos) const {
+  // pos is the position of the sigil. Names may be quoted if they
+  // contain characters that are not otherwise allowed in an identifier
+  if((pos + 1 < ir.size()) and (ir[pos + 1] == '"'))
+    return skip_string(pos + 1);
+
+  Offset end = pos + 1;
+  while((end < ir.size()) and is_name_char(ir[end]))
+    end++;
+  return end;
+}
+
+bool
+Lexer::next(Token& tok) {
+  while(cursor < ir.size()) {
+    Offset pos = cursor;
+    switch(ir[pos]) {
+    case '\n':
+      cursor = pos + 1;
+      if(cursor < ir.size()) {
+        tok = Token(TokenKind::Line, cursor, skip_indent(cursor));
+        return true;
+      }
+      break;
+    case ';':
+      cursor = skip_comment(pos);
+      break;
+    case '"':
+      cursor = skip_string(pos);
+      break;
+    case '=':
+      cursor = pos + 1;
+      tok    = Token(TokenKind::Equals, pos, cursor);
+      return true;
+    case '%':
+    case '@':
+    case '!':
+    case '$':
+      // Metadata strings are of the form !"..." and are not identifiers
+      if((ir[pos] == '!') and (pos + 1 < ir.size()) and (ir[pos + 1] == '"')) {
+        cursor = skip_string(pos + 1);
+      } else {
+        cursor = lex_name(pos);
+        // A lone sigil is not an identifier. This is typically the start of
+        // an anonymous metadata tuple like !{...}
+        if(cursor > pos + 1) {
+          if(ir[pos] == '%')
+            tok = Token(TokenKind::Local, pos, cursor);
+          else if(ir[pos] == '@')
+            tok = Token(TokenKind::Global, pos, cursor);
+          else if(ir[pos] == '$')
+            tok = Token(TokenKind::Comdat, pos, cursor);
+          else
+            tok = Token(TokenKind::Metadata, pos, cursor);
+          return true;
+        }
+      }
+      break;
+    default:
+      cursor = pos + 1;
+      break;
+    }
+  }
+  return false;
+}
+
+Offset
+Lexer::lex_function_body(Offset begin, std::vector<Token>& tokens) {
+  Token tok;
+  reset(begin + 1);
+  while(next(tok)) {
+    // The closing brace of the function is always at the start of a line.
+    // Nothing inside the function body can start with a brace
+    if(tok.is(TokenKind::Line) and (tok.get_begin() == tok.get_end())
+       and (ir[tok.get_begin()] == '}'))
+      return tok.get_begin();
+    tokens.push_back(tok);
+  }
+  return llvm::StringRef::npos;
+}
+
+} // namespace lb
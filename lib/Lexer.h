@@ -0,0 +1,53 @@
+#ifndef LLVM_BROWSE_LEXER_H
+#define LLVM_BROWSE_LEXER_H
+
+#include "Token.h"
+#include "Typedefs.h"
+
+#include <llvm/ADT/StringRef.h>
+
+#include <vector>
+
+namespace lb {
+
+// This is not a real lexer for LLVM IR and makes no attempt to be one.
+// It only recognizes the handful of tokens that are needed to associate the
+// text in the IR with the LLVM entities - identifiers, equals signs and the
+// starts of lines. Everything else is skipped. String literals and comments
+// are skipped as a whole so anything that looks like an identifier inside
+// them is never returned.
+//
+// The lexer only ever moves forward, so tokenizing a range of the IR is
+// linear in the size of the range.
+//
+class Lexer {
+protected:
+  llvm::StringRef ir;
+  Offset cursor;
+
+protected:
+  Offset skip_string(Offset pos) const;
+  Offset skip_comment(Offset pos) const;
+  Offset skip_indent(Offset pos) const;
+  Offset lex_name(Offset pos) const;
+
+public:
+  Lexer(llvm::StringRef ir, Offset cursor = 0);
+  virtual ~Lexer() = default;
+
+  void reset(Offset cursor);
+  Offset get_cursor() const;
+
+  // Returns false when there are no more tokens in the IR
+  bool next(Token& tok);
+
+  // Tokenize the body of a function. The begin offset must be that of the
+  // opening brace of the function. All tokens up to the closing brace are
+  // appended to the vector. Returns the offset of the closing brace or
+  // llvm::StringRef::npos if it could not be found
+  Offset lex_function_body(Offset begin, std::vector<Token>& tokens);
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_LEXER_H
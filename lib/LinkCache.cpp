@@ -0,0 +1,377 @@
+#include "LinkCache.h"
+#include "Argument.h"
+#include "BasicBlock.h"
+#include "Comdat.h"
+#include "Definition.h"
+#include "Function.h"
+#include "GlobalAlias.h"
+#include "GlobalVariable.h"
+#include "INavigable.h"
+#include "Instruction.h"
+#include "Logging.h"
+#include "MDNode.h"
+#include "Module.h"
+#include "StructType.h"
+#include "Use.h"
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/Casting.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/xxhash.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+using llvm::dyn_cast;
+using llvm::isa;
+
+namespace lb {
+
+// This must be changed whenever the layout of the cache or the way in which
+// the entities are numbered changes
+static constexpr uint32_t CACHE_VERSION = 4;
+
+static constexpr char CACHE_MAGIC[8] = {'L', 'B', 'C', 'A', 'C', 'H', 'E', 0};
+
+// The second entity of every record. The instruction containing a use was
+// kept there once but is now found from the spans of the instructions
+static constexpr uint32_t NO_ENTITY = ~0U;
+
+// The limits on the cache directory. A cache file takes 24 bytes for every
+// use, definition and span, so this holds the links of many large modules
+static constexpr uint64_t MAX_CACHE_SIZE = 1ULL << 30;
+static constexpr std::chrono::hours MAX_CACHE_AGE(24 * 30);
+
+struct CacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t llvm_version;
+  uint64_t size;
+  uint64_t hash;
+  uint64_t passes;
+  uint32_t canonical;
+  uint32_t num_entities;
+  uint64_t num_spans;
+  uint64_t num_defs;
+  uint64_t num_uses;
+};
+
+// Every table in the cache is made up of these. The other entity is not
+// used and is always NO_ENTITY
+struct CacheRecord {
+  uint32_t entity;
+  uint32_t other;
+  uint64_t begin;
+  uint64_t end;
+};
+
+// True if the buffer holds exactly the header and the records that it
+// says follow it. Each count is checked on its own first so that a corrupt
+// header can't overflow the sum
+static bool
+has_records(const llvm::MemoryBuffer& buf) {
+  uint64_t size = buf.getBufferSize();
+  if(size < sizeof(CacheHeader))
+    return false;
+
+  const auto* header
+      = reinterpret_cast<const CacheHeader*>(buf.getBufferStart());
+  uint64_t max = (size - sizeof(CacheHeader)) / sizeof(CacheRecord);
+  if((header->num_spans > max) or (header->num_defs > max)
+     or (header->num_uses > max))
+    return false;
+  uint64_t records = header->num_spans + header->num_defs + header->num_uses;
+  return size == sizeof(CacheHeader) + records * sizeof(CacheRecord);
+}
+
+// The cache files are pruned in the order in which they were last used, so
+// the modification time of a file is updated whenever it is read
+static void
+touch(const std::string& path) {
+  int fd;
+  if(llvm::sys::fs::openFileForWrite(
+         path, fd, llvm::sys::fs::CD_OpenExisting, llvm::sys::fs::OF_None))
+    return;
+#if LLVM_VERSION_MAJOR >= 10
+  llvm::sys::fs::setLastAccessAndModificationTime(
+      fd, std::chrono::system_clock::now());
+#else
+  llvm::sys::fs::setLastModificationAndAccessTime(
+      fd, std::chrono::system_clock::now());
+#endif
+  llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+}
+
+// Remove the cache files in the directory that are too old and then the
+// least recently used ones until the rest fit. The file that was just saved
+// is always kept. Temporary files are only removed once they are old, since
+// another process may still be writing them
+static void
+prune(llvm::StringRef dir, const std::string& keep) {
+  struct Entry {
+    std::string path;
+    uint64_t size;
+    llvm::sys::TimePoint<> used;
+  };
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+  auto now       = std::chrono::system_clock::now();
+
+  std::error_code ec;
+  for(llvm::sys::fs::directory_iterator it(dir, ec), end;
+      not ec and (it != end);
+      it.increment(ec)) {
+    const std::string& path = it->path();
+    llvm::StringRef ext     = llvm::sys::path::extension(path);
+    if(((ext != ".lbc") and (ext != ".tmp")) or (path == keep))
+      continue;
+
+    llvm::ErrorOr<llvm::sys::fs::basic_file_status> status = it->status();
+    if(not status)
+      continue;
+    if(now - status->getLastModificationTime() > MAX_CACHE_AGE)
+      llvm::sys::fs::remove(path);
+    else if(ext == ".lbc")
+      entries.push_back(
+          {path, status->getSize(), status->getLastModificationTime()});
+  }
+
+  uint64_t kept = 0;
+  if(not llvm::sys::fs::file_size(keep, kept))
+    total += kept;
+  for(const Entry& entry : entries)
+    total += entry.size;
+  std::sort(entries.begin(), entries.end(), [](const Entry& l, const Entry& r) {
+    return l.used < r.used;
+  });
+  for(const Entry& entry : entries) {
+    if(total <= MAX_CACHE_SIZE)
+      break;
+    if(not llvm::sys::fs::remove(entry.path))
+      total -= entry.size;
+  }
+}
+
+LinkCache::LinkCache(const std::string& file,
+                     llvm::StringRef contents,
+                     const LoadOptions& options) :
+    file(file),
+    size(contents.size()),
+    hash(llvm::xxHash64(contents)),
+    passes(options.passes.empty() ? 0 : llvm::xxHash64(options.passes)),
+    canonical(options.canonical) {
+  llvm::SmallString<128> dir;
+  if(not llvm::sys::path::cache_directory(dir)) {
+    warning() << "Could not find cache directory. Not caching links\n";
+    return;
+  }
+  llvm::sys::path::append(dir, "llvm-browse");
+  // The text that is linked is the module as printed after the passes have
+  // run, so the links for the same file differ from one pipeline to another
+  path = (dir + "/" + llvm::utohexstr(hash) + (canonical ? ".c" : "")
+          + (passes ? "." + llvm::utohexstr(passes) : "") + ".lbc")
+             .str();
+
+  // The file might not be big enough to hold a header or it might be from
+  // an older version. None of these are errors. It will just be replaced
+  // once the module has been linked
+  if(llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buf_or_err
+     = llvm::MemoryBuffer::getFile(path, -1, false)) {
+    std::unique_ptr<llvm::MemoryBuffer> buf = std::move(buf_or_err.get());
+    if(not has_records(*buf))
+      return;
+
+    const auto* header
+        = reinterpret_cast<const CacheHeader*>(buf->getBufferStart());
+    if(std::memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC))
+       or (header->version != CACHE_VERSION)
+       or (header->llvm_version != LLVM_VERSION_MAJOR)
+       or (header->size != size) or (header->hash != hash)
+       or (header->passes != passes)
+       or (header->canonical != canonical))
+      return;
+
+    buffer = std::move(buf);
+    touch(path);
+  }
+}
+
+void
+LinkCache::number(Module& module) {
+  entities.clear();
+  ids.clear();
+  auto add = [this](INavigable& n) {
+    if(ids.insert(std::make_pair(&n, entities.size())).second)
+      entities.push_back(&n);
+  };
+
+  llvm::Module& llvm = module.get_llvm();
+  for(llvm::StructType* llvm_sty : llvm.getIdentifiedStructTypes())
+    if(llvm_sty->hasName())
+      add(module.get(llvm_sty));
+  for(const llvm::Function& llvm_f : llvm.functions())
+    if(const llvm::Comdat* llvm_c = llvm_f.getComdat())
+      add(module.get(*llvm_c));
+  for(const llvm::GlobalVariable& llvm_g : llvm.globals())
+    if(const llvm::Comdat* llvm_c = llvm_g.getComdat())
+      add(module.get(*llvm_c));
+  for(const llvm::GlobalVariable& llvm_g : llvm.globals())
+    if(module.contains(llvm_g))
+      add(module.get(llvm_g));
+  for(const llvm::GlobalAlias& llvm_a : llvm.aliases())
+    add(module.get(llvm_a));
+  for(const llvm::Function& llvm_f : llvm.functions()) {
+    add(module.get(llvm_f));
+    for(const llvm::Argument& llvm_arg : llvm_f.args())
+      add(module.get(llvm_arg));
+    for(const llvm::BasicBlock& llvm_bb : llvm_f) {
+      add(module.get(llvm_bb));
+      for(const llvm::Instruction& llvm_inst : llvm_bb)
+        add(module.get(llvm_inst));
+    }
+  }
+  // The metadata nodes are never sorted, so they are still in the order of
+  // their slots
+  for(MDNode* md : module.m_metadata)
+    add(*md);
+}
+
+bool
+LinkCache::has_links() const {
+  return buffer.get();
+}
+
+bool
+LinkCache::load(Module& module) {
+  if(not buffer)
+    return false;
+  if(not has_records(*buffer)) {
+    warning() << "Link cache is truncated. Ignoring\n";
+    buffer.reset();
+    return false;
+  }
+
+  number(module);
+
+  const auto* header
+      = reinterpret_cast<const CacheHeader*>(buffer->getBufferStart());
+  const auto* spans = reinterpret_cast<const CacheRecord*>(header + 1);
+  const auto* defs  = spans + header->num_spans;
+  const auto* uses  = defs + header->num_defs;
+  const auto* end   = uses + header->num_uses;
+
+  // Check everything before adding anything, so the module can still be
+  // linked as usual if the cache turns out not to match. The ranges are
+  // used to slice the IR later, so none may run past the end of it
+  uint64_t ir = module.buffer->getBufferSize();
+  bool valid  = (header->num_entities == entities.size());
+  for(const CacheRecord* r = spans; valid and (r != end); r++)
+    valid = (r->entity < entities.size()) and (r->begin <= r->end)
+            and (r->end <= ir);
+  if(not valid) {
+    warning() << "Link cache does not match module. Ignoring\n";
+    buffer.reset();
+    return false;
+  }
+
+  for(const CacheRecord* r = spans; r != defs; r++)
+    entities[r->entity]->set_llvm_span(LLVMRange(r->begin, r->end));
+  for(const CacheRecord* r = defs; r != uses; r++)
+    module.add_definition(*entities[r->entity], r->begin, r->end);
+  for(const CacheRecord* r = uses; r != end; r++)
+    module.add_use(*entities[r->entity], r->begin, r->end);
+
+  return true;
+}
+
+bool
+LinkCache::save(Module& module) {
+  if(path.empty())
+    return false;
+
+  message() << "Saving link cache\n";
+  number(module);
+
+  std::vector<CacheRecord> spans;
+  std::vector<CacheRecord> defs;
+  std::vector<CacheRecord> uses;
+  for(uint32_t i = 0; i < entities.size(); i++) {
+    const INavigable* n = entities[i];
+    if((isa<Function>(n) or isa<BasicBlock>(n) or isa<Instruction>(n))
+       and n->has_llvm_span())
+      spans.push_back({i,
+                       NO_ENTITY,
+                       n->get_llvm_span().get_begin(),
+                       n->get_llvm_span().get_end()});
+  }
+  for(size_t i = 0; i < module.defs.size(); i++) {
+    const INavigable& defined = module.defs.get_value(i);
+    if(isa<BasicBlock>(&defined) or isa<Instruction>(&defined))
+      defs.push_back({ids.lookup(&defined),
+                      NO_ENTITY,
+                      module.defs.get_begin(i),
+                      module.defs.get_end(i)});
+  }
+  for(size_t i = 0; i < module.uses.size(); i++) {
+    auto it = ids.find(&module.uses.get_value(i));
+    if(it == ids.end()) {
+      warning() << "Use of unknown entity. Not caching links\n";
+      return false;
+    }
+    uses.push_back({it->second,
+                    NO_ENTITY,
+                    module.uses.get_begin(i),
+                    module.uses.get_end(i)});
+  }
+
+  CacheHeader header;
+  std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.version      = CACHE_VERSION;
+  header.llvm_version = LLVM_VERSION_MAJOR;
+  header.size         = size;
+  header.hash         = hash;
+  header.passes       = passes;
+  header.canonical    = canonical;
+  header.num_entities = entities.size();
+  header.num_spans    = spans.size();
+  header.num_defs     = defs.size();
+  header.num_uses     = uses.size();
+
+  // Write to a temporary file first so a cache that is only partly written
+  // is never seen by anyone else opening the same file
+  if(std::error_code ec = llvm::sys::fs::create_directories(
+         llvm::sys::path::parent_path(path))) {
+    warning() << "Could not create cache directory: " << ec.message() << "\n";
+    return false;
+  }
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for(const std::vector<CacheRecord>* table : {&spans, &defs, &uses})
+      out.write(reinterpret_cast<const char*>(table->data()),
+                table->size() * sizeof(CacheRecord));
+    if(not out) {
+      warning() << "Could not write link cache: " << tmp << "\n";
+      llvm::sys::fs::remove(tmp);
+      return false;
+    }
+  }
+  if(std::error_code ec = llvm::sys::fs::rename(tmp, path)) {
+    warning() << "Could not write link cache: " << ec.message() << "\n";
+    llvm::sys::fs::remove(tmp);
+    return false;
+  }
+  prune(llvm::sys::path::parent_path(path), path);
+
+  return true;
+}
+
+} // namespace lb
@@ -0,0 +1,92 @@
+#ifndef LLVM_BROWSE_LINK_CACHE_H
+#define LLVM_BROWSE_LINK_CACHE_H
+
+#include "LoadOptions.h"
+#include "Typedefs.h"
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lb {
+
+class INavigable;
+class Module;
+
+// A cache of the results of linking a module that is kept on disk between
+// runs. Most of the time spent loading a large module goes into matching
+// the operands of instructions to the text of the IR, so the uses, the
+// definitions of basic blocks and instructions and the spans of functions,
+// basic blocks and instructions are saved once they are all known. The
+// next time the same file is opened, they are read back instead.
+//
+// The definitions of the top-level entities are not cached because they
+// come from the declaration index, which is built while LLVM parses the IR
+// anyway. The source ranges come from the debug information when the
+// wrappers are created, so they don't need to be cached either.
+//
+// The cache files live in the user's cache directory ($XDG_CACHE_HOME or
+// ~/.cache) and are named by a hash of the contents of the file. The size
+// of the file, the version of LLVM, the pass pipeline that was run on the
+// module and whether the module was printed in canonical mode are checked
+// as well before the cache is used. The modification time is not, because
+// copying or checking out a file changes it without changing the links.
+// Entities are identified by their position in a walk over the LLVM
+// module, which is the same every time the module is parsed.
+//
+// Nothing else ever removes the cache files, so the directory is pruned
+// every time a cache is saved. Files that haven't been used for a month are
+// removed, and then the least recently used ones until the rest fit in a
+// fixed budget.
+//
+// The cache file is a header followed by arrays of fixed-size records, so
+// it is mapped into memory and read in place.
+//
+class LinkCache {
+protected:
+  // The file that is being loaded and the cache file for it
+  std::string file;
+  std::string path;
+
+  uint64_t size;
+  uint64_t hash;
+  uint64_t passes;
+  bool canonical;
+
+  // This is only set if a cache was found that matches the file
+  std::unique_ptr<llvm::MemoryBuffer> buffer;
+
+  // The entities in the order in which they are numbered
+  std::vector<INavigable*> entities;
+  llvm::DenseMap<const INavigable*, uint32_t> ids;
+
+protected:
+  void number(Module& module);
+
+public:
+  LinkCache(const std::string& file,
+            llvm::StringRef contents,
+            const LoadOptions& options);
+  virtual ~LinkCache() = default;
+
+  // True if a cache matching the file was found and hasn't been rejected
+  bool has_links() const;
+
+  // Add the cached links to the module. The wrappers for all the entities
+  // including those in the function bodies must have been created. Nothing
+  // is added if the cache doesn't match the module, in which case false is
+  // returned and the module must be linked as usual
+  bool load(Module& module);
+
+  // Save the links in the module. Everything must have been linked
+  bool save(Module& module);
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_LINK_CACHE_H
@@ -0,0 +1,88 @@
+#ifndef LLVM_BROWSE_LOAD_OPTIONS_H
+#define LLVM_BROWSE_LOAD_OPTIONS_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace lb {
+
+// The phases through which a module goes while it is being loaded. They are
+// always entered in this order, although some may be skipped
+enum class LoadPhase {
+  Parsing,
+  Indexing,
+  TopLevel,
+  Functions,
+  Metadata,
+  Done,
+};
+
+// Called as a module is loaded. done and total are in whatever units make
+// sense for the phase - bytes when parsing and indexing, functions when
+// linking function bodies. total is 0 if the amount of work is not known
+using LoadProgress
+    = std::function<void(LoadPhase phase, uint64_t done, uint64_t total)>;
+
+// Options that control how a module is loaded and linked
+struct LoadOptions {
+  // The number of threads used to link the function bodies. If this is 0,
+  // as many threads as there are cores will be used. No more threads than
+  // there are cores are ever used
+  unsigned num_threads = 1;
+
+  // If true, the module is printed by LLVM and the printed text is shown
+  // instead of the contents of the file. The offsets of the functions,
+  // basic blocks and instructions are recorded while printing, so they
+  // don't have to be searched for. This needs LLVM 13 or later and is
+  // ignored otherwise
+  bool canonical = false;
+
+  // If true, the operands of all the metadata nodes are linked when the
+  // module is loaded. Otherwise, they are linked only when the uses of a
+  // node are requested or the cursor is on the line defining the node
+  bool eager_metadata = false;
+
+  // If true, only the top-level entities are linked when the module is
+  // loaded. The arguments, basic blocks and instructions of a function are
+  // created and linked the first time anything needs them
+  bool lazy_functions = false;
+
+  // If true and the file is bitcode, only the globals, declarations and
+  // metadata are read when the module is loaded. The bodies of the functions
+  // stay in the bitcode and are shown empty until they are read with
+  // Module::read_body(). This needs LLVM 13 or later and the cache is never
+  // used because the module is never fully linked
+  bool lazy_bitcode = false;
+
+  // If true and the IR is printed by LLVM - because the file is bitcode or
+  // the module is loaded in canonical mode or with passes - the printed text
+  // is not kept once the module has been linked. The functions, global
+  // variables and metadata nodes are printed again when their text is asked
+  // for, so everything is linked when the module is loaded
+  bool virtual_document = false;
+
+  // The number of bytes of text printed again for a virtual document that
+  // are kept around. The least recently used text is dropped past this
+  uint64_t document_cache = 64 << 20;
+
+  // If true, the links are read from a cache on disk if the same file has
+  // been loaded before and saved to it otherwise. Saving the links needs
+  // everything to be linked, so the first load is never lazy
+  bool use_cache = false;
+
+  // If not empty, this pass pipeline is run on the module after it has been
+  // parsed. It is written as it would be for opt -passes. The IR that is
+  // shown is the module as printed by LLVM after the passes have run. This
+  // needs LLVM 13 or later and is ignored otherwise
+  std::string passes;
+
+  // If set, this is called at the start of every phase and periodically
+  // during the long ones. It may be called from any of the threads used to
+  // load the module, but never from more than one at a time
+  LoadProgress progress;
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_LOAD_OPTIONS_H
@@ -5,7 +5,7 @@ namespace lb {
 
 MDNode::MDNode(const llvm::MDNode& llvm, unsigned slot, Module& module) :
     INavigable(EntityKind::MDNode), IWrapper<llvm::MDNode>(llvm, module) {
-  set_tag(slot, "!");
+  set_tag(module.get_arena(), slot, "!");
 }
 
 bool
@@ -17,9 +17,22 @@ MDNode::is_artificial() const {
   return true;
 }
 
+std::vector<Use>
+MDNode::uses() const {
+  get_module().link_metadata_uses(*this);
+  return INavigable::uses();
+}
+
+unsigned
+MDNode::get_num_uses() const {
+  get_module().link_metadata_uses(*this);
+  return INavigable::get_num_uses();
+}
+
 MDNode&
 MDNode::make(const llvm::MDNode& llvm_md, unsigned slot, Module& module) {
-  auto* md = new MDNode(llvm_md, slot, module);
+  void* mem = module.arena.allocate<MDNode>();
+  auto* md  = new(mem) MDNode(llvm_md, slot, module);
   module.m_metadata.emplace_back(md);
   module.mmap[&llvm_md] = md;
 
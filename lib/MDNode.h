@@ -27,6 +27,12 @@ public:
 
   bool is_artificial() const;
 
+  // The operands of metadata nodes are linked lazily, so the uses of a node
+  // may not be known until they are asked for. These hide the ones in
+  // INavigable so the uses get linked first
+  std::vector<Use> uses() const;
+  unsigned get_num_uses() const;
+
 public:
   static bool classof(const INavigable* v) {
     return v->get_kind() == EntityKind::MDNode;
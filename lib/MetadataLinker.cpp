@@ -0,0 +1,132 @@
+#include "MetadataLinker.h"
+#include "Lexer.h"
+#include "Logging.h"
+#include "MDNode.h"
+#include "Module.h"
+#include "Token.h"
+#include "Use.h"
+
+#include <llvm/IR/Metadata.h>
+
+using llvm::dyn_cast_or_null;
+
+namespace lb {
+
+MetadataLinker::MetadataLinker(llvm::StringRef ir,
+                               Module& module,
+                               Offset base) :
+    ir(ir), module(module), base(base) {
+  ;
+}
+
+void
+MetadataLinker::add(MDNode& md) {
+  pending.emplace(md.get_llvm_defn().get_begin(), &md);
+  for(const llvm::MDOperand& mop : md.get_llvm().operands())
+    if(const auto* llvm_op = dyn_cast_or_null<llvm::MDNode>(mop))
+      if(module.contains(*llvm_op))
+        users[&module.get(*llvm_op)].push_back(&md);
+}
+
+void
+MetadataLinker::link_operands(MDNode& md, std::set<MDNode*>& touched) {
+  // The operands are printed in order on the line that defines the node,
+  // so each one is the next metadata token on the line with the same tag.
+  // Operands that are not nodes (strings, constants and null) never produce
+  // a metadata token with a numeric tag, so they don't need to be skipped
+  Token tok;
+  Lexer lexer(ir, md.get_llvm_defn().get_end() - base);
+  for(const llvm::MDOperand& mop : md.get_llvm().operands()) {
+    const auto* llvm_op = dyn_cast_or_null<llvm::MDNode>(mop);
+    if(not llvm_op or not module.contains(*llvm_op))
+      continue;
+
+    MDNode& op    = module.get(*llvm_op);
+    Offset cursor = lexer.get_cursor();
+    bool found    = false;
+    while(not found and lexer.next(tok) and not tok.is(TokenKind::Line))
+      found = tok.is(TokenKind::Metadata)
+              and (tok.get_text(ir) == op.get_tag());
+    if(found) {
+      module.add_use(op, tok.get_begin() + base, tok.get_end() + base);
+      touched.insert(&op);
+    } else {
+      warning() << "Could not find metadata operand: " << op.get_tag()
+                << "\n";
+      lexer.reset(cursor);
+    }
+  }
+}
+
+void
+MetadataLinker::link_pending(std::map<Offset, MDNode*>::iterator it,
+                             std::set<MDNode*>& touched) {
+  MDNode& md = *it->second;
+  pending.erase(it);
+  link_operands(md, touched);
+}
+
+void
+MetadataLinker::commit(const std::set<MDNode*>& touched) {
+  module.sort_late();
+  for(MDNode* md : touched)
+    md->sort_uses();
+}
+
+void
+MetadataLinker::link_at(Offset offset) {
+  auto it = pending.upper_bound(offset);
+  if(it == pending.begin())
+    return;
+
+  --it;
+  Offset eol = ir.find('\n', it->first - base);
+  if(offset - base > eol)
+    return;
+
+  std::set<MDNode*> touched;
+  link_pending(it, touched);
+  commit(touched);
+}
+
+void
+MetadataLinker::link_uses(const MDNode& md) {
+  auto it = users.find(&md);
+  if(it == users.end())
+    return;
+
+  std::set<MDNode*> touched;
+  for(MDNode* user : it->second) {
+    auto p = pending.find(user->get_llvm_defn().get_begin());
+    if(p != pending.end())
+      link_pending(p, touched);
+  }
+  users.erase(it);
+  commit(touched);
+}
+
+void
+MetadataLinker::link_all() {
+  std::set<MDNode*> touched;
+  for(auto& i : pending)
+    link_operands(*i.second, touched);
+  pending.clear();
+  users.clear();
+  commit(touched);
+}
+
+bool
+MetadataLinker::has_pending() const {
+  return pending.size();
+}
+
+void
+MetadataLinker::moved(llvm::StringRef ir) {
+  this->ir = ir;
+  std::map<Offset, MDNode*> moved;
+  for(auto& i : pending)
+    moved.emplace(i.second->get_llvm_defn().get_begin(), i.second);
+  pending.swap(moved);
+}
+
+} // namespace lb
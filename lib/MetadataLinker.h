@@ -0,0 +1,79 @@
+#ifndef LLVM_BROWSE_METADATA_LINKER_H
+#define LLVM_BROWSE_METADATA_LINKER_H
+
+#include "Typedefs.h"
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringRef.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+namespace lb {
+
+class MDNode;
+class Module;
+
+// Links the operands of metadata nodes to the text in the IR. There can be
+// a very large number of metadata nodes - TBAA and loop metadata in
+// particular - and most of the links will never be looked at, so the
+// operands of a node are only linked when something asks for them. This is
+// either when the uses of one of the operands are requested or when the
+// cursor is on the line on which the node is defined. Once the operands of
+// a node have been linked, they stay linked.
+//
+// The uses created here are merged into the sorted lists of uses of the
+// module and the operands as they are created, so the module always looks
+// as if everything was linked when it was loaded.
+//
+class MetadataLinker {
+protected:
+  llvm::StringRef ir;
+  Module& module;
+
+  // The offset in the IR of the module at which the text begins
+  Offset base;
+
+  // The nodes whose operands have not been linked yet, keyed by the offset
+  // of the start of the line on which they are defined
+  std::map<Offset, MDNode*> pending;
+
+  // The nodes that have a given node as an operand
+  llvm::DenseMap<const MDNode*, std::vector<MDNode*>> users;
+
+protected:
+  void link_operands(MDNode& md, std::set<MDNode*>& touched);
+  void link_pending(std::map<Offset, MDNode*>::iterator it,
+                    std::set<MDNode*>& touched);
+  void commit(const std::set<MDNode*>& touched);
+
+public:
+  MetadataLinker(llvm::StringRef ir, Module& module, Offset base = 0);
+  virtual ~MetadataLinker() = default;
+
+  // Add a node whose operands should be linked. The node must have a
+  // definition
+  void add(MDNode& md);
+
+  // Link the operands of the node defined on the line containing offset if
+  // there is such a node and it has not been linked yet
+  void link_at(Offset offset);
+
+  // Link all the nodes that have md as an operand, so all the uses of md
+  // are known
+  void link_uses(const MDNode& md);
+
+  // Link the operands of all the nodes that have not been linked yet
+  void link_all();
+
+  bool has_pending() const;
+
+  // The IR has changed and the nodes after the change have moved. This is
+  // all of the new IR
+  void moved(llvm::StringRef ir);
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_METADATA_LINKER_H
@@ -1,19 +1,26 @@
 #include "Module.h"
 #include "Argument.h"
 #include "BasicBlock.h"
+#include "Document.h"
 #include "Function.h"
 #include "GlobalAlias.h"
 #include "GlobalVariable.h"
 #include "Instruction.h"
+#include "LinkCache.h"
 #include "Logging.h"
 #include "MDNode.h"
 #include "Parser.h"
+#include "StringMemoryBuffer.h"
 #include "StructType.h"
 
+#include <llvm/ADT/SmallString.h>
 #include <llvm/Bitcode/BitcodeReader.h>
 #include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/raw_ostream.h>
 
+#include <algorithm>
+#include <cmath>
+
 using llvm::cast;
 using llvm::dyn_cast;
 using llvm::isa;
@@ -29,15 +36,41 @@ Module::Module(std::unique_ptr<llvm::Module> module,
   ;
 }
 
-llvm::StringRef
-Module::get_full_path(llvm::StringRef dir, llvm::StringRef file) {
-  std::string buf;
-  llvm::raw_string_ostream ss(buf);
+unsigned
+Module::get_file_id(llvm::StringRef dir, llvm::StringRef file) {
+  auto cached = file_cache.find(std::make_pair(dir.data(), file.data()));
+  if(cached != file_cache.end())
+    return cached->second;
+
+  llvm::SmallString<256> buf;
+  llvm::raw_svector_ostream ss(buf);
   if(dir.size())
     ss << dir << "/";
   ss << file;
-  auto it = files.insert(ss.str()).first;
-  return llvm::StringRef(*it);
+  auto it = file_ids.try_emplace(ss.str(), file_names.size() + 1);
+  if(it.second)
+    file_names.push_back(it.first->getKey());
+  file_cache[std::make_pair(dir.data(), file.data())] = it.first->second;
+
+  return it.first->second;
+}
+
+llvm::StringRef
+Module::get_file(unsigned id) const {
+  if(not id or id > file_names.size())
+    return llvm::StringRef();
+  return file_names[id - 1];
+}
+
+SourceRange
+Module::get_source_range(const SourceLocation& loc) const {
+  if(not loc)
+    return SourceRange();
+  return SourceRange(get_file(loc.get_file()),
+                     loc.get_begin_line(),
+                     loc.get_begin_column(),
+                     loc.get_end_line(),
+                     loc.get_end_column());
 }
 
 bool
@@ -150,14 +183,37 @@ Module::get(const llvm::Value& llvm) const {
   return get<Value>(llvm);
 }
 
+const Document&
+Module::get_document() const {
+  return *document;
+}
+
 llvm::MemoryBufferRef
 Module::get_code_buffer() const {
+  // A virtual document keeps almost none of the text, so it only has to be
+  // assembled if something needs all of it at once
+  if(document and document->is_virtual()) {
+    std::lock_guard<std::mutex> lock(assembling);
+    if(not buffer)
+      buffer = StringMemoryBuffer::make(
+          document->get_text(0, document->get_size()), document->get_name());
+  }
   return buffer->getMemBufferRef();
 }
 
 llvm::StringRef
 Module::get_code() const {
-  return buffer->getBuffer();
+  return get_code_buffer().getBuffer();
+}
+
+std::string
+Module::get_text(Offset begin, Offset end) const {
+  return document->get_text(begin, end);
+}
+
+Offset
+Module::get_code_size() const {
+  return document->get_size();
 }
 
 llvm::iterator_range<Module::AliasIterator>
@@ -276,7 +332,7 @@ get_offset_end<Comdat>(const Comdat& c) {
 template<typename T>
 static const T*
 bin_search(Offset offset,
-           const std::vector<std::unique_ptr<T>>& vec,
+           const std::vector<T*>& vec,
            unsigned left,
            unsigned right) {
   // left and right are unsigned, so if right goes to -1, it will still be 
@@ -293,12 +349,12 @@ bin_search(Offset offset,
   else if(offset > end)
     return bin_search(offset, vec, mid + 1, right);
   else
-    return vec[mid].get();
+    return vec[mid];
 }
 
 template<typename T>
 static const T*
-bin_search(Offset offset, const std::vector<std::unique_ptr<T>>& vec) {
+bin_search(Offset offset, const std::vector<T*>& vec) {
   return bin_search(offset, vec, 0, vec.size() - 1);
 }
 
@@ -307,7 +363,21 @@ Module::get_use_at(Offset offset) const {
   if(not offset)
     return nullptr;
 
-  return bin_search(offset, uses);
+  // If this is in the body of a function or on the line defining a metadata
+  // node, it may not have been linked yet
+  if(fn_linker)
+    fn_linker->link_at(offset);
+  if(md_linker)
+    md_linker->link_at(offset);
+
+  for(const RangeTable* table : {&uses, &late_uses}) {
+    size_t idx = table->find(offset);
+    if(idx != RangeTable::npos)
+      return &keep(Use(table->get_begin(idx),
+                       table->get_end(idx),
+                       table->get_value(idx)));
+  }
+  return nullptr;
 }
 
 const Definition*
@@ -315,7 +385,17 @@ Module::get_definition_at(Offset offset) const {
   if(not offset)
     return nullptr;
 
-  return bin_search(offset, defs);
+  if(fn_linker)
+    fn_linker->link_at(offset);
+
+  for(const RangeTable* table : {&defs, &late_defs}) {
+    size_t idx = table->find(offset);
+    if(idx != RangeTable::npos)
+      return &keep(Definition(table->get_begin(idx),
+                              table->get_end(idx),
+                              table->get_value(idx)));
+  }
+  return nullptr;
 }
 
 const Instruction*
@@ -357,7 +437,10 @@ Module::get_function_at(Offset offset) const {
   if(not offset)
     return nullptr;
 
-  return bin_search(offset, m_functions);
+  const Function* f = bin_search(offset, m_functions);
+  if(f)
+    link_function(*f);
+  return f;
 }
 
 const Comdat*
@@ -368,32 +451,63 @@ Module::get_comdat_at(Offset offset) const {
   return bin_search(offset, m_comdats);
 }
 
+void
+Module::add_use(INavigable& used, Offset begin, Offset end) {
+  used.add_use(begin);
+  new_uses.push_back({begin, end, &used});
+}
+
+void
+Module::add_definition(INavigable& defined, Offset begin, Offset end) {
+  defined.set_llvm_defn(LLVMRange(begin, end));
+  new_defs.push_back({begin, end, &defined});
+}
+
+// Sort the rows that were added and fold them and the late table into the
+// sorted one. The rows that were added are only needed until then
+static void
+fold(std::vector<RangeTable::Entry>& added,
+     RangeTable& sorted,
+     RangeTable& late) {
+  RangeTable table;
+  table.assign(added);
+  std::vector<RangeTable::Entry>().swap(added);
+  sorted.merge(late);
+  sorted.merge(table);
+}
+
+// Value is not navigable itself, so the wrappers in the value map have to
+// be cast to what they are to get at their uses and definitions
+static INavigable*
+get_navigable(Value* v) {
+  if(auto* f = dyn_cast<Function>(v))
+    return f;
+  else if(auto* arg = dyn_cast<Argument>(v))
+    return arg;
+  else if(auto* bb = dyn_cast<BasicBlock>(v))
+    return bb;
+  else if(auto* inst = dyn_cast<Instruction>(v))
+    return inst;
+  else if(auto* alias = dyn_cast<GlobalAlias>(v))
+    return alias;
+  else if(auto* g = dyn_cast<GlobalVariable>(v))
+    return g;
+  return nullptr;
+}
+
 void
 Module::sort() {
   message() << "Sorting all uses\n";
 
-  std::sort(uses.begin(),
-            uses.end(),
-            [](const std::unique_ptr<Use>& l, const std::unique_ptr<Use>& r) {
-              return l->get_begin() < r->get_begin();
-            });
+  // The sorts are stable so the order of the uses and definitions that
+  // start at the same offset is the order in which they were added. This
+  // keeps the order the same when they are read back from the link cache
+  fold(new_uses, uses, late_uses);
 
   message() << "Sort entity uses\n";
-  for(auto& i : vmap) {
-    Value* v = i.second;
-    if(auto* f = dyn_cast<Function>(v))
-      f->sort_uses();
-    else if(auto* arg = dyn_cast<Argument>(v))
-      arg->sort_uses();
-    else if(auto* bb = dyn_cast<BasicBlock>(v))
-      bb->sort_uses();
-    else if(auto* inst = dyn_cast<Instruction>(v))
-      inst->sort_uses();
-    else if(auto* alias = dyn_cast<GlobalAlias>(v))
-      alias->sort_uses();
-    else if(auto* g = dyn_cast<GlobalVariable>(v))
-      g->sort_uses();
-  }
+  for(auto& i : vmap)
+    if(INavigable* n = get_navigable(i.second))
+      n->sort_uses();
   for(auto& i : tmap)
     i.second->sort_uses();
   for(auto& i : mmap)
@@ -401,30 +515,137 @@ Module::sort() {
 
   // First
   message() << "Sorting definitions\n";
-  std::sort(defs.begin(),
-            defs.end(),
-            [](const std::unique_ptr<Definition>& l,
-               const std::unique_ptr<Definition>& r) {
-              return l->get_begin() < r->get_begin();
-            });
+  fold(new_defs, defs, late_defs);
 
   message() << "Sorting functions\n";
+  sort_functions();
+
+  message() << "Sorting comdats\n";
+  std::sort(m_comdats.begin(),
+            m_comdats.end(),
+            [](const Comdat* l, const Comdat* r) {
+              return l->get_self_llvm_defn().get_begin()
+                     < r->get_self_llvm_defn().get_begin();
+            });
+}
+
+// Only the new rows need to be sorted before they are merged into the
+// late table. Merging into the late table costs time proportional to its
+// size and folding it into the sorted one costs time proportional to all
+// of them, so letting the late table grow to about the square root of the
+// whole keeps both small when functions are linked one at a time
+static void
+merge_late(std::vector<RangeTable::Entry>& added,
+           RangeTable& sorted,
+           RangeTable& late) {
+  RangeTable table;
+  table.assign(added);
+  added.clear();
+  late.merge(table);
+
+  size_t root  = static_cast<size_t>(std::sqrt(sorted.size()));
+  size_t limit = std::max<size_t>(256, 4 * root);
+  if(late.size() > limit)
+    sorted.merge(late);
+}
+
+void
+Module::sort_late() {
+  merge_late(new_uses, uses, late_uses);
+  merge_late(new_defs, defs, late_defs);
+}
+
+void
+Module::sort_functions() {
   std::sort(m_functions.begin(),
             m_functions.end(),
-            [](const std::unique_ptr<Function>& l,
-               const std::unique_ptr<Function>& r) {
+            [](const Function* l, const Function* r) {
               return l->get_llvm_span().get_begin()
                      < r->get_llvm_span().get_begin();
             });
+}
 
-  message() << "Sorting comdats\n";
-  std::sort(
-      m_comdats.begin(),
-      m_comdats.end(),
-      [](const std::unique_ptr<Comdat>& l, const std::unique_ptr<Comdat>& r) {
-        return l->get_self_llvm_defn().get_begin()
-               < r->get_self_llvm_defn().get_begin();
-      });
+void
+Module::move(Offset begin, Offset end, Offset size) {
+  sort_late();
+  for(RangeTable* table : {&uses, &late_uses, &defs, &late_defs})
+    table->move(begin, end, size);
+  for(auto& i : vmap)
+    if(INavigable* n = get_navigable(i.second))
+      n->move(begin, end, size);
+  for(auto& i : cmap)
+    i.second->move(begin, end, size);
+  for(auto& i : mmap)
+    i.second->move(begin, end, size);
+  for(auto& i : tmap)
+    i.second->move(begin, end, size);
+
+  // The uses that were handed out are moved in place, so their addresses
+  // don't change
+  std::map<Offset, std::unique_ptr<Use>> moved;
+  for(auto& i : kept_uses) {
+    Use& use = *i.second;
+    if(use.get_begin() >= end)
+      use = Use(use.get_begin() - end + begin + size,
+                use.get_end() - end + begin + size,
+                use.get_used());
+    moved.emplace(use.get_begin(), std::move(i.second));
+  }
+  kept_uses.swap(moved);
+  for(auto& i : kept_defs)
+    if(const LLVMRange& defn = i.first->get_llvm_defn())
+      i.second = Definition(defn.get_begin(), defn.get_end(), *i.first);
+}
+
+// The rows of both tables that begin in [begin, end] in the order in which
+// they appear in the IR
+template<typename T>
+static std::vector<T>
+get_in(const RangeTable& sorted,
+       const RangeTable& late,
+       Offset begin,
+       Offset end) {
+  std::vector<T> found;
+  auto copy = [&](const RangeTable& table) {
+    for(size_t i = table.lower_bound(begin);
+        (i < table.size()) and (table.get_begin(i) <= end);
+        i++)
+      found.emplace_back(
+          table.get_begin(i), table.get_end(i), table.get_value(i));
+  };
+  copy(sorted);
+  size_t mid = found.size();
+  copy(late);
+  std::inplace_merge(found.begin(),
+                     found.begin() + mid,
+                     found.end(),
+                     [](const T& l, const T& r) {
+                       return l.get_begin() < r.get_begin();
+                     });
+  return found;
+}
+
+std::vector<Use>
+Module::get_uses_in(Offset begin, Offset end) const {
+  return get_in<Use>(uses, late_uses, begin, end);
+}
+
+std::vector<Definition>
+Module::get_definitions_in(Offset begin, Offset end) const {
+  return get_in<Definition>(defs, late_defs, begin, end);
+}
+
+const Use&
+Module::keep(const Use& use) const {
+  std::unique_ptr<Use>& kept = kept_uses[use.get_begin()];
+  if(not kept)
+    kept.reset(new Use(use));
+  return *kept;
+}
+
+const Definition&
+Module::keep(const Definition& def) const {
+  return kept_defs.emplace(&def.get_defined(), def).first->second;
 }
 
 llvm::Module&
@@ -437,22 +658,27 @@ Module::get_llvm() const {
   return *llvm;
 }
 
+Arena&
+Module::get_arena() {
+  return arena;
+}
+
 bool
 Module::check_range(Offset begin, Offset end, llvm::StringRef tag) const {
-  return get_code().substr(begin, end - begin) == tag;
+  return document->equals(begin, end, tag);
 }
 
 bool
 Module::check_navigable(const INavigable& n) const {
   llvm::StringRef tag = n.get_tag();
-  if(const Definition& defn = n.get_llvm_defn()) {
+  if(const LLVMRange& defn = n.get_llvm_defn()) {
     Offset begin = defn.get_begin();
     Offset end   = defn.get_end();
     if(not check_range(begin, end, tag)) {
       critical() << "Definition mismatch" << endl
                  << "  Range:    " << begin << ", " << end << endl
                  << "  Expected: " << tag << endl
-                 << "  Got:      " << get_code().substr(begin, end - begin)
+                 << "  Got:      " << get_text(begin, end)
                  << "\n";
       return false;
     }
@@ -465,14 +691,14 @@ Module::check_navigable(const INavigable& n) const {
 
 bool
 Module::check_uses(const INavigable& n) const {
-  for(const Use* use : n.uses()) {
-    Offset begin = use->get_begin();
-    Offset end   = use->get_end();
+  for(const Use& use : n.uses()) {
+    Offset begin = use.get_begin();
+    Offset end   = use.get_end();
     if(not check_range(begin, end, n.get_tag())) {
       critical() << "Use mismatch" << endl
                  << "  Range:    " << begin << ", " << end << endl
                  << "  Expected: " << n.get_tag() << endl
-                 << "  Got:      " << get_code().substr(begin, end - begin)
+                 << "  Got:      " << get_text(begin, end)
                  << "\n";
       return false;
     }
@@ -487,6 +713,26 @@ Module::check_uses(const INavigable& n) const {
   return true;
 }
 
+void
+Module::link_metadata_uses(const MDNode& md) const {
+  if(fn_linker)
+    fn_linker->link_attached(md.get_llvm());
+  if(md_linker)
+    md_linker->link_uses(md);
+}
+
+void
+Module::link_function(const Function& f) const {
+  if(fn_linker)
+    fn_linker->link(f);
+}
+
+void
+Module::link_uses(const llvm::Value& llvm) const {
+  if(fn_linker)
+    fn_linker->link_users(llvm);
+}
+
 bool
 Module::check_top_level() const {
   message() << "Checking top-level entities\n";
@@ -507,6 +753,8 @@ Module::check_top_level() const {
 
 bool
 Module::check_all(bool check_metadata) const {
+  if(fn_linker)
+    fn_linker->link_all();
   if(not check_top_level())
     return false;
   message() << "Checking uses of aliases\n";
@@ -541,6 +789,8 @@ Module::check_all(bool check_metadata) const {
   }
   if(check_metadata) {
     message() << "Checking metadata\n";
+    if(md_linker)
+      md_linker->link_all();
     for(const MDNode& md : metadata())
       if(not check_navigable(md) or not check_uses(md))
         return false;
@@ -548,45 +798,246 @@ Module::check_all(bool check_metadata) const {
   return true;
 }
 
+std::unique_ptr<Module>
+Module::construct(std::unique_ptr<Parser> parser,
+                  std::unique_ptr<llvm::Module> llvm,
+                  std::unique_ptr<llvm::LLVMContext> context,
+                  std::unique_ptr<llvm::MemoryBuffer> mbuf,
+                  const LoadOptions& options,
+                  const Module* previous,
+                  LinkCache* cache) {
+  std::unique_ptr<Module> module(
+      new Module(std::move(llvm), std::move(context), std::move(mbuf)));
+  bool printed = parser->is_printed();
+  if(not parser->link(*module, cache, previous)) {
+    critical() << "Could not link module\n";
+    return nullptr;
+  }
+
+  module->sort();
+  // The function linker needs the parser to link the function bodies. The
+  // parser is still needed here to check the functions that are linked
+  // before the cache is saved
+  Parser* linker = parser.get();
+  if(module->fn_linker)
+    module->parser = std::move(parser);
+  if(options.eager_metadata and module->md_linker) {
+    message() << "Linking metadata\n";
+    module->md_linker->link_all();
+  }
+  // The links can only be saved once everything has been linked, so
+  // the first time a module is loaded, nothing is deferred
+  if(cache and not cache->has_links()) {
+    if(module->fn_linker)
+      module->fn_linker->link_all();
+    if(module->md_linker)
+      module->md_linker->link_all();
+    if(not linker->is_complete()) {
+      critical() << "Could not link module\n";
+      return nullptr;
+    }
+    cache->save(*module);
+  }
+
+  llvm::StringRef code = module->buffer->getBuffer();
+  llvm::StringRef name = module->buffer->getBufferIdentifier();
+  if(options.virtual_document and printed) {
+    // The linkers need the text, so nothing can be left for them to link
+    // once it has been dropped
+    if(module->fn_linker)
+      module->fn_linker->link_all();
+    if(module->md_linker)
+      module->md_linker->link_all();
+    module->fn_linker.reset();
+    module->md_linker.reset();
+    module->parser.reset();
+    module->document = Document::create_virtual(
+        *module, name, code, options.document_cache);
+    module->buffer.reset();
+  } else {
+    if(options.virtual_document)
+      message() << "IR was read from the file. Document is not virtual\n";
+    module->document = Document::create(*module, name, code);
+  }
+  message() << "Module constructed\n";
+  if(options.progress)
+    options.progress(LoadPhase::Done, 0, 0);
+
+  return module;
+}
+
 std::unique_ptr<const Module>
-Module::create(const std::string& file) {
-  std::unique_ptr<Module> module(nullptr);
+Module::create(std::unique_ptr<llvm::MemoryBuffer> fbuf,
+               const LoadOptions& options,
+               const Module* previous,
+               LinkCache* cache) {
   std::unique_ptr<llvm::LLVMContext> context(new llvm::LLVMContext());
+  std::unique_ptr<llvm::MemoryBuffer> mbuf(nullptr);
+  std::unique_ptr<llvm::Module> llvm(nullptr);
 
-  message() << "Opening file\n";
-  if(llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> file_or_err
-     = llvm::MemoryBuffer::getFile(file)) {
-    std::unique_ptr<llvm::MemoryBuffer> fbuf = std::move(file_or_err.get());
-    std::unique_ptr<llvm::MemoryBuffer> mbuf(nullptr);
-    std::unique_ptr<llvm::Module> llvm(nullptr);
-
-    // We need this check because llvm::isBitcode() assumes that the buffer is
-    // at least 4 bytes
-    if(fbuf->getBufferSize() > 4) {
-      Parser parser;
-      if(llvm::isBitcode(
-             reinterpret_cast<const unsigned char*>(fbuf->getBufferStart()),
-             reinterpret_cast<const unsigned char*>(fbuf->getBufferEnd())))
-        std::tie(llvm, mbuf) = parser.parse_bc(std::move(fbuf), *context);
-      else
-        std::tie(llvm, mbuf) = parser.parse_ir(std::move(fbuf), *context);
-
-      if(llvm) {
-        module.reset(
-            new Module(std::move(llvm), std::move(context), std::move(mbuf)));
-        parser.link(*module);
-
-        module->sort();
-        message() << "Module constructed\n";
-      }
-    } else {
-      critical() << "Could not find LLVM bitcode or IR\n";
-    }
+  // We need this check because llvm::isBitcode() assumes that the buffer is
+  // at least 4 bytes
+  if(fbuf->getBufferSize() <= 4) {
+    critical() << "Could not find LLVM bitcode or IR\n";
+    return nullptr;
+  }
+
+  std::unique_ptr<Parser> parser(new Parser(options));
+  if(llvm::isBitcode(
+         reinterpret_cast<const unsigned char*>(fbuf->getBufferStart()),
+         reinterpret_cast<const unsigned char*>(fbuf->getBufferEnd()))) {
+    if(options.lazy_bitcode)
+      return create(std::shared_ptr<llvm::MemoryBuffer>(std::move(fbuf)),
+                    options,
+                    previous);
+    std::tie(llvm, mbuf) = parser->parse_bc(std::move(fbuf), *context);
   } else {
-    error() << "Could not open file: " << file << "\n";
+    std::tie(llvm, mbuf) = parser->parse_ir(std::move(fbuf), *context);
   }
 
+  if(not llvm)
+    return nullptr;
+  return construct(std::move(parser),
+                   std::move(llvm),
+                   std::move(context),
+                   std::move(mbuf),
+                   options,
+                   previous,
+                   cache);
+}
+
+std::unique_ptr<const Module>
+Module::create(std::shared_ptr<llvm::MemoryBuffer> bitcode,
+               const LoadOptions& options,
+               const Module* previous) {
+  std::unique_ptr<llvm::LLVMContext> context(new llvm::LLVMContext());
+  std::unique_ptr<llvm::MemoryBuffer> mbuf(nullptr);
+  std::unique_ptr<llvm::Module> llvm(nullptr);
+
+  std::unique_ptr<Parser> parser(new Parser(options));
+  std::tie(llvm, mbuf)
+      = parser->parse_bc_lazily(bitcode->getMemBufferRef(), *context);
+  if(not llvm)
+    return nullptr;
+
+  std::unique_ptr<Module> module = construct(std::move(parser),
+                                             std::move(llvm),
+                                             std::move(context),
+                                             std::move(mbuf),
+                                             options,
+                                             previous,
+                                             nullptr);
+  if(not module)
+    return nullptr;
+  // The passes need all the bodies, so none are left in the bitcode.
+  // Otherwise, none of the bodies has been read, so there is nothing for
+  // the function linker to do. Each body is linked when it is read
+  if(options.passes.empty()) {
+    module->bitcode = std::move(bitcode);
+    module->fn_linker.reset();
+    module->parser.reset();
+    module->reader.reset(new BodyReader(*module, options));
+  }
   return module;
 }
 
+std::unique_ptr<const Module>
+Module::create(const std::string& file,
+               const LoadOptions& options,
+               const Module* previous) {
+  message() << "Opening file\n";
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> file_or_err
+      = llvm::MemoryBuffer::getFile(file);
+  if(not file_or_err) {
+    error() << "Could not open file: " << file << "\n";
+    return nullptr;
+  }
+
+  std::unique_ptr<llvm::MemoryBuffer> fbuf = std::move(file_or_err.get());
+  std::unique_ptr<LinkCache> cache(nullptr);
+  if(options.use_cache)
+    cache.reset(new LinkCache(file, fbuf->getBuffer(), options));
+  return create(std::move(fbuf), options, previous, cache.get());
+}
+
+std::unique_ptr<const Module>
+Module::edit(Offset begin,
+             Offset end,
+             llvm::StringRef text,
+             const LoadOptions& options) const {
+  // The edit may not touch the braces around the body. That way, only the
+  // text of the function being edited changes
+  const Function* f = get_function_at(begin);
+  if(not f or (begin > end) or (begin <= f->get_llvm_span().get_begin())
+     or (end > f->get_llvm_span().get_end())) {
+    error() << "Edit is not inside the body of a function\n";
+    return nullptr;
+  }
+
+  // The bodies that are still in the bitcode are empty in the IR, which
+  // can't be parsed
+  if(has_unread_bodies()) {
+    error() << "Cannot edit a module whose bodies have not all been read\n";
+    return nullptr;
+  }
+
+  message() << "Editing " << f->get_tag() << "\n";
+  Offset size = document->get_size();
+  std::unique_ptr<llvm::WritableMemoryBuffer> edited
+      = llvm::WritableMemoryBuffer::getNewUninitMemBuffer(
+          size - (end - begin) + text.size(), document->get_name());
+  char* out = edited->getBufferStart();
+  out       = document->copy(0, begin, out);
+  out       = std::copy(text.begin(), text.end(), out);
+  document->copy(end, size, out);
+
+  // Everything but the edited function is copied from this module. There
+  // is nothing on disk for the edited text, so it is never cached
+  LoadOptions uncached = options;
+  uncached.use_cache   = false;
+  return create(std::move(edited), uncached, this, nullptr);
+}
+
+bool
+Module::has_unread_bodies() const {
+  if(bitcode)
+    for(const Function& f : functions())
+      if(not f.is_body_read())
+        return true;
+  return false;
+}
+
+bool
+Module::read_body(const Function& f) const {
+  if(not reader) {
+    error() << "Module was not read lazily from bitcode\n";
+    return false;
+  }
+  return reader->read(f);
+}
+
+std::unique_ptr<const Module>
+Module::run_passes(llvm::StringRef pipeline,
+                   const LoadOptions& options) const {
+  // The passes are run on the IR that is shown, so if this module was itself
+  // the result of running passes, the new pipeline runs after the old one.
+  // If some bodies are still in the bitcode, the IR can't be parsed, so
+  // everything is read from the bitcode instead
+  if(has_unread_bodies()) {
+    LoadOptions opts = options;
+    opts.passes      = pipeline.str();
+    return create(bitcode, opts, this);
+  }
+
+  std::unique_ptr<llvm::WritableMemoryBuffer> copy
+      = llvm::WritableMemoryBuffer::getNewUninitMemBuffer(
+          document->get_size(), document->get_name());
+  document->copy(0, document->get_size(), copy->getBufferStart());
+
+  LoadOptions opts = options;
+  opts.passes      = pipeline.str();
+  opts.use_cache   = false;
+  return create(std::move(copy), opts, this, nullptr);
+}
+
 } // namespace lb
@@ -1,6 +1,8 @@
 #ifndef LLVM_BROWSE_MODULE_H
 #define LLVM_BROWSE_MODULE_H
 
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/ADT/iterator_range.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
@@ -8,28 +10,40 @@
 
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <vector>
 
+#include "Arena.h"
 #include "Argument.h"
 #include "BasicBlock.h"
+#include "BodyReader.h"
 #include "Comdat.h"
 #include "Definition.h"
+#include "Document.h"
 #include "Errors.h"
 #include "Function.h"
+#include "FunctionLinker.h"
 #include "GlobalAlias.h"
 #include "GlobalVariable.h"
 #include "Instruction.h"
 #include "Iterator.h"
 #include "LLVMRange.h"
+#include "LoadOptions.h"
 #include "MDNode.h"
+#include "MetadataLinker.h"
 #include "Parser.h"
+#include "RangeTable.h"
+#include "SourceLocation.h"
+#include "SourceRange.h"
 #include "StructType.h"
 #include "Typedefs.h"
 #include "Use.h"
 
 namespace lb {
 
+class LinkCache;
+
 // Wrapper class around an LLVM module. The wrappers around the LLVM classes
 // contains "LLVM source code" information, mainly just line and column
 // numbers. Keeping it in here instead of separately so that if we need
@@ -38,35 +52,82 @@ namespace lb {
 //
 class alignas(ALIGN_OBJ) Module {
 protected:
+  // If the module was read lazily, this is the bitcode from which the bodies
+  // of the functions are read when they are materialized. It must outlive
+  // the LLVM module and is shared with the modules created by run_passes()
+  std::shared_ptr<llvm::MemoryBuffer> bitcode;
+
   // Managed memory for objects that will always live for the duration of
   // the object but will never be touched directly
   std::unique_ptr<llvm::LLVMContext> context;
   std::unique_ptr<llvm::Module> llvm;
-  std::unique_ptr<llvm::MemoryBuffer> buffer;
+  mutable std::unique_ptr<llvm::MemoryBuffer> buffer;
+
+  // The text of the module. If the document is virtual, the buffer is
+  // dropped once the module has been linked and the text is only assembled
+  // again if all of it is asked for at once. It is dropped again whenever
+  // the body of a function is read
+  std::unique_ptr<Document> document;
+  mutable std::mutex assembling;
+
+  // All the wrappers and their tags are allocated from these. The tags of
+  // the locals named by the threads that link functions in parallel come
+  // from arenas of their own that are kept until the module is freed. These
+  // must be declared before anything that refers to the objects in them so
+  // they are destroyed last
+  Arena arena;
+  std::vector<std::unique_ptr<Arena>> arenas;
 
   // These are all the objects that the module owns. Not all are directly
-  // exposed from here Everything in these arrays
-  // needs to be freed in the destructor. At some point, I'll create an
-  // iterator that exposes a reference to these instead of the pointer
-  std::vector<std::unique_ptr<GlobalAlias>> m_aliases;
-  std::vector<std::unique_ptr<Comdat>> m_comdats;
+  // exposed from here. The objects themselves live in the arenas and are
+  // only destroyed with them
+  std::vector<GlobalAlias*> m_aliases;
+  std::vector<Comdat*> m_comdats;
   // We make a distinction between functions and declarations mainly to search
   // Functions with definitions have a span and need to be ordered
   // Declarations have no body and the best we can do is find uses of it
-  std::vector<std::unique_ptr<Function>> m_decls;
-  std::vector<std::unique_ptr<Function>> m_functions;
-  std::vector<std::unique_ptr<GlobalVariable>> m_globals;
-  std::vector<std::unique_ptr<MDNode>> m_metadata;
-  std::vector<std::unique_ptr<StructType>> m_structs;
-
-  // The uses are guaranteed not to overlap and are sorted in the order in
-  // which they appear in the IR
-  std::vector<std::unique_ptr<Use>> uses;
+  std::vector<Function*> m_decls;
+  std::vector<Function*> m_functions;
+  std::vector<GlobalVariable*> m_globals;
+  std::vector<MDNode*> m_metadata;
+  std::vector<StructType*> m_structs;
+
+  // The uses are guaranteed not to overlap. They are in two tables, each
+  // sorted in the order in which they appear in the IR. The first has
+  // everything that was linked when the module was created. The late table
+  // has what was linked lazily since then and is folded into the first once
+  // it grows large enough. The uses that were added but haven't been sorted
+  // yet are in new_uses
+  RangeTable uses;
+  RangeTable late_uses;
+  std::vector<RangeTable::Entry> new_uses;
 
   // These are the definitions of the Navigable entities in the IR.
-  // These are guaranteed not to overlap and are sorted in the order in
-  // which they appear in the IR
-  std::vector<std::unique_ptr<Definition>> defs;
+  // These are guaranteed not to overlap and are kept like the uses
+  RangeTable defs;
+  RangeTable late_defs;
+  std::vector<RangeTable::Entry> new_defs;
+
+  // The uses and definitions that have been handed out by address. They are
+  // made when they are asked for and these keep them for as long as the
+  // module lives, so the address stays the same every time one is asked for.
+  // The definitions are keyed by the entity that they define. The uses are
+  // allocated on their own so they can be moved when a body is read
+  mutable std::map<Offset, std::unique_ptr<Use>> kept_uses;
+  mutable std::map<const INavigable*, Definition> kept_defs;
+
+  // The operands of most metadata nodes are linked only when they are needed.
+  // The linker adds the uses to the module when that happens
+  std::unique_ptr<MetadataLinker> md_linker;
+
+  // If the module was loaded lazily, the bodies of the functions are linked
+  // only when they are needed. The parser is kept around for that
+  std::unique_ptr<Parser> parser;
+  std::unique_ptr<FunctionLinker> fn_linker;
+
+  // If the module was read lazily from bitcode, this reads the bodies of
+  // the functions into it when they are asked for
+  std::unique_ptr<BodyReader> reader;
 
   // Wrapper lookup maps
   std::map<const llvm::Comdat*, Comdat*> cmap;
@@ -79,9 +140,13 @@ protected:
   // in the use of getFilename() and getDirectory(). In some cases, 
   // getFilename() returns just the filename but in others, it returns the 
   // full path to the file. So we keep strings of all the filenames here 
-  // so we can return llvm::StringRef where needed instead of copying the 
-  // same string for every SourceRange object
-  std::set<std::string> files;
+  // and the source locations refer to them by their id, which is one more
+  // than their index in file_names. The strings in the debug info are
+  // uniqued by LLVM, so the ids are looked up by their addresses first
+  // and the full path is only built the first time a pair is seen
+  llvm::StringMap<unsigned> file_ids;
+  std::vector<llvm::StringRef> file_names;
+  llvm::DenseMap<std::pair<const char*, const char*>, unsigned> file_cache;
 
 public:
   using AliasIterator    = DerefIterator<decltype(m_aliases)::const_iterator>;
@@ -91,10 +156,6 @@ public:
   using GlobalIterator   = DerefIterator<decltype(m_globals)::const_iterator>;
   using MetadataIterator = DerefIterator<decltype(m_metadata)::const_iterator>;
   using StructIterator   = DerefIterator<decltype(m_structs)::const_iterator>;
-  using UseIterator      = DerefIterator<decltype(uses)::iterator>;
-  using UseConstIterator = DerefIterator<decltype(uses)::const_iterator>;
-  using DefIterator      = DerefIterator<decltype(defs)::iterator>;
-  using DefConstIterator = DerefIterator<decltype(defs)::const_iterator>;
 
 protected:
   Module(std::unique_ptr<llvm::Module> module,
@@ -121,8 +182,56 @@ protected:
     return llvm::cast<T>(vmap.at(llvm));
   }
 
+  // The use is attached to the entity right away but it can only be found
+  // by its offset once the module has been sorted again. The definition is
+  // set on the entity in the same way
+  void add_use(INavigable& used, Offset begin, Offset end);
+  void add_definition(INavigable& defined, Offset begin, Offset end);
+
   void sort();
 
+  // Sort the uses and definitions that were added after the module was
+  // sorted into the late tables
+  void sort_late();
+
+  // Sort the functions by where their bodies are in the IR
+  void sort_functions();
+
+  // The text in [begin, end) was replaced with size bytes of other text.
+  // Everything after the range is moved with it and whatever was defined in
+  // it is dropped. Nothing may be used in the range
+  void move(Offset begin, Offset end, Offset size);
+
+  // The uses and definitions that begin in [begin, end] in the order in
+  // which they appear in the IR
+  std::vector<Use> get_uses_in(Offset begin, Offset end) const;
+  std::vector<Definition> get_definitions_in(Offset begin, Offset end) const;
+
+  static std::unique_ptr<const Module>
+  create(std::unique_ptr<llvm::MemoryBuffer> fbuf,
+         const LoadOptions& options,
+         const Module* previous,
+         LinkCache* cache);
+
+  // Read the module lazily from the bitcode. The bodies of the functions
+  // are read one at a time with read_body()
+  static std::unique_ptr<const Module>
+  create(std::shared_ptr<llvm::MemoryBuffer> bitcode,
+         const LoadOptions& options,
+         const Module* previous);
+
+  // Wrap and link the LLVM module that the parser has read
+  static std::unique_ptr<Module>
+  construct(std::unique_ptr<Parser> parser,
+            std::unique_ptr<llvm::Module> llvm,
+            std::unique_ptr<llvm::LLVMContext> context,
+            std::unique_ptr<llvm::MemoryBuffer> mbuf,
+            const LoadOptions& options,
+            const Module* previous,
+            LinkCache* cache);
+
+  bool has_unread_bodies() const;
+
   bool check_range(Offset begin, Offset end, llvm::StringRef tag) const;
   bool check_uses(const INavigable& navigable) const;
   bool check_navigable(const INavigable& navigable) const;
@@ -144,12 +253,29 @@ public:
   Module(const Module&&) = delete;
   virtual ~Module()      = default;
 
-  llvm::StringRef get_full_path(llvm::StringRef dir, llvm::StringRef file);
+  // The id of the file in the file table. The directory and file name must
+  // be the strings from the debug info of this module
+  unsigned get_file_id(llvm::StringRef dir, llvm::StringRef file);
+
+  // The file with the given id or an empty string if there is none
+  llvm::StringRef get_file(unsigned id) const;
+
+  // The location as a SourceRange. The file in the range is owned by the
+  // module
+  SourceRange get_source_range(const SourceLocation& loc) const;
   bool contains(const llvm::Value& llvm) const;
   bool contains(const llvm::MDNode& llvm) const;
 
+  const Document& get_document() const;
+
+  // All of the text of the module. If the document is virtual, the text is
+  // assembled the first time this is called and is kept for as long as the
+  // module is, so get_text() should be used for anything that doesn't need
+  // all of it
   llvm::MemoryBufferRef get_code_buffer() const;
   llvm::StringRef get_code() const;
+  std::string get_text(Offset begin, Offset end) const;
+  Offset get_code_size() const;
 
   const Argument& get(const llvm::Argument& llvm) const;
   const BasicBlock& get(const llvm::BasicBlock& llvm) const;
@@ -177,6 +303,7 @@ public:
   unsigned get_num_metadata() const;
   unsigned get_num_structs() const;
 
+  // The use and definition returned by these live as long as the module
   const Use* get_use_at(Offset offset) const;
   const Definition* get_definition_at(Offset offset) const;
   const Instruction* get_instruction_at(Offset offset) const;
@@ -187,6 +314,53 @@ public:
   llvm::Module& get_llvm();
   const llvm::Module& get_llvm() const;
 
+  // This is used by the wrappers to keep their tags while they are being
+  // constructed
+  Arena& get_arena();
+
+  // A copy of the use or definition that lives as long as the module. The
+  // same copy is returned every time, so its address can be handed out
+  const Use& keep(const Use& use) const;
+  const Definition& keep(const Definition& def) const;
+
+  // Make sure that all the uses of the metadata node have been linked
+  void link_metadata_uses(const MDNode& md) const;
+
+  // Make sure that the body of the function has been linked
+  void link_function(const Function& f) const;
+
+  // Make sure that all the uses of the value in the bodies of functions
+  // have been linked
+  void link_uses(const llvm::Value& llvm) const;
+
+  // Replace the text in [begin, end) with the given text and return the
+  // module that results. The range must be inside the body of a function.
+  // Only that function is relinked. Everything else is copied from this
+  // module, which is not changed. Returns nullptr if the edited IR could not
+  // be parsed
+  std::unique_ptr<const Module> edit(Offset begin,
+                                     Offset end,
+                                     llvm::StringRef text,
+                                     const LoadOptions& options
+                                     = LoadOptions()) const;
+
+  // Run the pass pipeline on a copy of this module and return the module
+  // that results. The pipeline is written as it would be for opt -passes.
+  // Functions whose text is not changed by the passes are not relinked, so
+  // this works best when the module is shown as printed by LLVM. Returns
+  // nullptr if the pipeline or the IR could not be parsed
+  std::unique_ptr<const Module> run_passes(llvm::StringRef pipeline,
+                                           const LoadOptions& options
+                                           = LoadOptions()) const;
+
+  // Read the body of the function from the bitcode into this module. Only
+  // that function is printed and linked and its text is spliced into the
+  // document in place of the empty body. The offsets of everything after it
+  // change, but the entities, uses and definitions that have been handed
+  // out stay valid. Returns false if the module was not read lazily or the
+  // body could not be read
+  bool read_body(const Function& f) const;
+
   bool check_top_level() const;
   bool check_all(bool metadata) const;
 
@@ -195,10 +369,21 @@ public:
   }
 
 public:
-  static std::unique_ptr<const Module> create(const std::string& file);
+  // If the previous version of the module is given, the links of the
+  // functions whose text hasn't changed are copied from it instead of being
+  // searched for. It is only read while the module is being created
+  static std::unique_ptr<const Module>
+  create(const std::string& file,
+         const LoadOptions& options = LoadOptions(),
+         const Module* previous     = nullptr);
 
 public:
+  friend class BodyReader;
+  friend class FunctionLinker;
+  friend class LinkCache;
+  friend class MetadataLinker;
   friend class Parser;
+  friend class PassDump;
   friend Argument&
   Argument::make(const llvm::Argument& llvm_a, Function& f, Module& module);
   friend BasicBlock& BasicBlock::make(const llvm::BasicBlock& llvm_bb,
@@ -220,16 +405,6 @@ public:
   MDNode::make(const llvm::MDNode& llvm_md, unsigned slot, Module& module);
   friend StructType& StructType::make(llvm::StructType* llvm_sty,
                                       Module& module);
-
-  friend Use& Use::make(Offset begin,
-                        Offset end,
-                        const INavigable& value,
-                        Module& module,
-                        const Instruction* inst);
-  friend Definition& Definition::make(Offset begin,
-                                      Offset end,
-                                      const INavigable& defined,
-                                      Module& module);
 };
 
 } // namespace lb
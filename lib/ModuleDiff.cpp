@@ -0,0 +1,666 @@
+#include "ModuleDiff.h"
+#include "BasicBlock.h"
+#include "Function.h"
+#include "Instruction.h"
+#include "Logging.h"
+#include "Module.h"
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/Hashing.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Attributes.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/InlineAsm.h>
+#include <llvm/IR/Instructions.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
+namespace lb {
+
+// Hashes the structure of functions. Nothing that depends on the context in
+// which the function was parsed - the addresses of types and constants - and
+// none of the names of the local values go into the hash, so it can be
+// compared across modules. Global values are hashed by name because that is
+// the only thing that identifies them in both modules.
+//
+// In exact mode, local operands are hashed by their position in the
+// function. Otherwise, they are hashed by what they are, which means that
+// an instruction that is inserted or removed doesn't change the hash of
+// every instruction that comes after it. The former is used to decide if a
+// function has changed, the latter to align the bodies of functions that
+// have
+//
+class StructuralHasher {
+protected:
+  llvm::DenseMap<const llvm::Type*, llvm::hash_code> types;
+  llvm::DenseMap<const llvm::Value*, unsigned> locals;
+  const llvm::Function* current = nullptr;
+
+protected:
+  llvm::hash_code hash(const llvm::Type* type);
+  llvm::hash_code hash(const llvm::Constant* c);
+  llvm::hash_code hash(const llvm::Value* v, bool exact);
+  llvm::hash_code hash(const llvm::AttributeList& attrs, unsigned args);
+
+public:
+  void set_function(const llvm::Function& f);
+  llvm::hash_code hash(const llvm::Instruction& inst, bool exact);
+  llvm::hash_code hash(const llvm::BasicBlock& bb);
+  llvm::hash_code hash(const llvm::Function& f);
+};
+
+llvm::hash_code
+StructuralHasher::hash(const llvm::Type* type) {
+  auto it = types.find(type);
+  if(it != types.end())
+    return it->second;
+
+  // Named structs are the only types that can be recursive, so stopping at
+  // the name is also what keeps this from looping forever
+  llvm::hash_code h = llvm::hash_value(type->getTypeID());
+  if(const auto* sty = llvm::dyn_cast<llvm::StructType>(type))
+    if(sty->hasName())
+      return types[type] = llvm::hash_combine(h, sty->getName());
+  if(const auto* ity = llvm::dyn_cast<llvm::IntegerType>(type))
+    h = llvm::hash_combine(h, ity->getBitWidth());
+  else if(const auto* aty = llvm::dyn_cast<llvm::ArrayType>(type))
+    h = llvm::hash_combine(h, aty->getNumElements());
+  else if(const auto* vty = llvm::dyn_cast<llvm::VectorType>(type))
+    h = llvm::hash_combine(h, vty->getElementCount().getKnownMinValue());
+  else if(const auto* pty = llvm::dyn_cast<llvm::PointerType>(type))
+    h = llvm::hash_combine(h, pty->getAddressSpace());
+  for(const llvm::Type* sub : type->subtypes())
+    h = llvm::hash_combine(h, hash(sub));
+
+  return types[type] = h;
+}
+
+llvm::hash_code
+StructuralHasher::hash(const llvm::Constant* c) {
+  llvm::hash_code h = llvm::hash_combine(c->getValueID(), hash(c->getType()));
+  if(const auto* ci = llvm::dyn_cast<llvm::ConstantInt>(c))
+    return llvm::hash_combine(h, ci->getValue());
+  if(const auto* cfp = llvm::dyn_cast<llvm::ConstantFP>(c))
+    return llvm::hash_combine(h, cfp->getValueAPF());
+  if(const auto* cds = llvm::dyn_cast<llvm::ConstantDataSequential>(c))
+    return llvm::hash_combine(h, cds->getRawDataValues());
+  if(const auto* ce = llvm::dyn_cast<llvm::ConstantExpr>(c))
+    h = llvm::hash_combine(h, ce->getOpcode());
+  for(const llvm::Use& op : c->operands())
+    h = llvm::hash_combine(h, hash(op.get(), true));
+  return h;
+}
+
+llvm::hash_code
+StructuralHasher::hash(const llvm::Value* v, bool exact) {
+  if(not v)
+    return llvm::hash_value(0);
+
+  if(llvm::isa<llvm::Instruction>(v) or llvm::isa<llvm::Argument>(v)
+     or llvm::isa<llvm::BasicBlock>(v)) {
+    if(exact)
+      return llvm::hash_combine(v->getValueID(), locals.lookup(v));
+    if(const auto* inst = llvm::dyn_cast<llvm::Instruction>(v))
+      return llvm::hash_combine(
+          v->getValueID(), inst->getOpcode(), hash(v->getType()));
+    return llvm::hash_combine(v->getValueID(), hash(v->getType()));
+  }
+
+  // A renamed function that calls itself should still match
+  if(v == current)
+    return llvm::hash_value(v->getValueID());
+  if(const auto* g = llvm::dyn_cast<llvm::GlobalValue>(v))
+    return llvm::hash_combine(v->getValueID(), g->getName());
+  if(const auto* c = llvm::dyn_cast<llvm::Constant>(v))
+    return hash(c);
+  if(const auto* as = llvm::dyn_cast<llvm::InlineAsm>(v))
+    return llvm::hash_combine(
+        v->getValueID(), as->getAsmString(), as->getConstraintString());
+  return llvm::hash_value(v->getValueID());
+}
+
+// The attributes are interned in the context, so they are hashed by how they
+// are printed
+llvm::hash_code
+StructuralHasher::hash(const llvm::AttributeList& attrs, unsigned args) {
+  llvm::hash_code h = llvm::hash_combine(
+      attrs.getAsString(llvm::AttributeList::FunctionIndex),
+      attrs.getAsString(llvm::AttributeList::ReturnIndex));
+  for(unsigned i = 0; i < args; i++)
+    h = llvm::hash_combine(
+        h, attrs.getAsString(llvm::AttributeList::FirstArgIndex + i));
+  return h;
+}
+
+void
+StructuralHasher::set_function(const llvm::Function& f) {
+  current = &f;
+  locals.clear();
+  unsigned slot = 0;
+  for(const llvm::Argument& arg : f.args())
+    locals[&arg] = slot++;
+  for(const llvm::BasicBlock& bb : f) {
+    locals[&bb] = slot++;
+    for(const llvm::Instruction& inst : bb)
+      locals[&inst] = slot++;
+  }
+}
+
+llvm::hash_code
+StructuralHasher::hash(const llvm::Instruction& inst, bool exact) {
+  // The optional data holds the nsw, nuw and exact flags and the fast-math
+  // flags, none of which change the type or the operands
+  llvm::hash_code h = llvm::hash_combine(inst.getOpcode(),
+                                         hash(inst.getType()),
+                                         inst.getNumOperands(),
+                                         inst.getRawSubclassOptionalData());
+  if(const auto* cmp = llvm::dyn_cast<llvm::CmpInst>(&inst))
+    h = llvm::hash_combine(h, cmp->getPredicate());
+  else if(const auto* alloca = llvm::dyn_cast<llvm::AllocaInst>(&inst))
+    h = llvm::hash_combine(h, hash(alloca->getAllocatedType()));
+  else if(const auto* gep = llvm::dyn_cast<llvm::GetElementPtrInst>(&inst))
+    h = llvm::hash_combine(
+        h, hash(gep->getSourceElementType()), gep->isInBounds());
+  else if(const auto* ev = llvm::dyn_cast<llvm::ExtractValueInst>(&inst))
+    h = llvm::hash_combine(h, llvm::hash_combine_range(ev->idx_begin(),
+                                                       ev->idx_end()));
+  else if(const auto* iv = llvm::dyn_cast<llvm::InsertValueInst>(&inst))
+    h = llvm::hash_combine(h, llvm::hash_combine_range(iv->idx_begin(),
+                                                       iv->idx_end()));
+#if LLVM_VERSION_MAJOR >= 11
+  // The mask used to be an operand
+  else if(const auto* shuf = llvm::dyn_cast<llvm::ShuffleVectorInst>(&inst))
+    h = llvm::hash_combine(
+        h,
+        llvm::hash_combine_range(shuf->getShuffleMask().begin(),
+                                 shuf->getShuffleMask().end()));
+  else if(const auto* load = llvm::dyn_cast<llvm::LoadInst>(&inst))
+    h = llvm::hash_combine(h,
+                           load->isVolatile(),
+                           load->getAlign().value(),
+                           load->getOrdering());
+  else if(const auto* store = llvm::dyn_cast<llvm::StoreInst>(&inst))
+    h = llvm::hash_combine(h,
+                           store->isVolatile(),
+                           store->getAlign().value(),
+                           store->getOrdering());
+#else
+  else if(const auto* load = llvm::dyn_cast<llvm::LoadInst>(&inst))
+    h = llvm::hash_combine(h,
+                           load->isVolatile(),
+                           load->getAlignment(),
+                           load->getOrdering());
+  else if(const auto* store = llvm::dyn_cast<llvm::StoreInst>(&inst))
+    h = llvm::hash_combine(h,
+                           store->isVolatile(),
+                           store->getAlignment(),
+                           store->getOrdering());
+#endif // LLVM_VERSION_MAJOR >= 11
+  else if(const auto* call = llvm::dyn_cast<llvm::CallBase>(&inst))
+    h = llvm::hash_combine(h,
+                           hash(call->getFunctionType()),
+                           call->getCallingConv(),
+                           hash(call->getAttributes(), call->arg_size()));
+  if(const auto* ci = llvm::dyn_cast<llvm::CallInst>(&inst))
+    h = llvm::hash_combine(h, ci->getTailCallKind());
+  for(const llvm::Use& op : inst.operands())
+    h = llvm::hash_combine(h, hash(op.get(), exact));
+
+  // The incoming blocks of a phi are not operands
+  if(const auto* phi = llvm::dyn_cast<llvm::PHINode>(&inst))
+    for(const llvm::BasicBlock* bb : phi->blocks())
+      h = llvm::hash_combine(h, hash(bb, exact));
+
+  return h;
+}
+
+llvm::hash_code
+StructuralHasher::hash(const llvm::BasicBlock& bb) {
+  llvm::hash_code h = llvm::hash_value(bb.size());
+  for(const llvm::Instruction& inst : bb)
+    h = llvm::hash_combine(h, hash(inst, false));
+  return h;
+}
+
+llvm::hash_code
+StructuralHasher::hash(const llvm::Function& f) {
+  set_function(f);
+  llvm::hash_code h
+      = llvm::hash_combine(hash(f.getFunctionType()),
+                           f.size(),
+                           f.getLinkage(),
+                           f.getCallingConv(),
+                           hash(f.getAttributes(), f.arg_size()));
+  for(const llvm::BasicBlock& bb : f)
+    for(const llvm::Instruction& inst : bb)
+      h = llvm::hash_combine(h, hash(inst, true));
+  return h;
+}
+
+using Matches = std::vector<std::pair<size_t, size_t>>;
+
+// Align two sequences of hashes the way a patience diff does. The elements
+// that occur exactly once in both sequences are anchors and the longest
+// chain of anchors that are in the same order in both is matched. The same
+// is then done for the gaps between the anchors. Unlike a diff that finds
+// the longest common subsequence, this doesn't blow up on large functions
+// with many changes, which is also when it matters the most
+static void
+align(llvm::ArrayRef<uint64_t> a,
+      llvm::ArrayRef<uint64_t> b,
+      size_t offset_a,
+      size_t offset_b,
+      Matches& matches) {
+  size_t prefix = 0;
+  while(prefix < a.size() and prefix < b.size() and a[prefix] == b[prefix]) {
+    matches.emplace_back(offset_a + prefix, offset_b + prefix);
+    prefix++;
+  }
+  a = a.drop_front(prefix);
+  b = b.drop_front(prefix);
+  offset_a += prefix;
+  offset_b += prefix;
+
+  size_t suffix = 0;
+  while(suffix < a.size() and suffix < b.size()
+        and a[a.size() - suffix - 1] == b[b.size() - suffix - 1])
+    suffix++;
+  a = a.drop_back(suffix);
+  b = b.drop_back(suffix);
+
+  if(a.size() and b.size()) {
+    struct Occurrences {
+      unsigned in_a = 0;
+      unsigned in_b = 0;
+      size_t pos_a  = 0;
+      size_t pos_b  = 0;
+    };
+    std::unordered_map<uint64_t, Occurrences> occurrences;
+    for(size_t i = 0; i < a.size(); i++) {
+      Occurrences& occ = occurrences[a[i]];
+      occ.in_a++;
+      occ.pos_a = i;
+    }
+    for(size_t j = 0; j < b.size(); j++) {
+      auto it = occurrences.find(b[j]);
+      if(it != occurrences.end()) {
+        it->second.in_b++;
+        it->second.pos_b = j;
+      }
+    }
+
+    // The anchors are in the order in which they appear in a, so the chain
+    // is the longest increasing subsequence of their positions in b
+    std::vector<std::pair<size_t, size_t>> anchors;
+    for(size_t i = 0; i < a.size(); i++) {
+      const Occurrences& occ = occurrences[a[i]];
+      if(occ.in_a == 1 and occ.in_b == 1)
+        anchors.emplace_back(i, occ.pos_b);
+    }
+    std::vector<size_t> tails;
+    std::vector<size_t> prev(anchors.size(), anchors.size());
+    for(size_t k = 0; k < anchors.size(); k++) {
+      auto it = std::lower_bound(tails.begin(),
+                                 tails.end(),
+                                 anchors[k].second,
+                                 [&](size_t t, size_t j) {
+                                   return anchors[t].second < j;
+                                 });
+      if(it != tails.begin())
+        prev[k] = *std::prev(it);
+      if(it == tails.end())
+        tails.push_back(k);
+      else
+        *it = k;
+    }
+    std::vector<std::pair<size_t, size_t>> chain;
+    for(size_t k = tails.size() ? tails.back() : anchors.size();
+        k < anchors.size();
+        k = prev[k])
+      chain.push_back(anchors[k]);
+    std::reverse(chain.begin(), chain.end());
+
+    size_t i = 0, j = 0;
+    for(const auto& anchor : chain) {
+      align(a.slice(i, anchor.first - i),
+            b.slice(j, anchor.second - j),
+            offset_a + i,
+            offset_b + j,
+            matches);
+      matches.emplace_back(offset_a + anchor.first, offset_b + anchor.second);
+      i = anchor.first + 1;
+      j = anchor.second + 1;
+    }
+    if(chain.size())
+      align(a.drop_front(i),
+            b.drop_front(j),
+            offset_a + i,
+            offset_b + j,
+            matches);
+  }
+
+  for(size_t k = suffix; k > 0; k--)
+    matches.emplace_back(offset_a + a.size() + suffix - k,
+                         offset_b + b.size() + suffix - k);
+}
+
+// Turn the matches into pairs. Whatever is left unmatched between two
+// matches was either removed from the left or added to the right. If there
+// are as many of one as the other, they are assumed to have been changed
+template<typename T>
+static void
+make_pairs(const std::vector<const T*>& left,
+           const std::vector<const T*>& right,
+           const Matches& matches,
+           std::vector<DiffPair<T>>& pairs) {
+  size_t i = 0, j = 0;
+  auto gap = [&](size_t end_i, size_t end_j) {
+    if(end_i - i == end_j - j)
+      while(i < end_i)
+        pairs.push_back({left[i++], right[j++], DiffKind::Changed});
+    while(i < end_i)
+      pairs.push_back({left[i++], nullptr, DiffKind::Removed});
+    while(j < end_j)
+      pairs.push_back({nullptr, right[j++], DiffKind::Added});
+  };
+  for(const auto& match : matches) {
+    gap(match.first, match.second);
+    pairs.push_back({left[i++], right[j++], DiffKind::Same});
+  }
+  gap(left.size(), right.size());
+}
+
+FunctionDiff::FunctionDiff(const Function* left,
+                           const Function* right,
+                           DiffKind kind,
+                           bool renamed) :
+    left(left),
+    right(right), kind(kind), renamed(renamed), aligned(false) {
+  ;
+}
+
+void
+FunctionDiff::align() const {
+  if(aligned)
+    return;
+  aligned = true;
+
+  std::vector<const BasicBlock*> bbs[2];
+  std::vector<const Instruction*> insts[2];
+  std::vector<uint64_t> bb_hashes[2];
+  std::vector<uint64_t> inst_hashes[2];
+  StructuralHasher hasher;
+  const Function* fs[2] = {left, right};
+  for(unsigned side = 0; side < 2; side++) {
+    if(not fs[side])
+      continue;
+    fs[side]->get_module().link_function(*fs[side]);
+    hasher.set_function(fs[side]->get_llvm());
+    for(const BasicBlock& bb : fs[side]->blocks()) {
+      bbs[side].push_back(&bb);
+      bb_hashes[side].push_back(hasher.hash(bb.get_llvm()));
+      for(const Instruction& inst : bb.instructions()) {
+        insts[side].push_back(&inst);
+        inst_hashes[side].push_back(hasher.hash(inst.get_llvm(), false));
+      }
+    }
+  }
+
+  Matches bb_matches, inst_matches;
+  if(kind == DiffKind::Same and bbs[0].size() == bbs[1].size()
+     and insts[0].size() == insts[1].size()) {
+    for(size_t i = 0; i < bbs[0].size(); i++)
+      bb_matches.emplace_back(i, i);
+    for(size_t i = 0; i < insts[0].size(); i++)
+      inst_matches.emplace_back(i, i);
+  } else {
+    lb::align(bb_hashes[0], bb_hashes[1], 0, 0, bb_matches);
+    lb::align(inst_hashes[0], inst_hashes[1], 0, 0, inst_matches);
+  }
+  make_pairs(bbs[0], bbs[1], bb_matches, m_blocks);
+  make_pairs(insts[0], insts[1], inst_matches, m_insts);
+}
+
+const Function*
+FunctionDiff::get_left() const {
+  return left;
+}
+
+const Function*
+FunctionDiff::get_right() const {
+  return right;
+}
+
+DiffKind
+FunctionDiff::get_kind() const {
+  return kind;
+}
+
+bool
+FunctionDiff::is_renamed() const {
+  return renamed;
+}
+
+llvm::iterator_range<FunctionDiff::BlockIterator>
+FunctionDiff::blocks() const {
+  align();
+  return llvm::make_range(m_blocks.cbegin(), m_blocks.cend());
+}
+
+llvm::iterator_range<FunctionDiff::InstIterator>
+FunctionDiff::instructions() const {
+  align();
+  return llvm::make_range(m_insts.cbegin(), m_insts.cend());
+}
+
+template<typename T>
+static const T*
+find_counterpart(const std::vector<DiffPair<T>>& pairs, const T& entity) {
+  for(const DiffPair<T>& pair : pairs)
+    if(pair.left == &entity)
+      return pair.right;
+    else if(pair.right == &entity)
+      return pair.left;
+  return nullptr;
+}
+
+const BasicBlock*
+FunctionDiff::get_counterpart(const BasicBlock& bb) const {
+  align();
+  return find_counterpart(m_blocks, bb);
+}
+
+const Instruction*
+FunctionDiff::get_counterpart(const Instruction& inst) const {
+  align();
+  return find_counterpart(m_insts, inst);
+}
+
+ModuleDiff::ModuleDiff(const Module& left,
+                       const Module& right,
+                       unsigned num_threads) :
+    left(left),
+    right(right), num_changed(0), num_added(0), num_removed(0) {
+  message() << "Comparing modules\n";
+
+  // The functions in both modules are hashed up front. This only reads the
+  // LLVM modules, so the functions can be hashed in parallel
+  std::vector<const Function*> work;
+  for(const Function& f : left.functions())
+    work.push_back(&f);
+  for(const Function& f : right.functions())
+    work.push_back(&f);
+
+  std::vector<uint64_t> hashes(work.size());
+  // Hashing is bound by the CPU, like linking, so no more threads are
+  // started than there are cores
+  unsigned cores   = std::thread::hardware_concurrency();
+  unsigned threads = num_threads;
+  if(not threads or (cores and (threads > cores)))
+    threads = cores;
+  threads = std::min<size_t>(std::max(threads, 1U), work.size());
+  std::atomic<size_t> next(0);
+  auto hash_functions = [&work, &hashes, &next]() {
+    StructuralHasher hasher;
+    for(size_t j = next++; j < work.size(); j = next++)
+      hashes[j] = hasher.hash(work[j]->get_llvm());
+  };
+  if(threads <= 1) {
+    hash_functions();
+  } else {
+    std::vector<std::thread> pool;
+    for(unsigned i = 0; i < threads; i++)
+      pool.emplace_back(hash_functions);
+    for(std::thread& t : pool)
+      t.join();
+  }
+
+  size_t num_left = left.get_num_functions();
+  llvm::StringMap<size_t> names;
+  for(size_t j = num_left; j < work.size(); j++)
+    names[work[j]->get_llvm_name()] = j;
+
+  // Match by name first
+  std::vector<bool> matched(work.size(), false);
+  std::vector<size_t> partner(num_left, work.size());
+  for(size_t i = 0; i < num_left; i++) {
+    auto it = names.find(work[i]->get_llvm_name());
+    if(it != names.end()) {
+      partner[i]          = it->second;
+      matched[i]          = true;
+      matched[partner[i]] = true;
+    }
+  }
+
+  // Whatever is left over is matched by structure. If several functions
+  // have the same structure, they are paired in the order in which they
+  // appear in the modules
+  std::unordered_multimap<uint64_t, size_t> unmatched;
+  for(size_t j = num_left; j < work.size(); j++)
+    if(not matched[j])
+      unmatched.emplace(hashes[j], j);
+  std::vector<bool> renamed(num_left, false);
+  if(unmatched.size()) {
+    for(size_t i = 0; i < num_left; i++) {
+      if(matched[i])
+        continue;
+      auto range = unmatched.equal_range(hashes[i]);
+      auto best  = range.first;
+      for(auto it = range.first; it != range.second; it++)
+        if(it->second < best->second)
+          best = it;
+      if(best != range.second) {
+        partner[i]            = best->second;
+        renamed[i]            = true;
+        matched[i]            = true;
+        matched[best->second] = true;
+        unmatched.erase(best);
+      }
+    }
+  }
+
+  for(size_t i = 0; i < num_left; i++) {
+    if(partner[i] < work.size()) {
+      DiffKind kind = hashes[i] == hashes[partner[i]] ? DiffKind::Same
+                                                      : DiffKind::Changed;
+      if(kind == DiffKind::Changed)
+        num_changed++;
+      m_functions.emplace_back(
+          new FunctionDiff(work[i], work[partner[i]], kind, renamed[i]));
+    } else {
+      num_removed++;
+      m_functions.emplace_back(
+          new FunctionDiff(work[i], nullptr, DiffKind::Removed, false));
+    }
+  }
+  for(size_t j = num_left; j < work.size(); j++) {
+    if(not matched[j]) {
+      num_added++;
+      m_functions.emplace_back(
+          new FunctionDiff(nullptr, work[j], DiffKind::Added, false));
+    }
+  }
+
+  for(const std::unique_ptr<FunctionDiff>& diff : m_functions) {
+    if(const Function* f = diff->get_left())
+      fmap[f] = diff.get();
+    if(const Function* f = diff->get_right())
+      fmap[f] = diff.get();
+  }
+
+  message() << "Changed: " << num_changed << ", added: " << num_added
+            << ", removed: " << num_removed << "\n";
+}
+
+const Module&
+ModuleDiff::get_left() const {
+  return left;
+}
+
+const Module&
+ModuleDiff::get_right() const {
+  return right;
+}
+
+llvm::iterator_range<ModuleDiff::FunctionIterator>
+ModuleDiff::functions() const {
+  return llvm::iterator_range<FunctionIterator>(
+      FunctionIterator(m_functions.begin()),
+      FunctionIterator(m_functions.end()));
+}
+
+unsigned
+ModuleDiff::get_num_changed() const {
+  return num_changed;
+}
+
+unsigned
+ModuleDiff::get_num_added() const {
+  return num_added;
+}
+
+unsigned
+ModuleDiff::get_num_removed() const {
+  return num_removed;
+}
+
+const FunctionDiff*
+ModuleDiff::get_diff(const Function& f) const {
+  return fmap.lookup(&f);
+}
+
+const INavigable*
+ModuleDiff::get_counterpart(const INavigable& n) const {
+  if(const auto* f = llvm::dyn_cast<Function>(&n)) {
+    if(const FunctionDiff* diff = get_diff(*f))
+      return diff->get_left() == f ? diff->get_right() : diff->get_left();
+  } else if(const auto* bb = llvm::dyn_cast<BasicBlock>(&n)) {
+    if(const FunctionDiff* diff = get_diff(bb->get_function()))
+      return diff->get_counterpart(*bb);
+  } else if(const auto* inst = llvm::dyn_cast<Instruction>(&n)) {
+    if(const FunctionDiff* diff = get_diff(inst->get_function()))
+      return diff->get_counterpart(*inst);
+  }
+  return nullptr;
+}
+
+const char*
+ModuleDiff::get_kind_name(DiffKind kind) {
+  switch(kind) {
+  case DiffKind::Same:
+    return "Same";
+  case DiffKind::Changed:
+    return "Changed";
+  case DiffKind::Added:
+    return "Added";
+  case DiffKind::Removed:
+    return "Removed";
+  }
+  return "<<UNKNOWN>>";
+}
+
+} // namespace lb
@@ -0,0 +1,149 @@
+#ifndef LLVM_BROWSE_MODULE_DIFF_H
+#define LLVM_BROWSE_MODULE_DIFF_H
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/iterator_range.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Iterator.h"
+#include "Typedefs.h"
+
+namespace lb {
+
+class BasicBlock;
+class Function;
+class INavigable;
+class Instruction;
+class Module;
+
+enum class DiffKind {
+  Same,
+  Changed,
+  Added,
+  Removed,
+};
+
+// An entity in the left module and the entity in the right module that
+// corresponds to it. Only one of them is set if the entity was added or
+// removed
+template<typename T>
+struct DiffPair {
+  const T* left;
+  const T* right;
+  DiffKind kind;
+};
+
+// The difference between a function in the left module and the one that it
+// was matched to in the right module. The blocks and instructions are
+// aligned only when they are first asked for because that needs the bodies
+// of both functions to have been linked, which, if the modules were loaded
+// lazily, is not something that should be done for every function
+//
+class alignas(ALIGN_OBJ) FunctionDiff {
+protected:
+  const Function* left;
+  const Function* right;
+  DiffKind kind;
+  bool renamed;
+
+  mutable bool aligned;
+  mutable std::vector<DiffPair<BasicBlock>> m_blocks;
+  mutable std::vector<DiffPair<Instruction>> m_insts;
+
+protected:
+  void align() const;
+
+public:
+  using BlockIterator = decltype(m_blocks)::const_iterator;
+  using InstIterator  = decltype(m_insts)::const_iterator;
+
+public:
+  FunctionDiff(const Function* left,
+               const Function* right,
+               DiffKind kind,
+               bool renamed);
+  FunctionDiff(const FunctionDiff&) = delete;
+  FunctionDiff(FunctionDiff&&)      = delete;
+  virtual ~FunctionDiff()           = default;
+
+  // Either of these will be nullptr if the function was added or removed
+  const Function* get_left() const;
+  const Function* get_right() const;
+  DiffKind get_kind() const;
+
+  // True if the functions were matched by their structure because there
+  // was no function with the same name in the other module
+  bool is_renamed() const;
+
+  // The blocks and instructions of both functions in the order in which
+  // they appear in the IR. Entities that are in both functions are paired
+  llvm::iterator_range<BlockIterator> blocks() const;
+  llvm::iterator_range<InstIterator> instructions() const;
+
+  // The entity in the other function that corresponds to the given one or
+  // nullptr if there isn't one
+  const BasicBlock* get_counterpart(const BasicBlock& bb) const;
+  const Instruction* get_counterpart(const Instruction& inst) const;
+};
+
+// The difference between two modules. This only compares the functions that
+// are defined in them. Functions are matched by name first and the ones that
+// are left over are matched by a hash of their structure, which does not
+// depend on the names of the function or of any of the values in it. This
+// catches functions that were only renamed.
+//
+// A function is unchanged if it is structurally identical to the one that it
+// was matched to. Nothing here looks at the text of the modules, so the diff
+// doesn't depend on how they were printed or on which instructions happened
+// to be given names
+//
+class alignas(ALIGN_OBJ) ModuleDiff {
+protected:
+  const Module& left;
+  const Module& right;
+  std::vector<std::unique_ptr<FunctionDiff>> m_functions;
+  llvm::DenseMap<const Function*, const FunctionDiff*> fmap;
+
+  unsigned num_changed;
+  unsigned num_added;
+  unsigned num_removed;
+
+public:
+  using FunctionIterator = DerefIterator<decltype(m_functions)::const_iterator>;
+
+public:
+  // Both modules must outlive the diff. If num_threads is 0, all the cores
+  // are used to hash the functions. No more threads than there are cores
+  // are ever used
+  ModuleDiff(const Module& left, const Module& right, unsigned num_threads = 1);
+  ModuleDiff(const ModuleDiff&) = delete;
+  ModuleDiff(ModuleDiff&&)      = delete;
+  virtual ~ModuleDiff()         = default;
+
+  const Module& get_left() const;
+  const Module& get_right() const;
+
+  // The functions in the left module in order followed by the ones that were
+  // only in the right module
+  llvm::iterator_range<FunctionIterator> functions() const;
+  unsigned get_num_changed() const;
+  unsigned get_num_added() const;
+  unsigned get_num_removed() const;
+
+  // The diff for a function in either module
+  const FunctionDiff* get_diff(const Function& f) const;
+
+  // The function, block or instruction in the other module that corresponds
+  // to the given one or nullptr if there isn't one. This is meant to keep
+  // the views of both modules in sync while navigating
+  const INavigable* get_counterpart(const INavigable& n) const;
+
+  static const char* get_kind_name(DiffKind kind);
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_MODULE_DIFF_H
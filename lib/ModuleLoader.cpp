@@ -0,0 +1,92 @@
+#include "ModuleLoader.h"
+#include "Module.h"
+
+namespace lb {
+
+ModuleLoader::ModuleLoader(const std::string& file,
+                           const LoadOptions& options,
+                           std::unique_ptr<const Module> previous) :
+    options(options),
+    done(false),
+    phase(LoadPhase::Parsing),
+    progress_done(0),
+    progress_total(0),
+    previous(std::move(previous)) {
+  // The thread has to be started last because it uses everything else
+  thread = std::thread(&ModuleLoader::run, this, file);
+}
+
+ModuleLoader::~ModuleLoader() {
+  if(thread.joinable())
+    thread.join();
+}
+
+void
+ModuleLoader::report(LoadPhase phase, uint64_t done, uint64_t total) {
+  this->phase.store(phase, std::memory_order_relaxed);
+  progress_done.store(done, std::memory_order_relaxed);
+  progress_total.store(total, std::memory_order_relaxed);
+  if(options.progress)
+    options.progress(phase, done, total);
+}
+
+void
+ModuleLoader::run(const std::string& file) {
+  LoadOptions wrapped = options;
+  wrapped.progress    = [this](LoadPhase phase, uint64_t done, uint64_t total) {
+    report(phase, done, total);
+  };
+
+  module = Module::create(file, wrapped, previous.get());
+  previous.reset();
+
+  done.store(true, std::memory_order_release);
+}
+
+bool
+ModuleLoader::is_done() const {
+  return done.load(std::memory_order_acquire);
+}
+
+LoadPhase
+ModuleLoader::get_phase() const {
+  return phase.load(std::memory_order_relaxed);
+}
+
+uint64_t
+ModuleLoader::get_progress_done() const {
+  return progress_done.load(std::memory_order_relaxed);
+}
+
+uint64_t
+ModuleLoader::get_progress_total() const {
+  return progress_total.load(std::memory_order_relaxed);
+}
+
+std::unique_ptr<const Module>
+ModuleLoader::take() {
+  if(thread.joinable())
+    thread.join();
+  return std::move(module);
+}
+
+const char*
+ModuleLoader::get_phase_name(LoadPhase phase) {
+  switch(phase) {
+  case LoadPhase::Parsing:
+    return "Parsing";
+  case LoadPhase::Indexing:
+    return "Indexing";
+  case LoadPhase::TopLevel:
+    return "Linking top-level entities";
+  case LoadPhase::Functions:
+    return "Linking functions";
+  case LoadPhase::Metadata:
+    return "Linking metadata";
+  case LoadPhase::Done:
+    return "Done";
+  }
+  return "<<UNKNOWN>>";
+}
+
+} // namespace lb
@@ -0,0 +1,75 @@
+#ifndef LLVM_BROWSE_MODULE_LOADER_H
+#define LLVM_BROWSE_MODULE_LOADER_H
+
+#include "LoadOptions.h"
+#include "Typedefs.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace lb {
+
+class Module;
+
+// Loads a module on a separate thread so the caller can get on with other
+// things - like keeping a UI responsive - while a large file is parsed.
+// The progress can be polled at any time or passed to a callback in the
+// load options.
+//
+// The module can only be taken once the loader thread has finished, so
+// nothing is ever read while it is still being written. To get at a large
+// module sooner, load it with lazy functions. Then the thread finishes as
+// soon as the top-level entities have been linked, which is a small
+// fraction of the time taken to link everything.
+//
+class alignas(ALIGN_OBJ) ModuleLoader {
+protected:
+  LoadOptions options;
+  std::unique_ptr<const Module> module;
+  std::atomic<bool> done;
+
+  // The most recent progress reported while loading
+  std::atomic<LoadPhase> phase;
+  std::atomic<uint64_t> progress_done;
+  std::atomic<uint64_t> progress_total;
+
+  // The module that is being reloaded, if any. The loader owns it so that
+  // nothing else can touch it while it is being read
+  std::unique_ptr<const Module> previous;
+
+  std::thread thread;
+
+protected:
+  void run(const std::string& file);
+  void report(LoadPhase phase, uint64_t done, uint64_t total);
+
+public:
+  // If a previous version of the module is given, it is freed once the new
+  // module has been loaded. See Module::create()
+  ModuleLoader(const std::string& file,
+               const LoadOptions& options             = LoadOptions(),
+               std::unique_ptr<const Module> previous = nullptr);
+  ModuleLoader(const ModuleLoader&) = delete;
+  ModuleLoader(ModuleLoader&&)      = delete;
+  virtual ~ModuleLoader();
+
+  // True once the loader thread has finished, whether or not the module
+  // could be loaded
+  bool is_done() const;
+
+  LoadPhase get_phase() const;
+  uint64_t get_progress_done() const;
+  uint64_t get_progress_total() const;
+
+  // Wait for the loader thread to finish and take ownership of the module.
+  // This will be nullptr if the module could not be loaded
+  std::unique_ptr<const Module> take();
+
+  static const char* get_phase_name(LoadPhase phase);
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_MODULE_LOADER_H
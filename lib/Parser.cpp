@@ -1,24 +1,39 @@
 #include "Parser.h"
 #include "Argument.h"
 #include "BasicBlock.h"
+#include "Document.h"
 #include "Function.h"
+#include "FunctionLinker.h"
 #include "GlobalAlias.h"
 #include "GlobalVariable.h"
 #include "INavigable.h"
 #include "Instruction.h"
+#include "LinkCache.h"
 #include "Logging.h"
 #include "MDNode.h"
+#include "MetadataLinker.h"
 #include "Module.h"
+#include "StringMemoryBuffer.h"
 #include "Value.h"
 
 #include <llvm/AsmParser/Parser.h>
 #include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Config/llvm-config.h>
 #include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Metadata.h>
+#include <llvm/Passes/PassBuilder.h>
 #include <llvm/Support/SourceMgr.h>
 #include <llvm/Support/raw_ostream.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <thread>
+
 using llvm::cast;
 using llvm::dyn_cast;
 using llvm::dyn_cast_or_null;
@@ -26,44 +41,223 @@ using llvm::isa;
 
 namespace lb {
 
-template<typename T>
-static void
-sort_by_tag_name(std::vector<T*>& objs) {
-  std::sort(objs.begin(), objs.end(), [](const T* l, const T* r) {
-    return l->get_tag().size() < r->get_tag().size();
-  });
-  std::reverse(objs.begin(), objs.end());
+Parser::LinkState::LinkState(const llvm::Module& llvm, Arena& arena) :
+    slots(new llvm::ModuleSlotTracker(&llvm, false)), arena(arena) {
+  ;
 }
 
-Parser::Parser() : local_slots(nullptr), global_slots(nullptr) {
-  ;
+void
+Parser::LinkState::add_definition(INavigable& defined,
+                                  Offset begin,
+                                  Offset end) {
+  defined.set_llvm_defn(LLVMRange(begin, end));
+  defs.push_back({begin, end, &defined});
+}
+
+Parser::Parser(const LoadOptions& options) :
+    global_slots(nullptr),
+    printed(false),
+    incomplete(false),
+    options(options),
+    previous(nullptr) {
+#if LLVM_VERSION_MAJOR < 13
+  if(options.canonical)
+    warning() << "Canonical mode needs LLVM 13 or later. Ignoring\n";
+  if(options.passes.size())
+    warning() << "Running passes needs LLVM 13 or later. Ignoring\n";
+#endif // LLVM_VERSION_MAJOR < 13
+}
+
+Parser::~Parser() {
+  wait_for_index();
+}
+
+void
+Parser::start_indexing() {
+  wait_for_index();
+  indexer = std::thread([this]() { decls.build(ir); });
+}
+
+void
+Parser::wait_for_index() {
+  if(indexer.joinable())
+    indexer.join();
 }
 
 std::tuple<std::unique_ptr<llvm::Module>, std::unique_ptr<llvm::MemoryBuffer>>
 Parser::parse_ir(std::unique_ptr<llvm::MemoryBuffer> in,
                  llvm::LLVMContext& context) {
   message() << "Parsing IR\n";
+  report(LoadPhase::Parsing, 0, in->getBufferSize());
 
   global_slots.reset(new llvm::SlotMapping());
   std::unique_ptr<llvm::Module> module;
   std::unique_ptr<llvm::MemoryBuffer> out;
   llvm::SMDiagnostic error;
+
+  // Unless the module is going to be printed, the text that is shown is
+  // exactly the text being parsed, so it can be scanned at the same time.
+  // The buffer is moved to out on success, which doesn't move the contents
+  bool printed = false;
+#if LLVM_VERSION_MAJOR >= 13
+  printed = options.canonical or options.passes.size();
+#endif // LLVM_VERSION_MAJOR >= 13
+  if(not printed) {
+    ir = in->getBuffer();
+    start_indexing();
+  }
+
   if((module = llvm::parseAssembly(
           in->getMemBufferRef(), error, context, global_slots.get()))) {
+#if LLVM_VERSION_MAJOR >= 13
+    if(not run_passes(*module))
+      return std::make_tuple(nullptr, nullptr);
+    if(printed)
+      return std::make_tuple(std::move(module),
+                             print(*module, in->getBufferIdentifier()));
+#endif // LLVM_VERSION_MAJOR >= 13
     out = std::move(in);
-    ir  = out->getBuffer();
   } else {
     critical() << "Error parsing IR: " << error.getMessage() << "\n";
+    // The buffer being scanned is about to go away
+    wait_for_index();
+    ir = llvm::StringRef();
   }
 
   return std::make_tuple(std::move(module), std::move(out));
 }
 
+#if LLVM_VERSION_MAJOR >= 13
+static const llvm::MDNode*
+get_any_metadata(const llvm::Module& module) {
+  llvm::SmallVector<std::pair<unsigned, llvm::MDNode*>, 8> mds;
+  for(const llvm::NamedMDNode& nmd : module.named_metadata())
+    for(const llvm::MDNode* md : nmd.operands())
+      return md;
+  for(const llvm::GlobalVariable& g : module.globals()) {
+    g.getAllMetadata(mds);
+    if(mds.size())
+      return mds.front().second;
+  }
+  for(const llvm::Function& f : module.functions()) {
+    f.getAllMetadata(mds);
+    if(mds.size())
+      return mds.front().second;
+    for(const llvm::BasicBlock& bb : f) {
+      for(const llvm::Instruction& inst : bb) {
+        inst.getAllMetadata(mds);
+        if(mds.size())
+          return mds.front().second;
+        for(const llvm::Value* op : inst.operand_values())
+          if(const auto* mv = dyn_cast<llvm::MetadataAsValue>(op))
+            if(const auto* md = dyn_cast<llvm::MDNode>(mv->getMetadata()))
+              return md;
+      }
+    }
+  }
+  return nullptr;
+}
+
+void
+Parser::collect_metadata_slots(const llvm::Module& module) {
+  // The slot tracker is only initialized when a slot is first looked up,
+  // so a metadata node has to be printed before anything can be collected.
+  // If there is no metadata node to print, there is nothing to collect
+  global_slots.reset(new llvm::SlotMapping());
+  if(const llvm::MDNode* md = get_any_metadata(module)) {
+    llvm::ModuleSlotTracker slots(&module);
+    llvm::ModuleSlotTracker::MachineMDNodeListType mds;
+    md->printAsOperand(llvm::nulls(), slots, &module);
+    slots.collectMDNodes(mds, 0, std::numeric_limits<unsigned>::max());
+    for(const auto& i : mds)
+      global_slots->MetadataNodes[i.first]
+          = llvm::TrackingMDNodeRef(const_cast<llvm::MDNode*>(i.second));
+  }
+}
+
+bool
+Parser::run_passes(llvm::Module& module) {
+#if LLVM_VERSION_MAJOR >= 13
+  if(options.passes.empty())
+    return true;
+
+  message() << "Running passes: " << options.passes << "\n";
+  llvm::LoopAnalysisManager lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager cgam;
+  llvm::ModuleAnalysisManager mam;
+  llvm::PassBuilder pb;
+  pb.registerModuleAnalyses(mam);
+  pb.registerCGSCCAnalyses(cgam);
+  pb.registerFunctionAnalyses(fam);
+  pb.registerLoopAnalyses(lam);
+  pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+  llvm::ModulePassManager mpm;
+  if(llvm::Error err = pb.parsePassPipeline(mpm, options.passes)) {
+    critical() << "Error parsing pass pipeline: "
+               << llvm::toString(std::move(err)) << "\n";
+    return false;
+  }
+  mpm.run(module, mam);
+#endif // LLVM_VERSION_MAJOR >= 13
+
+  return true;
+}
+
+std::unique_ptr<llvm::MemoryBuffer>
+Parser::print(const llvm::Module& module, llvm::StringRef name) {
+  message() << "Printing IR\n";
+
+  std::string s;
+  llvm::raw_string_ostream ss(s);
+  if(options.canonical) {
+    writer.reset(new CanonicalWriter());
+    module.print(ss, writer.get());
+  } else {
+    module.print(ss, nullptr);
+  }
+  ss.flush();
+
+  std::unique_ptr<llvm::MemoryBuffer> out
+      = StringMemoryBuffer::make(std::move(s), name);
+  ir      = out->getBuffer();
+  printed = true;
+  start_indexing();
+
+  // The metadata slots in the printed IR need not be the same as those in
+  // the file that was parsed, so they are always taken from the printer
+  collect_metadata_slots(module);
+
+  return out;
+}
+#endif // LLVM_VERSION_MAJOR >= 13
+
 std::tuple<std::unique_ptr<llvm::Module>, std::unique_ptr<llvm::MemoryBuffer>>
 Parser::parse_bc(std::unique_ptr<llvm::MemoryBuffer> in,
                  llvm::LLVMContext& context) {
   message() << "Parsing bitcode\n";
+  report(LoadPhase::Parsing, 0, in->getBufferSize());
 
+  std::unique_ptr<llvm::Module> module;
+  std::unique_ptr<llvm::MemoryBuffer> out;
+#if LLVM_VERSION_MAJOR >= 13
+  // The module is printed once into a buffer that will be owned by the
+  // lb::Module. The slot numbers for the metadata nodes are exactly those
+  // that the printer assigns, so they can be obtained from a slot tracker
+  // without having to parse the printed IR
+  if(llvm::Expected<std::unique_ptr<llvm::Module>> expected
+     = llvm::parseBitcodeFile(in->getMemBufferRef(), context)) {
+    module = std::move(expected.get());
+    if(run_passes(*module))
+      out = print(*module, in->getBufferIdentifier());
+    else
+      module.reset();
+  } else {
+    llvm::consumeError(expected.takeError());
+    critical() << "Error parsing bitcode\n";
+  }
+#else
   // When parsing a bitcode, we convert it back to IR and parse the IR instead.
   // It's the only way to get the slot numbers for metadata nodes
   // so we can link them up as well. At some point, we may make the linked
@@ -71,8 +265,6 @@ Parser::parse_bc(std::unique_ptr<llvm::MemoryBuffer> in,
   // double parsing
   //
   llvm::LLVMContext tmp;
-  std::unique_ptr<llvm::Module> module;
-  std::unique_ptr<llvm::MemoryBuffer> out;
   if(llvm::Expected<std::unique_ptr<llvm::Module>> expected
      = llvm::parseBitcodeFile(in->getMemBufferRef(), tmp)) {
     message() << "Converting bitcode to IR\n";
@@ -82,116 +274,53 @@ Parser::parse_bc(std::unique_ptr<llvm::MemoryBuffer> in,
     return parse_ir(llvm::MemoryBuffer::getMemBufferCopy(llvm::StringRef(s)),
                     context);
   } else {
+    llvm::consumeError(expected.takeError());
     critical() << "Error parsing bitcode\n";
   }
+#endif // LLVM_VERSION_MAJOR >= 13
 
   return std::make_tuple(std::move(module), std::move(out));
 }
 
-Offset
-Parser::find(llvm::StringRef key,
-             Offset cursor,
-             Lookback prev,
-             bool wrap,
-             std::set<Offset>& seen) {
-  Offset found = ir.find(key, cursor);
-  if(found == llvm::StringRef::npos) {
-    if(wrap)
-      return find(key, 0, prev, false, seen);
-    return llvm::StringRef::npos;
-  } else {
-    bool discard = false;
-    // Check the previous character if required
-    switch(prev) {
-    case Lookback::Any:
-      return found;
-      break;
-    case Lookback::Newline:
-      if(found > 0 and ir[found - 1] == '\n')
-        return found;
-      break;
-    case Lookback::Whitespace:
-      if(found > 0 and std::isspace(ir[found - 1]))
-        return found;
-      break;
-    case Lookback::Indent:
-      if(found > 0) {
-        for(Offset i = 1; (not discard) and (ir[found - i] != '\n'); i++)
-          if(!std::isspace(ir[found - i]))
-            discard = true;
-        if(not discard)
-          return found;
-      }
-      break;
-    default:
-      error() << "Internal error: Unknown Lookback type\n";
-      break;
-    }
-    // If not, record that we have seen this match before and continue
-    // searching. If we wrap around and come back to this position, then
-    // we know to stop
-    if(seen.insert(found).second)
-      return find(key, found + key.size(), prev, wrap, seen);
-    else
-      return llvm::StringRef::npos;
-  }
-}
-
-Offset
-Parser::find(llvm::StringRef key, Offset cursor, Lookback prev, bool wrap) {
-  std::set<Offset> seen;
-  return find(key, cursor, prev, wrap, seen);
-}
-
-Offset
-Parser::find_and_move(llvm::StringRef key, Lookback prev, Offset& cursor) {
-  Offset found = find(key, cursor, prev, true);
-  if(found != llvm::StringRef::npos)
-    cursor = found + key.size();
-  else
-    critical() << "Could not find key in IR: " << key << "\n";
-  return found;
-}
+std::tuple<std::unique_ptr<llvm::Module>, std::unique_ptr<llvm::MemoryBuffer>>
+Parser::parse_bc_lazily(llvm::MemoryBufferRef in,
+                        llvm::LLVMContext& context) {
+#if LLVM_VERSION_MAJOR >= 13
+  message() << "Parsing bitcode lazily\n";
+  report(LoadPhase::Parsing, 0, in.getBufferSize());
 
-Offset
-Parser::find_and_move(const std::string& key, Lookback prev, Offset& cursor) {
-  return find_and_move(llvm::StringRef(key), prev, cursor);
-}
+  // The bitcode reader records where the body of every function starts, so
+  // they can be read one at a time. The ones that are not read are printed
+  // with an empty body, which is all that gets linked
+  std::unique_ptr<llvm::Module> module;
+  std::unique_ptr<llvm::MemoryBuffer> out;
+  llvm::Expected<std::unique_ptr<llvm::Module>> expected
+      = llvm::getLazyBitcodeModule(in, context);
+  if(not expected) {
+    llvm::consumeError(expected.takeError());
+    critical() << "Error parsing bitcode\n";
+    return std::make_tuple(std::move(module), std::move(out));
+  }
 
-Offset
-Parser::find_function(llvm::StringRef func,
-                      llvm::StringRef prefix,
-                      Offset& cursor,
-                      std::set<Offset>& seen) {
-  // Search for the prefix wrapping around if necessary
-  Offset line_start = find(prefix, cursor, Lookback::Newline, true);
-  if(line_start != llvm::StringRef::npos) {
-    // The only way we don't find a newline is if it is the last line
-    Offset line_end
-        = find("\n", line_start + prefix.size(), Lookback::Any, false);
-    if(line_end == llvm::StringRef::npos)
-      line_end = find("\0", line_start + prefix.size(), Lookback::Any, false);
-    llvm::StringRef substr = ir.substr(line_start, line_end - line_start);
-    Offset found           = substr.find(func);
-    if(found != llvm::StringRef::npos) {
-      found  = line_start + found;
-      cursor = found + func.size();
-      return found;
-    } else if(seen.insert(found).second) {
-      return find_function(func, prefix, cursor, seen);
-    } else {
-      critical() << "Could not find function in IR: " << func << "\n";
+  module = std::move(expected.get());
+  // The passes need all the bodies
+  if(options.passes.size()) {
+    if(llvm::Error err = module->materializeAll()) {
+      critical() << "Error reading functions: "
+                 << llvm::toString(std::move(err)) << "\n";
+      return std::make_tuple(nullptr, nullptr);
     }
   }
-  return llvm::StringRef::npos;
-}
+  if(run_passes(*module))
+    out = print(*module, in.getBufferIdentifier());
+  else
+    module.reset();
 
-Offset
-Parser::find_function(llvm::StringRef func,
-                      llvm::StringRef prefix,
-                      Offset& cursor) {
-  std::set<Offset> seen;
-  return find_function(func, prefix, cursor, seen);
+  return std::make_tuple(std::move(module), std::move(out));
+#else
+  warning() << "Lazy bitcode needs LLVM 13 or later. Reading everything\n";
+  return parse_bc(llvm::MemoryBuffer::getMemBuffer(in, false), context);
+#endif // LLVM_VERSION_MAJOR >= 13
 }
 
 void
@@ -222,47 +351,97 @@ Parser::collect_constants(const llvm::Constant* c,
   }
 }
 
-std::vector<INavigable*>
-Parser::collect_constants(const llvm::Constant* c, Module& module) {
-  std::vector<INavigable*> consts;
-  collect_constants(c, module, consts);
-  return consts;
+void
+Parser::link_next_use(INavigable& v,
+                      Lexer& lexer,
+                      Offset end,
+                      LinkState& state) {
+  Token tok;
+  Offset cursor = lexer.get_cursor();
+  while(lexer.next(tok) and (tok.get_begin() < end)) {
+    if(tok.is_identifier() and (tok.get_text(ir) == v.get_tag())) {
+      state.uses.push_back({tok.get_begin(), tok.get_end(), &v});
+      return;
+    }
+  }
+
+  // Leave the lexer where it was so the values that follow can still be
+  // found
+  warning() << "Could not find constant operand in IR: " << v.get_tag()
+            << "\n";
+  lexer.reset(cursor);
 }
 
-bool
-Parser::overlaps(Offset pos, const std::map<INavigable*, Offset>& mapped) {
-  for(const auto& it : mapped) {
-    const INavigable* v = it.first;
-    Offset begin        = it.second;
-    Offset end          = begin + v->get_tag().size();
-    if(pos >= begin and pos <= end)
-      return true;
-  }
-  return false;
+void
+Parser::link_constant(const llvm::Constant* c,
+                      Module& module,
+                      Lexer& lexer,
+                      Offset end,
+                      LinkState& state) {
+  // The operands of a constant are printed in order and a depth-first walk
+  // of the constant visits the global values in the same order in which
+  // they appear in the text. The text is consumed as the walk proceeds, so
+  // nothing needs to be collected however large the constant is
+  if(const auto* g = dyn_cast<llvm::GlobalVariable>(c))
+    link_next_use(module.get(*g), lexer, end, state);
+  else if(const auto* a = dyn_cast<llvm::GlobalAlias>(c))
+    link_next_use(module.get(*a), lexer, end, state);
+  else if(const auto* f = dyn_cast<llvm::Function>(c))
+    link_next_use(module.get(*f), lexer, end, state);
+  else if(isa<llvm::ConstantData>(c) or isa<llvm::BlockAddress>(c))
+    ;
+  else if(isa<llvm::ConstantAggregate>(c) or isa<llvm::ConstantExpr>(c))
+    for(const llvm::Value* op : c->operand_values())
+      link_constant(cast<llvm::Constant>(op), module, lexer, end, state);
+  else
+    critical() << "Unknown constant type: " << *c << "\n";
 }
 
-std::map<INavigable*, Offset>
-Parser::associate_values(std::vector<INavigable*> values,
-                         Module& module,
-                         Offset cursor,
-                         Instruction* inst) {
+void
+Parser::associate_values(const std::vector<INavigable*>& values,
+                         LinkState& state,
+                         llvm::ArrayRef<Token> tokens) {
   // The list of values provided here are typically the operands in a
-  // LLVM::Instruction or llvm::ConstantExpr. We need to find the corresponding
-  // tag for each value in the text and associate the value with that piece
-  // of text
+  // LLVM::Instruction or llvm::ConstantExpr. Each value is associated with a
+  // token whose text is exactly the tag of the value. Most of the time, the
+  // operands are printed in the same order in which they appear in LLVM, so
+  // the search for each one starts just past the previous match. It wraps
+  // around for those that aren't like the callee of a call which is the
+  // last operand but is printed before the arguments. A token can only be
+  // matched once, so repeated operands get distinct uses
+  std::vector<bool>& taken = state.taken;
+  taken.assign(tokens.size(), false);
 
-  sort_by_tag_name(values);
-  std::map<INavigable*, Offset> mapped;
+  size_t next = 0;
   for(INavigable* v : values) {
     llvm::StringRef tag = v->get_tag();
-    Offset pos          = find(tag, cursor, Lookback::Whitespace, false);
-    while(overlaps(pos, mapped))
-      pos = find(tag, pos + 1, Lookback::Whitespace, false);
-    mapped[v] = pos;
-    v->add_use(Use::make(pos, pos + v->get_tag().size(), *v, module, inst));
+    size_t found        = tokens.size();
+    for(size_t i = 0; (i < tokens.size()) and (found == tokens.size()); i++) {
+      size_t j = (next + i) % tokens.size();
+      if((not taken[j]) and tokens[j].is_identifier()
+         and (tokens[j].get_text(ir) == tag))
+        found = j;
+    }
+    if(found == tokens.size()) {
+      warning() << "Could not find operand in IR: " << tag << "\n";
+      continue;
+    }
+
+    taken[found] = true;
+    next         = found + 1;
+
+    state.uses.push_back({tokens[found].get_begin(), tokens[found].get_end(), v});
   }
+}
 
-  return mapped;
+llvm::ArrayRef<Token>
+Parser::tokenize(Offset begin, Offset end, LinkState& state) const {
+  Token tok;
+  Lexer lexer(ir, begin);
+  state.operands.clear();
+  while(lexer.next(tok) and (tok.get_begin() < end))
+    state.operands.push_back(tok);
+  return state.operands;
 }
 
 static bool
@@ -272,6 +451,24 @@ is_debug_metadata(const llvm::MDNode* md) {
          or isa<llvm::DIGlobalVariableExpression>(md);
 }
 
+// Expand the number of MDNodes that get used until we reach a fixed point
+// The DI* nodes should not be navigable, but everything else should
+static std::set<const llvm::MDNode*>
+get_reachable(std::set<const llvm::MDNode*> wl) {
+  std::set<const llvm::MDNode*> seen = wl;
+  std::set<const llvm::MDNode*> wl2;
+  do {
+    for(const llvm::MDNode* md : wl)
+      for(const llvm::MDOperand& mop : md->operands())
+        if(const auto* op = dyn_cast_or_null<llvm::MDNode>(mop))
+          if(not is_debug_metadata(op))
+            if(seen.insert(op).second)
+              wl2.insert(op);
+    wl = std::move(wl2);
+  } while(wl.size());
+  return seen;
+}
+
 std::vector<const llvm::MDNode*>
 Parser::get_metadata(const llvm::GlobalObject& g) {
   std::vector<const llvm::MDNode*> ret;
@@ -298,37 +495,768 @@ Parser::get_metadata(const llvm::Instruction& inst) {
   return ret;
 }
 
-bool
-Parser::link(Module& module) {
-  // Not really sure if this is actually helping.
-  // But the idea is that I don't have to allocate a string every time
-  // I need to create a key to search for an instruction definition.
-  // Same for the vector for metadata nodes
-  std::string buf;
-  llvm::raw_string_ostream ss(buf);
+Offset
+Parser::find_instruction(llvm::StringRef tag,
+                         bool has_value,
+                         const std::vector<Token>& tokens,
+                         size_t& idx) const {
+  for(size_t i = idx; i < tokens.size(); i++) {
+    const Token& line = tokens[i];
+    // Instructions are always indented. This skips over blank lines and the
+    // lines with the labels of basic blocks
+    if((not line.is(TokenKind::Line)) or (line.get_begin() == line.get_end())
+       or (ir[line.get_end()] == '\n'))
+      continue;
+
+    bool defines = (i + 2 < tokens.size())
+                   and tokens[i + 1].is(TokenKind::Local)
+                   and (tokens[i + 1].get_begin() == line.get_end())
+                   and tokens[i + 2].is(TokenKind::Equals);
+    if(has_value) {
+      if(defines and (tokens[i + 1].get_text(ir) == tag)) {
+        idx = i + 1;
+        return line.get_end();
+      }
+    } else if(not defines) {
+      // Lines that continue an instruction (the cases of a switch, the
+      // clauses of a landingpad etc.) are also indented, but they will never
+      // start with an opcode
+      llvm::StringRef text = ir.substr(line.get_end(), tag.size() + 1);
+      if(text.startswith(tag)
+         and ((text.size() == tag.size()) or std::isspace(text.back()))) {
+        idx = i + 1;
+        return line.get_end();
+      }
+    }
+  }
+  return llvm::StringRef::npos;
+}
+
+Offset
+Parser::find_function_body(const Function& f) const {
+  // The opening brace is the last thing on the line with the definition.
+  // We can't just look for the first brace after the name because the
+  // arguments could be literal structs
+  Offset eol   = ir.find('\n', f.get_llvm_defn().get_end());
+  Offset brace = ir.rfind('{', eol);
+  if((brace != llvm::StringRef::npos)
+     and (brace >= f.get_llvm_defn().get_end()))
+    return brace;
+  return llvm::StringRef::npos;
+}
+
+void
+Parser::set_local_tags(const llvm::Function& llvm_f,
+                       Module& module,
+                       LinkState& state) {
+  for(const llvm::Argument& llvm_arg : llvm_f.args()) {
+    Argument& arg = module.get(llvm_arg);
+    if(llvm_arg.hasName())
+      arg.set_tag(state.arena, llvm_arg.getName(), "%");
+    else
+      arg.set_tag(state.arena, state.slots->getLocalSlot(&llvm_arg));
+
+    // Not going to try and set a definition for arguments. Currently, LLVM
+    // removes all references to them in the IR. Even defined functions
+    // only have a type and not even a slot representation for the arguments.
+    // Of course, they implicitly show up in the code afterwards which
+    // is really nice! The reasoning is so the IR is smaller. I am not sure
+    // how much smaller the IR becomes as a result of these elisions and how
+    // much of a benefit is derived from it. I really hope it is significant,
+    // otherwise, it's yet another one of those micro-optimizations that
+    // ends up being a pain in the ass for some people.
+  }
+
+  // Iterate over all the basic blocks and instructions and set their tag
+  // first because we can have "forward references" to them in branch and phi
+  // instructions respectively. If we don't assign them a tag first,
+  // we can't link them up correctly
+  for(const llvm::BasicBlock& llvm_bb : llvm_f) {
+    BasicBlock& bb = module.get(llvm_bb);
+    if(llvm_bb.hasName())
+      bb.set_tag(state.arena, llvm_bb.getName(), "%");
+    else
+      bb.set_tag(state.arena, state.slots->getLocalSlot(&llvm_bb));
+    for(const llvm::Instruction& llvm_inst : llvm_bb) {
+      Instruction& inst = module.get(llvm_inst);
+      if(llvm_inst.hasName())
+        inst.set_tag(state.arena, llvm_inst.getName(), "%");
+      else if(not llvm_inst.getType()->isVoidTy())
+        inst.set_tag(state.arena, state.slots->getLocalSlot(&llvm_inst));
+      else if(const auto* call = dyn_cast<llvm::CallInst>(&llvm_inst))
+        // The tag for void instructions is whatever the instruction starts
+        // with in the IR, so we have to distinguish between kinds of calls
+        if(call->isMustTailCall())
+          inst.set_tag("musttail call");
+        else if(call->isTailCall())
+          inst.set_tag("tail call");
+        else if(call->isNoTailCall())
+          inst.set_tag("notail call");
+        else
+          inst.set_tag("call");
+      else
+        inst.set_tag(llvm_inst.getOpcodeName());
+    }
+  }
+}
+
+void
+Parser::link_instruction(const llvm::Instruction& llvm_inst,
+                         Offset i_begin,
+                         Module& module,
+                         LinkState& state) {
+  Instruction& inst   = module.get(llvm_inst);
+  llvm::StringRef tag = inst.get_tag();
+
+  if(not llvm_inst.getType()->isVoidTy())
+    state.add_definition(inst, i_begin, i_begin + tag.size());
+  else
+    state.add_definition(inst, i_begin, i_begin);
+}
+
+void
+Parser::link_operands(const llvm::Instruction& llvm_inst,
+                      llvm::ArrayRef<Token> tokens,
+                      Module& module,
+                      LinkState& state) {
   std::vector<INavigable*> ops;
-  std::set<const llvm::MDNode*> wl;
-  Offset cursor = 0;
 
-  local_slots.reset(new llvm::ModuleSlotTracker(&module.get_llvm()));
+  // Nothing here parses the instruction. The operands are matched against
+  // the identifiers in the text of the instruction, which could be split
+  // over multiple lines
+  for(const llvm::Value* op : llvm_inst.operand_values())
+    // If the module does not contain the operand, then it is either a
+    // llvm::Metadata (more specifically, llvm::MetadataAsValue) or
+    // an llvm::Constant. Most constants we don't care about, but
+    // we do care about llvm::ConstantExpr because they could contain
+    // references to llvm::Function or llvm::GlobalVariable that we
+    // do care about. As with other instances, we just collect them
+    // all now and process them later
+    if(const auto* i = dyn_cast<llvm::Instruction>(op))
+      ops.push_back(&module.get(*i));
+    else if(const auto* a = dyn_cast<llvm::Argument>(op))
+      ops.push_back(&module.get(*a));
+    else if(const auto* f = dyn_cast<llvm::Function>(op))
+      ops.push_back(&module.get(*f));
+    else if(const auto* g = dyn_cast<llvm::GlobalVariable>(op))
+      ops.push_back(&module.get(*g));
+    else if(const auto* a = dyn_cast<llvm::GlobalAlias>(op))
+      ops.push_back(&module.get(*a));
+    else if(const auto* bb = dyn_cast<llvm::BasicBlock>(op))
+      ops.push_back(&module.get(*bb));
+    else if(const auto* c = dyn_cast<llvm::Constant>(op))
+      collect_constants(c, module, ops);
+    else if(isa<llvm::MetadataAsValue>(op))
+      ;
+    else
+      critical() << "Unexpected instruction operand: " << *op << "\n";
+
+  for(const llvm::MDNode* llvm_md : get_metadata(llvm_inst)) {
+    ops.push_back(&module.get(*llvm_md));
+    // This will be used to collect all the MDNode's seen in function
+    // metadata after which it will get used to get all MDNodes reachable
+    // from it
+    state.wl.insert(llvm_md);
+  }
+
+  associate_values(ops, state, tokens);
+}
+
+void
+Parser::link_body(const llvm::Function& llvm_f,
+                  Offset f_begin,
+                  Module& module,
+                  LinkState& state) {
+  std::vector<Token>& tokens = state.tokens;
+  Function& f                = module.get(llvm_f);
+
+  // A single pass over the body gets all the tokens that we need to link
+  // the instructions. Everything after this works only off the tokens
+  tokens.clear();
+  Lexer lexer(ir);
+  Offset f_end = lexer.lex_function_body(f_begin, tokens);
+  if(f_end == llvm::StringRef::npos) {
+    critical() << "Could not find end of function: " << f.get_tag() << "\n";
+    incomplete = true;
+    return;
+  }
+
+  // Now iterate over all the basic blocks and the instructions
+  // We don't have to worry about forward iterations on instructions because
+  // it is incorrect to have an instruction use preceding a definition.
+  // The tokens of an instruction are only known once the next one has been
+  // found, so its operands are linked then
+  llvm::ArrayRef<Token> all(tokens);
+  const llvm::Instruction* llvm_last = nullptr;
+  size_t last_idx                    = 0;
+  size_t idx                         = 0;
+  for(const llvm::BasicBlock& llvm_bb : llvm_f) {
+    BasicBlock& bb         = module.get(llvm_bb);
+    Instruction* inst_prev = nullptr;
+    for(const llvm::Instruction& llvm_inst : llvm_bb) {
+      Instruction& inst   = module.get(llvm_inst);
+      llvm::StringRef tag = inst.get_tag();
+      bool has_value      = not llvm_inst.getType()->isVoidTy();
+
+      Offset i_begin = find_instruction(tag, has_value, tokens, idx);
+      if(i_begin == llvm::StringRef::npos) {
+        critical() << "Could not find instruction in IR: " << tag << "\n";
+        incomplete = true;
+        continue;
+      }
+      link_instruction(llvm_inst, i_begin, module, state);
+      if(llvm_last)
+        link_operands(*llvm_last,
+                      all.slice(last_idx, idx - 1 - last_idx),
+                      module,
+                      state);
+      // Skip over the definition of the instruction if there is one
+      llvm_last = &llvm_inst;
+      last_idx  = has_value ? idx + 2 : idx;
+
+      // Because instructions can span multiple lines, a reasonable way to
+      // determine the span of an instruction is to wait until the next
+      // instruction in the block is found and assume that it extends till
+      // the end of the line prior to the current instruction. The last
+      // instruction in the basic block will be dealt with when the span of
+      // the basic block is computed because it will be assumed to span till
+      // the end of the block
+      if(inst_prev)
+        inst_prev->set_llvm_span(
+            LLVMRange(inst_prev->get_llvm_defn().get_begin(),
+                      tokens[idx - 1].get_begin() - 1));
+      inst_prev = &inst;
+    }
+
+    // There isn't a reasonable way to find the start of a basic block
+    // other than by finding the location of the first instruction in it
+    // It might not be safe to rely on the labels being printed as comments
+    // Already, the label for the entry block has been removed from the IR
+    // We don't really have a reasonable place to go to when we go to the
+    // definition of a basic block other than to the start of the first
+    // instruction
+    const Instruction& front = module.get(llvm_bb.front());
+    if(not front.has_llvm_defn()) {
+      warning() << "Could not compute span for basic block\n";
+      continue;
+    }
+    Offset bb_begin = front.get_llvm_defn().get_begin();
+    state.add_definition(bb, bb_begin, bb_begin);
+
+    // Similarly, the end of the block is a bit problematic because
+    // instructions can span multiple lines and relying on any particular
+    // representation of the instruction is a bad idea.
+    // If this is not the exit block, once we have the last instruction,
+    // we continue looking for the first blank line because there is always
+    // an empty line between basic blocks (hopefully that won't go away)
+    // If it is the last basic block in the function, then the block ends at
+    // the closing brace of the function
+    Offset bb_end = llvm::StringRef::npos;
+    if(&llvm_bb != &llvm_f.back()) {
+      for(; (idx < tokens.size()) and (bb_end == llvm::StringRef::npos); idx++)
+        if(tokens[idx].is(TokenKind::Line)
+           and (tokens[idx].get_begin() == tokens[idx].get_end())
+           and (ir[tokens[idx].get_begin()] == '\n'))
+          bb_end = tokens[idx].get_begin();
+    } else {
+      // Move it so the block ends *before* the closing brace. We want the
+      // function to end at the brace. Tiny thing, but still
+      bb_end = f_end - 1;
+    }
+
+    if(bb_end != llvm::StringRef::npos) {
+      bb.set_llvm_span(LLVMRange(bb_begin, bb_end));
+      if(inst_prev)
+        inst_prev->set_llvm_span(
+            LLVMRange(inst_prev->get_llvm_defn().get_begin(), bb_end));
+    } else {
+      warning() << "Could not compute span for basic block\n";
+    }
+  }
+
+  if(llvm_last)
+    link_operands(*llvm_last, all.drop_front(last_idx), module, state);
 
+  f.set_llvm_span(LLVMRange(f_begin, f_end));
+}
+
+void
+Parser::link_body_exact(const llvm::Function& llvm_f,
+                        Offset f_begin,
+                        Module& module,
+                        LinkState& state) {
+  Function& f  = module.get(llvm_f);
+  Offset f_end = llvm::StringRef::npos;
+
+  // The spans are the same as the ones that link_body() would compute. The
+  // difference is that nothing has to be searched for because everything
+  // was recorded when the module was printed
+  for(const llvm::BasicBlock& llvm_bb : llvm_f) {
+    BasicBlock& bb = module.get(llvm_bb);
+    for(const llvm::Instruction& llvm_inst : llvm_bb) {
+      Instruction& inst = module.get(llvm_inst);
+
+      // The recorded beginning is the start of the line, so skip over the
+      // indentation
+      Offset i_begin = writer->get_begin(llvm_inst);
+      Offset i_end   = writer->get_end(llvm_inst);
+      if((i_begin == llvm::StringRef::npos)
+         or (i_end == llvm::StringRef::npos)) {
+        critical() << "Instruction was not printed: " << inst.get_tag()
+                   << "\n";
+        incomplete = true;
+        continue;
+      }
+      while((i_begin < i_end) and std::isspace(ir[i_begin]))
+        i_begin++;
+      link_instruction(llvm_inst, i_begin, module, state);
+      link_operands(llvm_inst,
+                    tokenize(inst.get_llvm_defn().get_end(), i_end, state),
+                    module,
+                    state);
+
+      // The instruction ends at the newline following it
+      inst.set_llvm_span(LLVMRange(i_begin, i_end));
+    }
+
+    Offset bb_begin          = writer->get_begin(llvm_bb);
+    Offset bb_end            = writer->get_end(llvm_bb);
+    const Instruction& front = module.get(llvm_bb.front());
+    if((bb_begin == llvm::StringRef::npos) or (bb_end == llvm::StringRef::npos)
+       or not front.has_llvm_defn()) {
+      warning() << "Could not compute span for basic block\n";
+      continue;
+    }
+
+    // The recorded end of the block is just past the newline at the end of
+    // the last instruction. For all blocks but the last, that is the blank
+    // line separating it from the next block, and for the last block, it is
+    // the closing brace of the function
+    bb_begin = front.get_llvm_defn().get_begin();
+    if(&llvm_bb == &llvm_f.back()) {
+      f_end = bb_end;
+      bb_end -= 1;
+    }
+    state.add_definition(bb, bb_begin, bb_begin);
+    bb.set_llvm_span(LLVMRange(bb_begin, bb_end));
+    if(const llvm::Instruction* back = llvm_bb.getTerminator())
+      module.get(*back).set_llvm_span(
+          LLVMRange(module.get(*back).get_llvm_defn().get_begin(), bb_end));
+  }
+
+  if(f_end != llvm::StringRef::npos)
+    f.set_llvm_span(LLVMRange(f_begin, f_end));
+  else
+    warning() << "Could not compute span for function: " << f.get_tag()
+              << "\n";
+}
+
+static Offset
+get_line_begin(llvm::StringRef text, Offset pos) {
+  // If there is no newline before the position, rfind() returns npos and
+  // adding 1 to that wraps around to the start of the text
+  return text.rfind('\n', pos) + 1;
+}
+
+const Function*
+Parser::find_unchanged(const Function& f) const {
+  const llvm::Function* llvm_old
+      = previous->get_llvm().getFunction(f.get_llvm().getName());
+  if(not llvm_old or not f.has_llvm_defn())
+    return nullptr;
+
+  // A function in a module that was loaded lazily may never have been
+  // linked, in which case there is nothing to copy
+  const Function& old = previous->get(*llvm_old);
+  if(not old.is_materialized() or not old.has_llvm_defn()
+     or not old.has_llvm_span())
+    return nullptr;
+
+  Offset f_begin = find_function_body(f);
+  if(f_begin == llvm::StringRef::npos)
+    return nullptr;
+  Offset f_end = decls.get_closing_brace(f_begin);
+  if(f_end == llvm::StringRef::npos)
+    return nullptr;
+
+  // The whole of the line with the definition is compared because the
+  // names of the arguments are there. Nothing outside the function can
+  // change where anything inside it is, so if the text is the same, so are
+  // the links
+  const Document& code = previous->get_document();
+  Offset begin         = get_line_begin(ir, f.get_llvm_defn().get_begin());
+  Offset old_begin     = code.get_line_begin(old.get_llvm_defn().get_begin());
+  Offset old_end       = old.get_llvm_span().get_end();
+  if(not code.equals(old_begin, old_end + 1, ir.slice(begin, f_end + 1)))
+    return nullptr;
+
+  return &old;
+}
+
+bool
+Parser::relink_unchanged(const llvm::Function& llvm_f,
+                         const Function& old,
+                         Module& module,
+                         LinkState& state) {
+  Function& f = module.get(llvm_f);
+
+  // The text of the function is the same, so the arguments, blocks and
+  // instructions are in the same order in both
+  llvm::DenseMap<const INavigable*, INavigable*> locals;
+  auto old_arg = old.arg_begin();
+  for(const llvm::Argument& llvm_arg : llvm_f.args()) {
+    if(old_arg == old.arg_end())
+      return false;
+    locals[&*old_arg] = &module.get(llvm_arg);
+    ++old_arg;
+  }
+  auto old_bb = old.begin();
+  for(const llvm::BasicBlock& llvm_bb : llvm_f) {
+    if(old_bb == old.end())
+      return false;
+    locals[&*old_bb] = &module.get(llvm_bb);
+    auto old_inst = old_bb->begin();
+    for(const llvm::Instruction& llvm_inst : llvm_bb) {
+      if(old_inst == old_bb->end())
+        return false;
+      locals[&*old_inst] = &module.get(llvm_inst);
+      ++old_inst;
+    }
+    ++old_bb;
+  }
+  auto lookup = [&](const INavigable& n) -> INavigable* {
+    auto it = locals.find(&n);
+    if(it != locals.end())
+      return it->second;
+    return top_level.lookup(n.get_tag());
+  };
+
+  Offset old_begin = old.get_llvm_span().get_begin();
+  Offset old_end   = old.get_llvm_span().get_end();
+  Offset f_begin   = find_function_body(f);
+  auto shift = [&](Offset o) { return o - old_begin + f_begin; };
+
+  // Everything used in the function is found before anything is added so
+  // the function can still be linked as usual if something is missing
+  std::vector<RangeTable::Entry> used;
+  for(const Use& old_use : previous->get_uses_in(old_begin, old_end)) {
+    INavigable* v = lookup(old_use.get_used());
+    if(not v) {
+      warning() << "Could not find " << old_use.get_used().get_tag()
+                << " in reloaded module. Relinking " << f.get_tag() << "\n";
+      return false;
+    }
+    used.push_back({shift(old_use.get_begin()), shift(old_use.get_end()), v});
+  }
+
+  state.uses.insert(state.uses.end(), used.begin(), used.end());
+  for(const Definition& old_def :
+      previous->get_definitions_in(old_begin, old_end))
+    if(INavigable* defined = locals.lookup(&old_def.get_defined()))
+      state.add_definition(*defined,
+                           shift(old_def.get_begin()),
+                           shift(old_def.get_end()));
+  for(const auto& i : locals) {
+    const LLVMRange& span = i.first->get_llvm_span();
+    if(i.first->has_llvm_span())
+      i.second->set_llvm_span(
+          LLVMRange(shift(span.get_begin()), shift(span.get_end())));
+  }
+  f.set_llvm_span(LLVMRange(f_begin, shift(old_end)));
+
+  // The metadata attached to the instructions still has to be found so that
+  // the metadata reachable from it can be linked
+  for(const llvm::BasicBlock& llvm_bb : llvm_f)
+    for(const llvm::Instruction& llvm_inst : llvm_bb)
+      for(const llvm::MDNode* md : get_metadata(llvm_inst))
+        state.wl.insert(md);
+
+  return true;
+}
+
+void
+Parser::link_function(const llvm::Function& llvm_f,
+                      Module& module,
+                      LinkState& state) {
+  Function& f = module.get(llvm_f);
+  state.slots->incorporateFunction(llvm_f);
+
+  Offset f_begin = find_function_body(f);
+  if(f_begin == llvm::StringRef::npos) {
+    critical() << "Could not find body of function: " << f.get_tag() << "\n";
+    incomplete = true;
+    return;
+  }
+
+  set_local_tags(llvm_f, module, state);
+  auto it = unchanged.find(&f);
+  if((it != unchanged.end())
+     and relink_unchanged(llvm_f, *it->second, module, state))
+    return;
+  if(writer)
+    link_body_exact(llvm_f, f_begin, module, state);
+  else
+    link_body(llvm_f, f_begin, module, state);
+}
+
+void
+Parser::link_functions(Module& module, LinkState& state) {
+  std::vector<const llvm::Function*> work;
+  for(const llvm::Function& llvm_f : module.get_llvm().functions())
+    // For functions that are declared, we don't even try to do anything.
+    // If the module is being linked lazily, only the functions that are
+    // copied from the previous module are linked now
+    if(llvm_f.size()
+       and (not module.fn_linker or unchanged.count(&module.get(llvm_f))))
+      work.push_back(&llvm_f);
+  if(work.empty())
+    return;
+
+  // Linking is bound by the CPU, so any threads beyond the number of cores
+  // would only contend with the others. The number of cores is 0 if it
+  // can't be determined
+  unsigned cores   = std::thread::hardware_concurrency();
+  unsigned threads = options.num_threads;
+  if(not threads or (cores and (threads > cores)))
+    threads = cores;
+  threads = std::min<size_t>(std::max(threads, 1U), work.size());
+
+  // The progress is only reported when another percent of the functions
+  // has been linked. Exactly one function crosses each step, so only that
+  // thread takes the lock and calls the callback, and the last function
+  // always reports that everything is done
+  size_t total = work.size();
+  auto linked_one = [this, total](size_t done) {
+    if((done * 100 / total) != ((done - 1) * 100 / total))
+      report(LoadPhase::Functions, done, total);
+  };
+  report(LoadPhase::Functions, 0, total);
+  if(threads <= 1) {
+    for(size_t j = 0; j < work.size(); j++) {
+      link_function(*work[j], module, state);
+      linked_one(j + 1);
+    }
+    return;
+  }
+
+  // Functions vary wildly in size, so instead of splitting them evenly
+  // between the threads up front, each thread picks up the next function
+  // that hasn't been linked as soon as it is done with the current one
+  std::atomic<size_t> next(0);
+  std::atomic<size_t> linked(0);
+  std::vector<std::unique_ptr<LinkState>> states;
+  std::vector<std::thread> pool;
+  for(unsigned i = 0; i < threads; i++) {
+    module.arenas.emplace_back(new Arena());
+    states.emplace_back(
+        new LinkState(module.get_llvm(), *module.arenas.back()));
+  }
+  for(unsigned i = 0; i < threads; i++)
+    pool.emplace_back(
+        [this, &work, &next, &linked, &linked_one, &module, &states, i]() {
+          for(size_t j = next++; j < work.size(); j = next++) {
+            link_function(*work[j], module, *states[i]);
+            linked_one(++linked);
+          }
+        });
+  for(std::thread& t : pool)
+    t.join();
+
+  // Everything gets sorted once linking is complete, so the order in which
+  // the states are merged doesn't matter
+  for(std::unique_ptr<LinkState>& s : states) {
+    state.uses.insert(state.uses.end(), s->uses.begin(), s->uses.end());
+    state.defs.insert(state.defs.end(), s->defs.begin(), s->defs.end());
+    state.wl.insert(s->wl.begin(), s->wl.end());
+  }
+}
+
+void
+Parser::merge(LinkState& state, Module& module) {
+  for(const RangeTable::Entry& use : state.uses)
+    module.add_use(*use.value, use.begin, use.end);
+  module.new_defs.insert(
+      module.new_defs.end(), state.defs.begin(), state.defs.end());
+  state.uses.clear();
+  state.defs.clear();
+}
+
+void
+Parser::defer_function(Function& f,
+                       Module& module,
+                       std::set<const llvm::MDNode*>& wl) {
+  // The function can only be linked later if its extent is known. That
+  // is enough to tell when the cursor is inside it
+  Offset f_begin = find_function_body(f);
+  Offset f_end   = llvm::StringRef::npos;
+  if(f_begin != llvm::StringRef::npos)
+    f_end = decls.get_closing_brace(f_begin);
+  if(f_end == llvm::StringRef::npos) {
+    critical() << "Could not find body of function: " << f.get_tag() << "\n";
+    incomplete = true;
+    f.make_body();
+    return;
+  }
+  f.set_llvm_span(LLVMRange(f_begin, f_end));
+  module.fn_linker->add(f);
+
+  // The metadata attached to the instructions is needed to find all the
+  // metadata nodes that could be navigated to. It's cheap enough to get
+  // from LLVM without linking anything
+  const llvm::Function& llvm_f = f.get_llvm();
+  for(const llvm::BasicBlock& llvm_bb : llvm_f)
+    for(const llvm::Instruction& llvm_inst : llvm_bb)
+      for(const llvm::MDNode* md : get_metadata(llvm_inst)) {
+        wl.insert(md);
+        module.fn_linker->add_attachment(*md, llvm_f);
+      }
+}
+
+void
+Parser::link_lazily(const llvm::Function& llvm_f,
+                    Module& module,
+                    std::set<INavigable*>& touched) {
+  module.get(llvm_f).make_body();
+  link_function(llvm_f, module, *lazy);
+  for(const RangeTable::Entry& use : lazy->uses)
+    touched.insert(use.value);
+
+  // All the metadata reachable from the function was found when the module
+  // was linked
+  lazy->wl.clear();
+  merge(*lazy, module);
+}
+
+bool
+Parser::link_read(const llvm::Function& llvm_f,
+                  llvm::StringRef text,
+                  Offset offset,
+                  Module& module,
+                  std::set<INavigable*>& touched,
+                  std::set<const llvm::MDNode*>& reachable) {
+  // Only the text of the function is linked, so everything is found at an
+  // offset into it and moved to where the function is once it is linked
+  ir = text;
+  decls.build(ir);
+
+  Function& f = module.get(llvm_f);
+  Offset pos  = decls.get(f.get_tag());
+  if(pos == llvm::StringRef::npos) {
+    critical() << "Could not find function definition: " << f.get_tag()
+               << "\n";
+    return false;
+  }
+
+  LinkState state(module.get_llvm(), module.get_arena());
+  state.add_definition(f, pos, pos + f.get_tag().size());
+  f.make_body();
+  link_function(llvm_f, module, state);
+  if(incomplete)
+    return false;
+
+  for(RangeTable::Entry& use : state.uses) {
+    use.begin += offset;
+    use.end += offset;
+    touched.insert(use.value);
+  }
+  for(RangeTable::Entry& def : state.defs) {
+    def.begin += offset;
+    def.end += offset;
+    def.value->set_llvm_defn(LLVMRange(def.begin, def.end));
+  }
+  auto move_span = [offset](INavigable& n) {
+    if(const LLVMRange& span = n.get_llvm_span())
+      n.set_llvm_span(LLVMRange(span.get_begin() + offset,
+                                span.get_end() + offset));
+  };
+  move_span(f);
+  for(const llvm::BasicBlock& llvm_bb : llvm_f) {
+    move_span(module.get(llvm_bb));
+    for(const llvm::Instruction& llvm_inst : llvm_bb)
+      move_span(module.get(llvm_inst));
+  }
+  if(const llvm::Comdat* c = llvm_f.getComdat())
+    module.get(*c).set_llvm_defn(f.get_llvm_defn());
+  merge(state, module);
+
+  for(const llvm::MDNode* md : get_metadata(llvm_f))
+    state.wl.insert(md);
+  reachable = get_reachable(std::move(state.wl));
+
+  return true;
+}
+
+bool
+Parser::is_printed() const {
+  return printed;
+}
+
+bool
+Parser::is_complete() const {
+  return not incomplete;
+}
+
+void
+Parser::report(LoadPhase phase, uint64_t done, uint64_t total) {
+  if(not options.progress)
+    return;
+
+  std::lock_guard<std::mutex> lock(progress_lock);
+  options.progress(phase, done, total);
+}
+
+bool
+Parser::link_cached(Module& module, LinkCache& cache, LinkState& state) {
+  message() << "Reading links from cache\n";
+  for(const llvm::Function& llvm_f : module.get_llvm().functions()) {
+    if(llvm_f.size()) {
+      state.slots->incorporateFunction(llvm_f);
+      set_local_tags(llvm_f, module, state);
+    }
+  }
+  return cache.load(module);
+}
+
+bool
+Parser::link(Module& module, LinkCache* cache, const Module* previous) {
   llvm::Module& llvm = module.get_llvm();
+  LinkState state(llvm, module.arena);
 
-  // The next steps are done in order for a reason
-  // As of LLVM 8, the StructType's appear first in the IR file followed by the
-  // Comdat's, GlobalVariable's, GlobalAlias'es and the Function's.
-  // We don't want to have to keep jumping back and forth for things in the
-  // text so we process everything in order
+  // Everything in the cache is linked, so nothing needs to be deferred and
+  // nothing needs to be copied from the previous module either
+  bool cached = cache and cache->has_links();
+  if(not cached)
+    this->previous = previous;
+  if(options.lazy_functions and not cached) {
+    lazy.reset(new LinkState(llvm, module.arena));
+    module.fn_linker.reset(new FunctionLinker(*this, module));
+  }
+  std::set<const llvm::MDNode*>& wl = state.wl;
 
+  // All the top-level entities are found with a single scan over the IR
+  // that was started when the IR was parsed. After this, looking up the
+  // definition of any of them is a hash table lookup, so the order in which
+  // they are processed doesn't matter
+  message() << "Indexing declarations\n";
+  report(LoadPhase::Indexing, 0, ir.size());
+  wait_for_index();
+  report(LoadPhase::Indexing, ir.size(), ir.size());
+
+  report(LoadPhase::TopLevel);
   message() << "Reading types\n";
   for(llvm::StructType* llvm_sty : llvm.getIdentifiedStructTypes()) {
     // TODO: At some point, we'll deal with unnamed struct types
     // but right now, I'm not sure how to get a handle to them in the IR
     if(llvm_sty->hasName()) {
       StructType& sty = StructType::make(llvm_sty, module);
-      Offset pos      = find_and_move(sty.get_tag(), Lookback::Newline, cursor);
-      sty.set_llvm_defn(
-          Definition::make(pos, pos + sty.get_tag().size(), sty, module));
+      Offset pos      = decls.get(sty.get_tag());
+      if(pos == llvm::StringRef::npos) {
+        critical() << "Could not find struct definition: " << sty.get_tag()
+                   << "\n";
+        incomplete = true;
+      } else {
+        module.add_definition(sty, pos, pos + sty.get_tag().size());
+      }
     } else {
       warning() << "Skipping unnamed struct type: " << llvm_sty << "\n";
     }
@@ -342,26 +1270,30 @@ Parser::link(Module& module) {
   message() << "Reading comdats\n";
   for(llvm::Function& f : llvm.functions()) {
     if(llvm::Comdat* llvm_c = f.getComdat()) {
-      Comdat& comdat  = Comdat::make(*llvm_c, f, module);
-      Offset pos = find_and_move(comdat.get_tag(), Lookback::Newline, cursor);
-      if(pos == llvm::StringRef::npos)
+      Comdat& comdat = Comdat::make(*llvm_c, f, module);
+      Offset pos     = decls.get(comdat.get_tag());
+      if(pos == llvm::StringRef::npos) {
         critical() << "Could not find comdat definition: " << comdat.get_tag()
                    << "\n";
-      else
+        incomplete = true;
+      } else {
         comdat.set_self_llvm_defn(
             LLVMRange(pos, pos + comdat.get_tag().size()));
+      }
     }
   }
   for(llvm::GlobalVariable& g : llvm.globals()) {
     if(llvm::Comdat* llvm_c = g.getComdat()) {
-      Comdat& comdat  = Comdat::make(*llvm_c, g, module);
-      Offset pos = find_and_move(comdat.get_tag(), Lookback::Newline, cursor);
-      if(pos == llvm::StringRef::npos)
+      Comdat& comdat = Comdat::make(*llvm_c, g, module);
+      Offset pos     = decls.get(comdat.get_tag());
+      if(pos == llvm::StringRef::npos) {
         critical() << "Could not find comdat definition: " << comdat.get_tag()
                    << "\n";
-      else
+        incomplete = true;
+      } else {
         comdat.set_self_llvm_defn(
             LLVMRange(pos, pos + comdat.get_tag().size()));
+      }
     }
   }
 
@@ -372,16 +1304,15 @@ Parser::link(Module& module) {
     // them in the LLVM IR
     if(llvm_g.hasName()) {
       GlobalVariable& g = GlobalVariable::make(llvm_g, module);
-      Offset pos        = find_and_move(g.get_tag(), Lookback::Newline, cursor);
+      Offset pos        = decls.get(g.get_tag());
       if(pos == llvm::StringRef::npos) {
         critical() << "Could not find global definition: " << g.get_tag()
                    << "\n";
+        incomplete = true;
       } else {
-        Offset end = pos + g.get_tag().size();
-        Definition& def = Definition::make(pos, end, g, module);
-        g.set_llvm_defn(def);
+        module.add_definition(g, pos, pos + g.get_tag().size());
         if(llvm::Comdat* c = llvm_g.getComdat())
-          module.get(*c).set_llvm_defn(def);
+          module.get(*c).set_llvm_defn(g.get_llvm_defn());
       }
 
       // FIXME: Skipping any metadata on global variables because I can't
@@ -396,46 +1327,65 @@ Parser::link(Module& module) {
   message() << "Reading global aliases\n";
   for(llvm::GlobalAlias& llvm_a : llvm.aliases()) {
     GlobalAlias& a = GlobalAlias::make(llvm_a, module);
-    Offset pos     = find_and_move(a.get_tag(), Lookback::Newline, cursor);
-    if(pos == llvm::StringRef::npos)
+    Offset pos     = decls.get(a.get_tag());
+    if(pos == llvm::StringRef::npos) {
       critical() << "Could not find alias definition: " << a.get_tag() << "\n";
-    else
-      a.set_llvm_defn(
-          Definition::make(pos, pos + a.get_tag().size(), a, module));
+      incomplete = true;
+    } else {
+      module.add_definition(a, pos, pos + a.get_tag().size());
+    }
   }
 
   // Do this in two passes because there may be circular references
   message() << "Reading functions\n";
   for(llvm::Function& llvm_f : llvm.functions()) {
-    Function& f            = Function::make(llvm_f, module);
-    llvm::StringRef prefix = llvm_f.size() ? "define" : "declare";
-    Offset pos             = find_function(f.get_tag(), prefix, cursor);
+    Function& f = Function::make(llvm_f, module);
+    Offset pos  = decls.get(f.get_tag());
     if(pos == llvm::StringRef::npos) {
       critical() << "Could not find function definition: " << f.get_tag()
                  << "\n";
+      incomplete = true;
     } else {
-      Offset end = pos + f.get_tag().size();
-      Definition& def = Definition::make(pos, end, f, module);
-      f.set_llvm_defn(def);
+      module.add_definition(f, pos, pos + f.get_tag().size());
       if(llvm::Comdat* c = llvm_f.getComdat())
-        module.get(*c).set_llvm_defn(def);
+        module.get(*c).set_llvm_defn(f.get_llvm_defn());
     }
     for(const llvm::MDNode* md : get_metadata(llvm_f))
       wl.insert(md);
+
+    // Copying the links of a function that hasn't changed is cheap enough
+    // that it is never deferred
+    if(this->previous and llvm_f.size())
+      if(const Function* old = find_unchanged(f))
+        unchanged[&f] = old;
+
+    // The body of a function that is still in the bitcode is only made
+    // once it has been read
+    if(module.fn_linker and llvm_f.size() and f.has_llvm_defn()
+       and not unchanged.count(&f))
+      defer_function(f, module, wl);
+    else if(not llvm_f.isMaterializable())
+      f.make_body();
   }
+  if(this->previous)
+    message() << "Found " << unchanged.size() << " unchanged functions\n";
 
   message() << "Reading metadata\n";
   for(const auto& i : global_slots->MetadataNodes) {
     MDNode& md = MDNode::make(*i.second, i.first, module);
-    buf.clear();
-    ss << md.get_tag() << " =";
-    Offset pos = find_and_move(ss.str(), Lookback::Newline, cursor);
-    if(pos == llvm::StringRef::npos)
+    Offset pos = decls.get_metadata(i.first);
+    if(pos == llvm::StringRef::npos) {
       critical() << "Could not find metadata definition: " << md.get_tag()
                  << "\n";
-    else
-      md.set_llvm_defn(
-          Definition::make(pos, pos + md.get_tag().size(), md, module));
+      incomplete = true;
+    } else {
+      module.add_definition(md, pos, pos + md.get_tag().size());
+    }
+  }
+
+  if(cached and link_cached(module, *cache, state)) {
+    message() << "Done parsing IR\n";
+    return not incomplete;
   }
 
   message() << "Processing global variables\n";
@@ -443,256 +1393,63 @@ Parser::link(Module& module) {
     // The global might not be in the module if it doesn't have a name
     if(module.contains(llvm_g)) {
       GlobalVariable& g = module.get(llvm_g);
-      if(llvm_g.hasInitializer())
-        associate_values(collect_constants(llvm_g.getInitializer(), module),
-                         module,
-                         g.get_llvm_defn().get_end());
-    }
-  }
-
-  message() << "Processing functions\n";
-  for(llvm::Function& llvm_f : llvm.functions()) {
-    // For functions that are declared, we don't even try to do anything
-    if(not llvm_f.size())
-      continue;
-
-    Function& f = module.get(llvm_f);
-    // Reposition the cursor at the function definition because we know that
-    // things will  be closer
-    cursor = f.get_llvm_defn().get_end();
-    local_slots->incorporateFunction(llvm_f);
-    Offset f_begin = find_and_move(llvm::StringRef("{"), Lookback::Any, cursor);
-    for(llvm::Argument& llvm_arg : llvm_f.args()) {
-      Argument& arg = module.get(llvm_arg);
-      if(llvm_arg.hasName())
-        arg.set_tag(llvm_arg.getName(), "%");
-      else
-        arg.set_tag(local_slots->getLocalSlot(&llvm_arg));
-
-      // Not going to try and set a definition for arguments. Currently, LLVM
-      // removes all references to them in the IR. Even defined functions
-      // only have a type and not even a slot representation for the arguments.
-      // Of course, they implicitly show up in the code afterwards which
-      // is really nice! The reasoning is so the IR is smaller. I am not sure
-      // how much smaller the IR becomes as a result of these elisions and how
-      // much of a benefit is derived from it. I really hope it is significant,
-      // otherwise, it's yet another one of those micro-optimizations that
-      // ends up being a pain in the ass for some people.
-    }
-
-    // Iterate over all the basic blocks and instructions and set their tag
-    // first because we can have "forward references" to them in branch and phi
-    // instructions respectively. If we don't assign them a tag first,
-    // we can't link them up correctly
-    for(llvm::BasicBlock& llvm_bb : llvm_f) {
-      BasicBlock& bb = module.get(llvm_bb);
-      if(llvm_bb.hasName())
-        bb.set_tag(llvm_bb.getName(), "%");
-      else
-        bb.set_tag(local_slots->getLocalSlot(&llvm_bb));
-      for(const llvm::Instruction& llvm_inst : llvm_bb) {
-        Instruction& inst = module.get(llvm_inst);
-        if(llvm_inst.hasName())
-          inst.set_tag(llvm_inst.getName(), "%");
-        else if(not llvm_inst.getType()->isVoidTy())
-          inst.set_tag(local_slots->getLocalSlot(&llvm_inst));
-        else if(const auto* call = dyn_cast<llvm::CallInst>(&llvm_inst))
-          if(call->isTailCall())
-            inst.set_tag("tail call");
-          else
-            inst.set_tag("call");
-        else
-          inst.set_tag(llvm_inst.getOpcodeName());
+      if(llvm_g.hasInitializer()) {
+        // Global variables are always printed on a single line
+        Offset begin = g.get_llvm_defn().get_end();
+        Lexer lexer(ir, begin);
+        link_constant(llvm_g.getInitializer(),
+                      module,
+                      lexer,
+                      ir.find('\n', begin),
+                      state);
       }
     }
+  }
 
-    // Now iterate over all the basic blocks and the instructions
-    // We don't have to worry about forward iterations on instructions because
-    // it is incorrect to have an instruction use preceding a definition
-    for(llvm::BasicBlock& llvm_bb : llvm_f) {
-      BasicBlock& bb = module.get(llvm_bb);
-      Instruction* inst_prev = nullptr;
-      for(const llvm::Instruction& llvm_inst : llvm_bb) {
-        Instruction& inst   = module.get(llvm_inst);
-        llvm::StringRef tag = inst.get_tag();
-        buf.clear();
-        ss << tag;
-        if(not llvm_inst.getType()->isVoidTy())
-          ss << " =";
-
-        Offset i_begin = find_and_move(ss.str(), Lookback::Whitespace, cursor);
-        if(llvm_inst.getType()->isVoidTy())
-          inst.set_llvm_defn(Definition::make(i_begin, i_begin, inst, module));
-        else
-          inst.set_llvm_defn(
-              Definition::make(i_begin, i_begin + tag.size(), inst, module));
-
-        // Because we don't want to even try to parse the instruction operands,
-        // everything will have to be text-based matching. To reduce the
-        // possibility of false matches, the operands that have to linked
-        // are first sorted by length and matched from the longest to the
-        // shortest. This way, if a shorter operand which happens to be a
-        // substring of a longer one matches against a previous match, it can
-        // be ignored. This does not care if the instruction is split over
-        // multiple lines.
-        ops.clear();
-        for(const llvm::Value* op : llvm_inst.operand_values())
-          // If the module does not contain the operand, then it is either a
-          // llvm::Metadata (more specifically, llvm::MetadataAsValue) or
-          // an llvm::Constant. Most constants we don't care about, but
-          // we do care about llvm::ConstantExpr because they could contain
-          // references to llvm::Function or llvm::GlobalVariable that we
-          // do care about. As with other instances, we just collect them
-          // all now and process them later
-          if(const auto* i = dyn_cast<llvm::Instruction>(op))
-            ops.push_back(&module.get(*i));
-          else if(const auto* a = dyn_cast<llvm::Argument>(op))
-            ops.push_back(&module.get(*a));
-          else if(const auto* f = dyn_cast<llvm::Function>(op))
-            ops.push_back(&module.get(*f));
-          else if(const auto* g = dyn_cast<llvm::GlobalVariable>(op))
-            ops.push_back(&module.get(*g));
-          else if(const auto* a = dyn_cast<llvm::GlobalAlias>(op))
-            ops.push_back(&module.get(*a));
-          else if(const auto* bb = dyn_cast<llvm::BasicBlock>(op))
-            ops.push_back(&module.get(*bb));
-          else if(const auto* c = dyn_cast<llvm::Constant>(op))
-            collect_constants(c, module, ops);
-          else if(isa<llvm::MetadataAsValue>(op))
-            ;
-          else
-            critical() << "Unexpected instruction operand: " << *op << "\n";
-
-        for(const llvm::MDNode* llvm_md : get_metadata(llvm_inst)) {
-          ops.push_back(&module.get(*llvm_md));
-          // This will be used to collect all the MDNode's seen in function
-          // metadata after which it will get used to get all MDNodes reachable
-          // from it
-          wl.insert(llvm_md);
-        }
-
-        std::map<INavigable*, Offset> mapped
-            = associate_values(std::move(ops), module, i_begin, &inst);
-
-        // Because instructions can span multiple lines, a reasonable way to 
-        // determine the span of an instruction is to wait until the next
-        // instruction in the block is found and assume that it extends till 
-        // the end of the nearest non-empty line prior to the current 
-        // instruction. The last instruction in the basic block will be 
-        // dealt with when the span of the basic block is computed because it 
-        // will be assumed to span till the end of the block
-        if(inst_prev) {
-          Offset end = cursor;
-          while(ir[end] != '\n')
-            end--;
-          inst_prev->set_llvm_span(
-              LLVMRange(inst_prev->get_llvm_defn().get_begin(), end));
-        }
-        inst_prev = &inst;
-      }
-
-      // There isn't a reasonable way to find the start of a basic block
-      // other than by finding the location of the first instruction in it
-      // It might not be safe to rely on the labels being printed as comments
-      // Already, the label for the entry block has been removed from the IR
-      // We don't really have a reasonable place to go to when we go to the
-      // definition of a basic block other than to the start of the first
-      // instruction
-      Offset bb_begin = module.get(llvm_bb.front()).get_llvm_defn().get_begin();
-      bb.set_llvm_defn(Definition::make(bb_begin, bb_begin, bb, module));
-
-      // Similarly, the end of the block is a bit problematic because
-      // instructions can span multiple lines and relying on any particular
-      // representation of the instruction is a bad idea.
-      // If this is not the exit block, once we have the last instruction,
-      // we continue looking for the first blank line because there is always
-      // an empty line between basic blocks (hopefully that won't go away)
-      // If it is the last basic block in the function, then look for the
-      // closing brace because that indicates the end of the function
-      Offset bb_end = llvm::StringRef::npos;
-      if(&llvm_bb != &llvm_f.back()) {
-        bb_end
-            = find_and_move(llvm::StringRef("\n"), Lookback::Newline, cursor);
-      } else {
-        bb_end = find_and_move(llvm::StringRef("}"), Lookback::Newline, cursor);
-        // Move it so the block ends *before* the closing brace. We want the
-        // function to end at the brace. Tiny thing, but still
-        if(bb_end != llvm::StringRef::npos)
-          bb_end -= 1;
-      }
+  // The entities used in the functions that haven't changed are looked up
+  // by their tags
+  if(this->previous) {
+    for(llvm::Function& llvm_f : llvm.functions())
+      top_level[module.get(llvm_f).get_tag()] = &module.get(llvm_f);
+    for(llvm::GlobalVariable& llvm_g : llvm.globals())
+      if(module.contains(llvm_g))
+        top_level[module.get(llvm_g).get_tag()] = &module.get(llvm_g);
+    for(llvm::GlobalAlias& llvm_a : llvm.aliases())
+      top_level[module.get(llvm_a).get_tag()] = &module.get(llvm_a);
+    for(const auto& i : global_slots->MetadataNodes)
+      top_level[module.get(*i.second).get_tag()] = &module.get(*i.second);
+  }
 
-      if(bb_end != llvm::StringRef::npos) {
-        bb.set_llvm_span(LLVMRange(bb_begin, bb_end));
-        if(inst_prev)
-          inst_prev->set_llvm_span(
-              LLVMRange(inst_prev->get_llvm_defn().get_begin(), bb_end));
-      } else {
-        warning() << "Could not compute span for basic block\n";
-      }
-    }
+  message() << "Processing functions\n";
+  link_functions(module, state);
+  merge(state, module);
 
-    Offset f_end = module.get(llvm_f.back()).get_llvm_span().get_end();
-    if(f_end != llvm::StringRef::npos)
-      f.set_llvm_span(LLVMRange(f_begin, f_end + 1));
-    else
-      warning() << "Could not compute span for function: "
-                << f.get_llvm().getName() << "\n";
-  }
+  // The previous module is about to go away
+  this->previous = nullptr;
+  unchanged.clear();
+  top_level.clear();
 
   message() << "Processing metadata\n";
+  report(LoadPhase::Metadata);
   // Add MDNodes reachable from NamedMDNodes
   for(const llvm::NamedMDNode& nmd : llvm.named_metadata())
     for(const llvm::MDNode* md : nmd.operands())
       if(not is_debug_metadata(md))
         wl.insert(md);
 
-  // Expand the number of MDNodes that get used until we reach a fixed point
-  // The DI* nodes should not be navigable, but everything else should
-  std::set<const llvm::MDNode*> seen;
-  for(const llvm::MDNode* md : wl)
-    seen.insert(md);
-  std::set<const llvm::MDNode*> wl2;
-  do {
-    for(const llvm::MDNode* md : wl)
-      for(const llvm::MDOperand& mop : md->operands())
-        if(const auto* op = dyn_cast_or_null<llvm::MDNode>(mop))
-          if(not is_debug_metadata(op))
-            if(seen.insert(op).second)
-              wl2.insert(op);
-    wl = std::move(wl2);
-  } while(wl.size());
+  std::set<const llvm::MDNode*> seen = get_reachable(std::move(wl));
 
-  std::vector<MDNode*> mds;
+  // Linking the operands is deferred until they are needed unless the
+  // module was asked to link everything up front. Either way, it happens
+  // after the uses have been sorted
+  module.md_linker.reset(new MetadataLinker(ir, module));
   for(const llvm::MDNode* md : seen)
-    if(module.contains(*md))
-      mds.push_back(&module.get(*md));
-  sort_by_tag_name(mds);
-  for(MDNode* md : mds) {
-    const llvm::MDNode& llvm_md = md->get_llvm();
-    cursor                      = md->get_llvm_defn().get_end();
-    for(unsigned i = 0; i < llvm_md.getNumOperands(); i++) {
-      if(const auto* mop
-         = dyn_cast_or_null<llvm::MDNode>(llvm_md.getOperand(i))) {
-        MDNode& op = module.get(*mop);
-        buf.clear();
-        ss << op.get_tag();
-        if(i < llvm_md.getNumOperands() - 1)
-          ss << ",";
-        else
-          ss << "}";
-        Offset pos = find_and_move(ss.str(), Lookback::Any, cursor);
-        if(pos != llvm::StringRef::npos)
-          op.add_use(Use::make(pos, pos + op.get_tag().size(), op, module));
-        else
-          warning() << "Could not find metadata operand: " << op.get_tag()
-                    << "\n";
-      }
-    }
-  }
+    if(module.contains(*md) and module.get(*md).has_llvm_defn())
+      module.md_linker->add(module.get(*md));
 
   message() << "Done parsing IR\n";
 
-  return true;
+  return not incomplete;
 }
 
 } // namespace lb
@@ -1,20 +1,38 @@
 #ifndef LLVM_BROWSE_PARSER_H
 #define LLVM_BROWSE_PARSER_H
 
+#include "CanonicalWriter.h"
+#include "DeclarationIndex.h"
+#include "Lexer.h"
+#include "LoadOptions.h"
+#include "RangeTable.h"
+#include "Token.h"
 #include "Typedefs.h"
 
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/AsmParser/SlotMapping.h>
+#include <llvm/Config/llvm-config.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/ModuleSlotTracker.h>
 #include <llvm/Support/MemoryBuffer.h>
 
-#include <map>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace lb {
 
+class Arena;
+class Function;
 class Instruction;
 class INavigable;
+class LinkCache;
 class Module;
 class Value;
 
@@ -22,115 +40,298 @@ class Value;
 // because that would be far more efficient than the current kludgy way of
 // doing things.
 //
-// The parser as it currently is a collection of string search functions
-// that gets used to associate locations in the IR with the various LLVM
-// entities. What this parser does is keep track of a "cursor" position in
-// the IR. As each entity is parsed, the cursor position is adjusted so all
-// the nasty string searches that we do are as efficient as possible.
+// The parser as it currently is a collection of functions that match the
+// tokens in the IR against the LLVM entities to associate locations in the
+// IR with them. The top-level entities are found using an index of the
+// definitions and everything else is found by walking the tokens in order.
 //
 class Parser {
 protected:
-  // When determining the locations for the various entities, we need to look
-  // at the previous character to make sure that we don't have any false
-  // matches
-  enum class Lookback {
-    // Doesn't matter what the previous char is
-    Any,
-
-    // The previous character must be a newline because the string has to match
-    // at the start of a line
-    Newline,
-
-    // Whitespace. This subsumes Newline
-    Whitespace,
-
-    // There should be one or more whitespaces until a newline with
-    // no intervening non-whitespace characters
-    Indent,
+  // Everything that is needed to link the body of a function that cannot be
+  // shared between threads. When functions are linked in parallel, each
+  // thread gets its own. The uses and definitions are created here instead
+  // of directly in the module and the uses are only attached to the values
+  // that they use once all the functions have been linked. This way, nothing
+  // that could be seen by another thread is modified while linking
+  struct LinkState {
+    std::unique_ptr<llvm::ModuleSlotTracker> slots;
+
+    // Scratch space for the tokens in the body of the function being linked.
+    // This is kept around so it doesn't have to be reallocated for every
+    // function
+    std::vector<Token> tokens;
+
+    // Scratch space for the tokens of an instruction or initializer whose
+    // operands are being linked when the function body was not tokenized
+    // and to mark the tokens that have already been matched to an operand
+    std::vector<Token> operands;
+    std::vector<bool> taken;
+
+    // The tags of the locals are saved in an arena that belongs to the
+    // module but is only used by this state while functions are linked
+    Arena& arena;
+    std::vector<RangeTable::Entry> uses;
+    std::vector<RangeTable::Entry> defs;
+    std::set<const llvm::MDNode*> wl;
+
+    LinkState(const llvm::Module& llvm, Arena& arena);
+
+    // The definition is set on the entity right away. Nothing else can see
+    // a local entity until the function has been linked
+    void add_definition(INavigable& defined, Offset begin, Offset end);
   };
 
 protected:
-  std::unique_ptr<llvm::ModuleSlotTracker> local_slots;
   std::unique_ptr<llvm::SlotMapping> global_slots;
   llvm::StringRef ir;
+  DeclarationIndex decls;
+
+  // True if the IR was printed by LLVM instead of being read from the file
+  bool printed;
+
+  // Set when something could not be found in the IR. This may be set by
+  // any of the threads linking functions and by the function linker long
+  // after the module was created
+  std::atomic<bool> incomplete;
+
+  LoadOptions options;
+
+  // This is only created when the module is loaded in canonical mode, in
+  // which case it has the exact offsets of the functions, basic blocks and
+  // instructions in the IR
+  std::unique_ptr<CanonicalWriter> writer;
+
+  // This is only created when the module is loaded lazily and is used to
+  // link the functions as they are needed
+  std::unique_ptr<LinkState> lazy;
+
+  // The declarations are indexed on this thread while LLVM parses the IR.
+  // Neither needs the other, so the scan is almost free
+  std::thread indexer;
+
+  // Serializes the calls to the progress callback when the functions are
+  // being linked by more than one thread
+  std::mutex progress_lock;
+
+  // When a module is reloaded, this is the module that was shown before.
+  // The functions whose text hasn't changed are mapped to the functions in
+  // it so their links can be copied instead of being searched for. The
+  // entities used in those functions are found by their tags. These are
+  // only valid while the module is being linked
+  const Module* previous;
+  llvm::DenseMap<const Function*, const Function*> unchanged;
+  llvm::StringMap<INavigable*> top_level;
 
 protected:
   std::vector<const llvm::MDNode*> get_metadata(const llvm::GlobalObject&);
   std::vector<const llvm::MDNode*> get_metadata(const llvm::Instruction&);
 
-  // Helper function used when assocating values with uses.
-  // Checks if the position has already been associated with another value
-  // in the map
-  bool overlaps(Offset pos, const std::map<INavigable*, Offset>& mapped);
+  // Associate the values with the identifiers in the tokens. The uses are
+  // created in the link state and are only attached to the values when the
+  // state is merged into the module
+  void associate_values(const std::vector<INavigable*>& values,
+                        LinkState& state,
+                        llvm::ArrayRef<Token> tokens);
 
-  // Associate the values with uses starting at the cursor. An optional
-  // instruction argument associates the uses with the parent instruction
-  // if any
-  std::map<INavigable*, Offset>
-  associate_values(std::vector<INavigable*> values,
-                   Module& module,
-                   Offset cursor,
-                   Instruction* inst = nullptr);
-
-  Offset find(llvm::StringRef key,
-              Offset cursor,
-              Lookback prev,
-              bool wrap,
-              std::set<Offset>& seen);
-  Offset find(llvm::StringRef key, Offset cursor, Lookback prev, bool wrap);
+  // Tokenize the IR in the range [begin, end) into the scratch space in the
+  // state. The tokens are only valid until the next call
+  llvm::ArrayRef<Token>
+  tokenize(Offset begin, Offset end, LinkState& state) const;
 
   // This is meant to find the operands of a constant (typically a
   // ConstantArray, ConstantStruct or ConstantExpr) that we want to be able
   // to navigate to. Typically, we are only concerned with the top-level
   // entities like functions or globals, but we expand it to include the
   // global indirect objects as well in case we ever support it.
-  // This will be called when we encounter a ConstantExpr in an instruction
-  // or in the initializer of a global variable. We return a vector instead of
-  // a set because there may be multiple occurences of the same global value
-  // in the operands of the constant and we want to be able to find them all
-  // later so we can hook them up, so duplicates in this case are very much
-  // desired
+  // This will be called when we encounter a ConstantExpr in an instruction.
+  // We return a vector instead of a set because there may be multiple
+  // occurences of the same global value in the operands of the constant and
+  // we want to be able to find them all later so we can hook them up, so
+  // duplicates in this case are very much desired
   void collect_constants(const llvm::Constant* c,
                          Module& module,
                          std::vector<INavigable*>& consts);
-  std::vector<INavigable*> collect_constants(const llvm::Constant* c,
-                                             Module& module);
-
-  // Find the key in the IR. Start searching from the current location of the
-  // cursor and wrap around if necessary. The cursor will be positioned at
-  // the end of first instance of key found in the IR. It is an error if the
-  // key is not found. Returns the offset of the first instance of key
-  //
-  // The idea here is that the entities returned from the llvm::Module
-  // (llvm::StructType, llvm::GlobalVariable, llvm::Function) will be returned
-  // in the order in which they occur in the IR. In that case, using the
-  // cursor as the starting point of the search should reduce the amount of
-  // time spent searching but in the worst case, everything still should
-  // be found. The key should be chosen so that it doesn't return more than
-  // one match as much as possible. If at_start is true, the key is expected
-  // at the start of a line
-  //
-  Offset find_and_move(const std::string& key, Lookback prev, Offset& cursor);
-  Offset find_and_move(llvm::StringRef key, Lookback prev, Offset& cursor);
-  Offset find_function(llvm::StringRef func,
-                       llvm::StringRef prefix,
-                       Offset& cursor,
-                       std::set<Offset>& seen);
-  Offset
-  find_function(llvm::StringRef func, llvm::StringRef prefix, size_t& cursor);
+
+  // Link the global values in a constant with their uses in the IR. This
+  // is used for the initializers of global variables which can be very
+  // large - vtables, dispatch tables, llvm.used and the like - so unlike
+  // collect_constants(), nothing is collected. The lexer must be positioned
+  // at the start of the text of the constant and only the text up to end is
+  // considered
+  void link_constant(const llvm::Constant* c,
+                     Module& module,
+                     Lexer& lexer,
+                     Offset end,
+                     LinkState& state);
+
+  // Link the next occurence of the tag of the value in the text with the
+  // value. The lexer is left just past the occurence
+  void
+  link_next_use(INavigable& v, Lexer& lexer, Offset end, LinkState& state);
+
+  // Find the start of the instruction with the given tag in the tokenized
+  // function body. Instructions always start on a new line, so only the
+  // lines following the token at idx are considered. If the instruction
+  // returns a value, the line must start with the definition of the tag
+  // (%<tag> =). Otherwise, the line must start with the tag which will be
+  // the opcode. On success, idx is moved past the line so the search for the
+  // next instruction begins there
+  Offset find_instruction(llvm::StringRef tag,
+                          bool has_value,
+                          const std::vector<Token>& tokens,
+                          size_t& idx) const;
+
+  // Returns the offset of the opening brace of the body of the function
+  Offset find_function_body(const Function& f) const;
+
+  // Assign tags to the arguments, basic blocks and instructions in the
+  // function
+  void set_local_tags(const llvm::Function& llvm_f,
+                      Module& module,
+                      LinkState& state);
+
+  // Set the definition of the instruction that starts at i_begin
+  void link_instruction(const llvm::Instruction& llvm_inst,
+                        Offset i_begin,
+                        Module& module,
+                        LinkState& state);
+
+  // Associate the operands of the instruction with their uses. The tokens
+  // are those of the text of the instruction following its definition
+  void link_operands(const llvm::Instruction& llvm_inst,
+                     llvm::ArrayRef<Token> tokens,
+                     Module& module,
+                     LinkState& state);
+
+  // Link the instructions and basic blocks in the body of the function
+  // starting at the opening brace f_begin. The first searches for everything
+  // in the tokenized function body. The second uses the offsets that
+  // were recorded when the module was printed in canonical mode
+  void link_body(const llvm::Function& llvm_f,
+                 Offset f_begin,
+                 Module& module,
+                 LinkState& state);
+  void link_body_exact(const llvm::Function& llvm_f,
+                       Offset f_begin,
+                       Module& module,
+                       LinkState& state);
+
+  // Find the function in the previous module with the same name and text
+  // as f. Returns nullptr if there isn't one or if its body was never linked
+  const Function* find_unchanged(const Function& f) const;
+
+  // Copy the links in the body of a function from the same function in the
+  // previous module, shifting them to where the function is now. Returns
+  // false if something used in the function could not be found, in which
+  // case nothing is added to the state
+  bool relink_unchanged(const llvm::Function& llvm_f,
+                        const Function& old,
+                        Module& module,
+                        LinkState& state);
+
+  // Link the arguments, basic blocks and instructions of a defined function.
+  // This only reads from the module, so it is safe to call concurrently for
+  // different functions as long as each thread has its own state
+  void link_function(const llvm::Function& llvm_f,
+                     Module& module,
+                     LinkState& state);
+
+  // Set up a defined function to be linked when it is first needed instead
+  // of now. The metadata attached to its instructions is added to the
+  // worklist
+  void defer_function(Function& f,
+                      Module& module,
+                      std::set<const llvm::MDNode*>& wl);
+
+  // Link all the defined functions in the module, spreading the work across
+  // num_threads threads. The states of all the threads are merged into the
+  // primary state
+  void link_functions(Module& module, LinkState& state);
+
+  // Create the bodies of all the functions and read the links from the
+  // cache. Returns false if the cache could not be used
+  bool link_cached(Module& module, LinkCache& cache, LinkState& state);
+
+  // Move the uses and definitions from the state into the module and attach
+  // the uses to the values
+  void merge(LinkState& state, Module& module);
+
+  // Start indexing the declarations in the IR on the indexer thread and
+  // wait for it to finish. The IR must not change in between
+  void start_indexing();
+  void wait_for_index();
+
+#if LLVM_VERSION_MAJOR >= 13
+  // Get the slot numbers of the metadata nodes as they would be printed
+  void collect_metadata_slots(const llvm::Module& module);
+
+  // Run the pass pipeline in the load options on the module. Returns false
+  // if the pipeline could not be parsed
+  bool run_passes(llvm::Module& module);
+
+  // Print the module into a buffer that will be used as the IR. If the
+  // module is being loaded in canonical mode, the offsets of the entities
+  // are recorded while printing
+  std::unique_ptr<llvm::MemoryBuffer> print(const llvm::Module& module,
+                                            llvm::StringRef name);
+#endif // LLVM_VERSION_MAJOR >= 13
 
 public:
-  Parser();
-  virtual ~Parser() = default;
+  Parser(const LoadOptions& options = LoadOptions());
+  virtual ~Parser();
 
   std::tuple<std::unique_ptr<llvm::Module>, std::unique_ptr<llvm::MemoryBuffer>>
   parse_ir(std::unique_ptr<llvm::MemoryBuffer> in, llvm::LLVMContext& context);
   std::tuple<std::unique_ptr<llvm::Module>, std::unique_ptr<llvm::MemoryBuffer>>
   parse_bc(std::unique_ptr<llvm::MemoryBuffer> in, llvm::LLVMContext& context);
 
+  // Read only the globals, declarations and metadata from the bitcode. The
+  // bodies of the functions are read from the bitcode when they are
+  // materialized, so it must outlive the module
+  std::tuple<std::unique_ptr<llvm::Module>, std::unique_ptr<llvm::MemoryBuffer>>
+  parse_bc_lazily(llvm::MemoryBufferRef in, llvm::LLVMContext& context);
+
   // Associate the entities in the module with appropriate line numbers and
-  // ranges in the text representation of the IR
-  bool link(Module&);
+  // ranges in the text representation of the IR. If a cache with the links
+  // for the module is given, the uses and the definitions in the function
+  // bodies are read from there instead. If a previous version of the module
+  // is given, the links of the functions that haven't changed are copied
+  // from it. Returns false if anything could not be found in the IR
+  bool link(Module&,
+            LinkCache* cache       = nullptr,
+            const Module* previous = nullptr);
+
+  // Link the body of a function that was skipped when the module was
+  // linked lazily. The entities that got new uses are added to touched.
+  // The uses and definitions are added to the module but are not sorted
+  void link_lazily(const llvm::Function& llvm_f,
+                   Module& module,
+                   std::set<INavigable*>& touched);
+
+  // Link the body of a function that has just been read from the bitcode.
+  // The text is what was printed for the function alone and begins at
+  // offset in the IR of the module. The entities that got new uses are
+  // added to touched and the metadata nodes reachable from the function
+  // that are not debug information are added to reachable. The uses and
+  // definitions are added to the module but are not sorted. Returns false
+  // if anything in the function could not be found in the text
+  bool link_read(const llvm::Function& llvm_f,
+                 llvm::StringRef text,
+                 Offset offset,
+                 Module& module,
+                 std::set<INavigable*>& touched,
+                 std::set<const llvm::MDNode*>& reachable);
+
+  // True if the IR being linked was printed by LLVM. Anything in it can be
+  // printed again from the LLVM module exactly as it is
+  bool is_printed() const;
+
+  // False if anything could not be found in the IR, including in the
+  // functions that were linked lazily so far
+  bool is_complete() const;
+
+  // Pass the progress on to the callback in the load options if there is one
+  void report(LoadPhase phase, uint64_t done = 0, uint64_t total = 0);
 };
 
 } // namespace lb
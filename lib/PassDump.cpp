@@ -0,0 +1,310 @@
+#include "PassDump.h"
+#include "DeclarationIndex.h"
+#include "Lexer.h"
+#include "Logging.h"
+#include "Module.h"
+#include "Token.h"
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+
+namespace lb {
+
+// Progress is reported every time this many bytes of the log are scanned
+static constexpr Offset REPORT_INTERVAL = 1 << 24;
+
+PassDump::PassDump(const std::string& file,
+                   std::unique_ptr<llvm::MemoryBuffer> buf) :
+    file(file),
+    buffer(std::move(buf)) {
+  ;
+}
+
+// The headers look like one of these depending on the pass manager and the
+// option used to print them. The new pass manager prints them as comments
+//
+//   *** IR Dump After Instruction Combining (instcombine) ***
+//   ; *** IR Dump After InstCombinePass on foo ***
+//   *** IR Dump After InstCombinePass on foo omitted because no change ***
+//   *** IR Dump At Start ***
+//   *** IR Pass PassManager<Function> on foo ignored ***
+//
+static bool
+is_header(llvm::StringRef line) {
+  line.consume_front("; ");
+  return (line.startswith("*** IR Dump ") or line.startswith("*** IR Pass "))
+         and line.rtrim().endswith("***");
+}
+
+void
+PassDump::add_header(llvm::StringRef line) {
+  llvm::StringRef header = line;
+  header.consume_front("; ");
+  header.consume_front("*** ");
+  header = header.rtrim();
+  header.consume_back("***");
+  header = header.rtrim();
+
+  Snapshot s;
+  s.kind    = SnapshotKind::After;
+  s.module  = false;
+  s.omitted = false;
+  if(header.consume_front("IR Dump At Start"))
+    s.kind = SnapshotKind::Start;
+  else if(header.consume_front("IR Dump Before "))
+    s.kind = SnapshotKind::Before;
+  else if(header.consume_front("IR Dump After "))
+    s.kind = SnapshotKind::After;
+  else if(header.consume_front("IR Pass "))
+    s.omitted = true;
+
+  if(header.consume_back(" omitted because no change")
+     or header.consume_back(" filtered out") or header.consume_back(" ignored")
+     or header.consume_back(" invalidated"))
+    s.omitted = true;
+
+  size_t on = header.rfind(" on ");
+  if(on != llvm::StringRef::npos) {
+    s.pass   = header.substr(0, on);
+    s.target = header.substr(on + 4);
+  } else {
+    s.pass = header;
+  }
+
+  // The IR starts on the line after the header. Where it ends is only known
+  // once the next header is seen
+  Offset next = line.end() - buffer->getBufferStart();
+  s.ir = buffer->getBuffer().substr(next, 0);
+  snapshots.push_back(std::move(s));
+}
+
+void
+PassDump::add_function(llvm::StringRef ir, Offset begin, Offset end) {
+  // The name of the function is the first global on the define line
+  Token tok;
+  Lexer lexer(ir, begin);
+  while(lexer.next(tok) and not tok.is(TokenKind::Line))
+    if(tok.is(TokenKind::Global)) {
+      snapshots.back().functions.push_back(
+          FunctionText{tok.get_text(ir), ir.slice(begin, end)});
+      return;
+    }
+}
+
+void
+PassDump::finish_snapshot(Offset end) {
+  llvm::StringRef log = buffer->getBuffer();
+  Snapshot& s         = snapshots.back();
+  unsigned i          = snapshots.size() - 1;
+
+  s.ir = log.slice(s.ir.data() - log.data(), end);
+  if(s.ir.trim().empty())
+    s.omitted = true;
+  else if(s.ir.ltrim().startswith("; ModuleID"))
+    s.module = true;
+
+  if(s.pass.size())
+    passes[s.pass].push_back(i);
+  for(const FunctionText& f : s.functions)
+    functions[f.tag].push_back(i);
+
+  // A function pass that didn't change anything still belongs with the
+  // other snapshots of the function
+  if(s.functions.empty() and s.target.size() and not s.module
+     and not s.target.contains(' ') and not s.target.startswith("["))
+    functions[("@" + s.target).str()].push_back(i);
+}
+
+void
+PassDump::scan(const LoadProgress& progress) {
+  // Like the declaration index, everything that matters is at the start of
+  // a line, so memchr can do most of the work
+  llvm::StringRef log = buffer->getBuffer();
+  const char* data    = log.data();
+  Offset size         = log.size();
+  Offset line         = 0;
+  Offset reported     = 0;
+  Offset function     = llvm::StringRef::npos;
+  if(progress)
+    progress(LoadPhase::Indexing, 0, size);
+  while(line < size) {
+    const char* nl = static_cast<const char*>(
+        std::memchr(data + line, '\n', size - line));
+    Offset eol  = nl ? nl - data : size;
+    Offset next = nl ? eol + 1 : size;
+    switch(data[line]) {
+    case ';':
+    case '*':
+      if(is_header(log.slice(line, eol))) {
+        if(snapshots.size())
+          finish_snapshot(line);
+        add_header(log.slice(line, eol + (nl ? 1 : 0)));
+        function = llvm::StringRef::npos;
+      }
+      break;
+    case 'd':
+      if(snapshots.size() and log.substr(line).startswith("define "))
+        function = line;
+      break;
+    case '}':
+      if(function != llvm::StringRef::npos) {
+        add_function(log, function, next);
+        function = llvm::StringRef::npos;
+      }
+      break;
+    default:
+      break;
+    }
+    if(progress and (next - reported >= REPORT_INTERVAL)) {
+      progress(LoadPhase::Indexing, next, size);
+      reported = next;
+    }
+    line = next;
+  }
+  if(snapshots.size())
+    finish_snapshot(size);
+  if(progress)
+    progress(LoadPhase::Indexing, size, size);
+}
+
+const std::string&
+PassDump::get_file() const {
+  return file;
+}
+
+llvm::ArrayRef<Snapshot>
+PassDump::get_snapshots() const {
+  return snapshots;
+}
+
+const Snapshot&
+PassDump::get_snapshot(unsigned i) const {
+  return snapshots.at(i);
+}
+
+unsigned
+PassDump::get_num_snapshots() const {
+  return snapshots.size();
+}
+
+llvm::ArrayRef<unsigned>
+PassDump::get_snapshots_for_pass(llvm::StringRef pass) const {
+  auto it = passes.find(pass);
+  if(it != passes.end())
+    return it->second;
+  return llvm::ArrayRef<unsigned>();
+}
+
+llvm::ArrayRef<unsigned>
+PassDump::get_snapshots_for_function(llvm::StringRef tag) const {
+  auto it = functions.find(tag);
+  if(it != functions.end())
+    return it->second;
+  return llvm::ArrayRef<unsigned>();
+}
+
+std::string
+PassDump::get_ir(unsigned i) const {
+  // Start from the most recent dump of the whole module. If the module
+  // wasn't changed by a pass, its IR may not have been printed
+  unsigned base = snapshots.size();
+  for(unsigned j = i + 1; j-- > 0;)
+    if(snapshots[j].module and not snapshots[j].omitted) {
+      base = j;
+      break;
+    }
+  if(base == snapshots.size())
+    return snapshots[i].ir.str();
+
+  llvm::StringMap<llvm::StringRef> latest;
+  for(unsigned j = base + 1; j <= i; j++)
+    for(const FunctionText& f : snapshots[j].functions)
+      latest[f.tag] = f.text;
+  llvm::StringRef ir = snapshots[base].ir;
+  if(latest.empty())
+    return ir.str();
+
+  // Replace the functions in the module with their most recent copies.
+  // Functions that were only declared in the module have their declarations
+  // replaced and any that aren't there at all are added at the end
+  DeclarationIndex index;
+  index.build(ir);
+  std::vector<std::tuple<Offset, Offset, llvm::StringRef>> edits;
+  std::string added;
+  for(const auto& it : latest) {
+    Offset name = index.get(it.first());
+    if(name == llvm::StringRef::npos) {
+      added.append("\n").append(it.second.str());
+      continue;
+    }
+    Offset begin = ir.rfind('\n', name);
+    begin        = begin == llvm::StringRef::npos ? 0 : begin + 1;
+    Offset end   = name;
+    if(ir.substr(begin).startswith("define "))
+      end = index.get_closing_brace(name);
+    end = ir.find('\n', end);
+    end = end == llvm::StringRef::npos ? ir.size() : end + 1;
+    edits.emplace_back(begin, end, it.second);
+  }
+  std::sort(edits.begin(), edits.end());
+
+  std::string out;
+  out.reserve(ir.size() + added.size());
+  Offset pos = 0;
+  for(const auto& edit : edits) {
+    out.append(ir.data() + pos, std::get<0>(edit) - pos);
+    out.append(std::get<2>(edit).data(), std::get<2>(edit).size());
+    if(not std::get<2>(edit).endswith("\n"))
+      out.append("\n");
+    pos = std::get<1>(edit);
+  }
+  out.append(ir.data() + pos, ir.size() - pos);
+  out.append(added);
+
+  return out;
+}
+
+std::unique_ptr<const Module>
+PassDump::load(unsigned i,
+               const LoadOptions& options,
+               const Module* previous) const {
+  const Snapshot& s = get_snapshot(i);
+  message() << "Loading snapshot " << i << ": " << s.pass << "\n";
+  std::string ir = get_ir(i);
+  if(llvm::StringRef(ir).trim().empty()) {
+    error() << "No IR for snapshot " << i << "\n";
+    return nullptr;
+  }
+
+  // There is nothing on disk for the assembled IR, so it is never cached
+  LoadOptions uncached = options;
+  uncached.use_cache   = false;
+  return Module::create(llvm::MemoryBuffer::getMemBufferCopy(ir, file),
+                        uncached,
+                        previous,
+                        nullptr);
+}
+
+std::unique_ptr<const PassDump>
+PassDump::create(const std::string& file, const LoadProgress& progress) {
+  message() << "Opening pass dump\n";
+
+  // The log may be too big to read into memory, so let it be mapped. It
+  // doesn't need to be null-terminated because it is never parsed directly
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> file_or_err
+      = llvm::MemoryBuffer::getFile(file, false, false);
+  if(not file_or_err) {
+    error() << "Could not open file: " << file << "\n";
+    return nullptr;
+  }
+
+  std::unique_ptr<PassDump> dump(
+      new PassDump(file, std::move(file_or_err.get())));
+  dump->scan(progress);
+  message() << "Found " << dump->get_num_snapshots() << " snapshots\n";
+
+  return std::unique_ptr<const PassDump>(dump.release());
+}
+
+} // namespace lb
@@ -0,0 +1,135 @@
+#ifndef LLVM_BROWSE_PASS_DUMP_H
+#define LLVM_BROWSE_PASS_DUMP_H
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LoadOptions.h"
+#include "Typedefs.h"
+
+namespace lb {
+
+class Module;
+
+enum class SnapshotKind {
+  // The IR as it was before the first pass, printed by -print-changed
+  Start,
+  Before,
+  After,
+};
+
+// A copy of a function printed in a snapshot
+struct FunctionText {
+  // The name of the function as it appears in the IR, including the sigil
+  llvm::StringRef tag;
+
+  // From the start of the define line to the end of the closing brace
+  llvm::StringRef text;
+};
+
+// One of the IR dumps printed between passes
+struct Snapshot {
+  SnapshotKind kind;
+  llvm::StringRef pass;
+
+  // What the pass was run on as it was printed in the header. This is
+  // "[module]" for module passes, the name of the function for function
+  // passes and something more descriptive for loop and CGSCC passes. It
+  // will be empty for dumps from the legacy pass manager
+  llvm::StringRef target;
+
+  // The IR that was printed. This is empty if the IR was not printed because
+  // the pass didn't change it
+  llvm::StringRef ir;
+
+  // True if the whole module was printed and not just some functions
+  bool module;
+
+  // True if the IR was not printed because it was the same as in the
+  // previous snapshot or because the pass was filtered out
+  bool omitted;
+
+  std::vector<FunctionText> functions;
+};
+
+// The log written by -print-after-all, -print-before-all or -print-changed.
+// These can be several gigabytes, so the log is mapped into memory and
+// scanned once to find the snapshots, which are just references into the
+// mapped file. None of them are parsed until they are loaded.
+//
+// Function passes only print the functions that they were run on, which
+// cannot be parsed on their own. To load one of those snapshots, the most
+// recent copy of every function is substituted into the most recent dump of
+// the whole module. So snapshots of the same function share all the text
+// that the passes between them did not change. Passing the module that was
+// loaded for the previous snapshot to load() means that only the functions
+// that actually changed are relinked, which is what keeps stepping through
+// the passes interactive. Only the modules that the caller keeps are in
+// memory
+//
+class alignas(ALIGN_OBJ) PassDump {
+protected:
+  std::string file;
+  std::unique_ptr<llvm::MemoryBuffer> buffer;
+  std::vector<Snapshot> snapshots;
+
+  // The indices of the snapshots for each pass and function in the order in
+  // which they appear in the log. Functions are keyed by their tag
+  llvm::StringMap<std::vector<unsigned>> passes;
+  llvm::StringMap<std::vector<unsigned>> functions;
+
+protected:
+  PassDump(const std::string& file, std::unique_ptr<llvm::MemoryBuffer> buf);
+
+  void scan(const LoadProgress& progress);
+  void add_header(llvm::StringRef line);
+  void add_function(llvm::StringRef ir, Offset begin, Offset end);
+  void finish_snapshot(Offset end);
+
+public:
+  PassDump()                = delete;
+  PassDump(const PassDump&) = delete;
+  PassDump(PassDump&&)      = delete;
+  virtual ~PassDump()       = default;
+
+  const std::string& get_file() const;
+  llvm::ArrayRef<Snapshot> get_snapshots() const;
+  const Snapshot& get_snapshot(unsigned i) const;
+  unsigned get_num_snapshots() const;
+
+  // These return an empty list if there are no snapshots for the pass or
+  // function. The function must be given with its sigil
+  llvm::ArrayRef<unsigned> get_snapshots_for_pass(llvm::StringRef pass) const;
+  llvm::ArrayRef<unsigned>
+  get_snapshots_for_function(llvm::StringRef tag) const;
+
+  // The IR of the whole module as it was at the snapshot. This is empty if
+  // there is no dump of the whole module before the snapshot and the
+  // snapshot itself has no IR
+  std::string get_ir(unsigned i) const;
+
+  // Parse and link the IR at the snapshot. If the module loaded for another
+  // snapshot is given, the links of the functions that haven't changed since
+  // are copied from it. It is not changed and must still be freed by the
+  // caller. Returns nullptr if the IR could not be parsed
+  std::unique_ptr<const Module> load(unsigned i,
+                                     const LoadOptions& options = LoadOptions(),
+                                     const Module* previous = nullptr) const;
+
+public:
+  // Returns nullptr if the file could not be opened. The progress, if any, is
+  // reported as LoadPhase::Indexing in bytes
+  static std::unique_ptr<const PassDump>
+  create(const std::string& file,
+         const LoadProgress& progress = LoadProgress());
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_PASS_DUMP_H
@@ -0,0 +1,390 @@
+#include "Project.h"
+#include "Function.h"
+#include "GlobalAlias.h"
+#include "GlobalVariable.h"
+#include "Lexer.h"
+#include "Logging.h"
+#include "Module.h"
+#include "Token.h"
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Object/IRSymtab.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace lb {
+
+Project::Project(const std::vector<std::string>& files,
+                 const LoadOptions& options) :
+    files(files),
+    options(options), modules(files.size()), attempted(files.size(), false) {
+  // Each module is loaded on one thread. There are usually far more modules
+  // than cores, so this keeps everything busy without any of the overhead of
+  // linking the functions of a module in parallel. The progress callback is
+  // not passed on because it may only be called from one thread at a time
+  this->options.num_threads = 1;
+  this->options.progress    = LoadProgress();
+}
+
+template<typename F>
+void
+Project::run(unsigned threads, unsigned size, F f) {
+  if(not threads)
+    threads = std::thread::hardware_concurrency();
+  threads = std::min(std::max(threads, 1U), size);
+
+  std::atomic<unsigned> next(0);
+  auto work = [&]() {
+    for(unsigned j = next++; j < size; j = next++)
+      f(j);
+  };
+  if(threads <= 1) {
+    work();
+  } else {
+    std::vector<std::thread> pool;
+    for(unsigned i = 0; i < threads; i++)
+      pool.emplace_back(work);
+    for(std::thread& t : pool)
+      t.join();
+  }
+}
+
+// Only functions, global variables and aliases can be referenced from other
+// modules
+static const llvm::GlobalValue*
+get_global(const INavigable& n) {
+  if(const auto* f = llvm::dyn_cast<Function>(&n))
+    return &f->get_llvm();
+  else if(const auto* g = llvm::dyn_cast<GlobalVariable>(&n))
+    return &g->get_llvm();
+  else if(const auto* a = llvm::dyn_cast<GlobalAlias>(&n))
+    return &a->get_llvm();
+  return nullptr;
+}
+
+// The subclasses hide INavigable::uses() so that the uses in the bodies of
+// functions that haven't been linked yet are linked first
+template<typename T>
+static void
+append_uses(const T& n, std::vector<Use>& uses) {
+  auto range = n.uses();
+  uses.insert(uses.end(), range.begin(), range.end());
+}
+
+static void
+append_uses(const INavigable& n, std::vector<Use>& uses) {
+  if(const auto* f = llvm::dyn_cast<Function>(&n))
+    append_uses(*f, uses);
+  else if(const auto* g = llvm::dyn_cast<GlobalVariable>(&n))
+    append_uses(*g, uses);
+  else if(const auto* a = llvm::dyn_cast<GlobalAlias>(&n))
+    append_uses(*a, uses);
+  else
+    append_uses<INavigable>(n, uses);
+}
+
+bool
+Project::index_bitcode(llvm::MemoryBufferRef buf, unsigned id) {
+  // The symbol table is written into bitcode files that have a target and is
+  // all that is read here. Like the linker, it treats available_externally
+  // definitions as undefined
+  llvm::Expected<llvm::BitcodeFileContents> bfc
+      = llvm::getBitcodeFileContents(buf);
+  if(not bfc) {
+    llvm::consumeError(bfc.takeError());
+    return false;
+  }
+  llvm::Expected<llvm::irsymtab::FileContents> contents
+      = llvm::irsymtab::readBitcode(*bfc);
+  if(contents) {
+    for(const llvm::irsymtab::Reader::SymbolRef& sym :
+        contents->TheReader.symbols())
+      if(sym.isGlobal() and not sym.isFormatSpecific()
+         and sym.getIRName().size())
+        symbols.add(sym.getIRName(),
+                    SymbolRef{id, nullptr, sym.isWeak() or sym.isCommon()},
+                    not sym.isUndefined());
+    return true;
+  }
+  llvm::consumeError(contents.takeError());
+
+  // Without a symbol table, the globals can still be read without reading
+  // the bodies of any of the functions
+  llvm::LLVMContext context;
+  llvm::Expected<std::unique_ptr<llvm::Module>> module
+      = llvm::getLazyBitcodeModule(buf, context);
+  if(not module) {
+    llvm::consumeError(module.takeError());
+    return false;
+  }
+  for(const llvm::GlobalValue& g : module.get()->global_values())
+    symbols.add(g, id, nullptr);
+
+  return true;
+}
+
+// The name of a global without the sigil and, if it is quoted, without the
+// quotes and escapes
+static std::string
+get_ir_name(llvm::StringRef tag) {
+  tag = tag.drop_front();
+  if(not tag.startswith("\""))
+    return tag.str();
+
+  std::string name;
+  tag = tag.drop_front().drop_back();
+  for(size_t i = 0; i < tag.size(); i++) {
+    if(tag[i] == '\\' and i + 2 < tag.size() and llvm::isHexDigit(tag[i + 1])
+       and llvm::isHexDigit(tag[i + 2])) {
+      name.push_back(llvm::hexFromNibbles(tag[i + 1], tag[i + 2]));
+      i += 2;
+    } else if(tag[i] == '\\' and i + 1 < tag.size() and tag[i + 1] == '\\') {
+      name.push_back('\\');
+      i += 1;
+    } else {
+      name.push_back(tag[i]);
+    }
+  }
+  return name;
+}
+
+bool
+Project::index_ir(llvm::StringRef ir, unsigned id) {
+  // Every function and global is declared at the start of a line. The
+  // linkage is one of the words before the name of a function or between the
+  // equals sign and the global or constant keyword of a variable. Like the
+  // declaration index, memchr does most of the work
+  const char* data = ir.data();
+  Offset size      = ir.size();
+  Offset line      = 0;
+  while(line < size) {
+    const char* nl = static_cast<const char*>(
+        std::memchr(data + line, '\n', size - line));
+    Offset eol    = nl ? nl - data : size;
+    Offset next   = nl ? eol + 1 : size;
+    bool defined  = ir.substr(line).startswith("define ");
+    bool declared = ir.substr(line).startswith("declare ");
+    if(defined or declared or data[line] == '@') {
+      Token name;
+      Lexer lexer(ir, line);
+      while(lexer.next(name) and not name.is(TokenKind::Line)
+            and not name.is(TokenKind::Global))
+        ;
+      if(name.is(TokenKind::Global)) {
+        llvm::StringRef linkage;
+        if(defined or declared) {
+          linkage = ir.slice(line, name.get_begin());
+        } else {
+          linkage = ir.slice(name.get_end(), eol);
+          linkage = linkage.substr(0,
+                                   std::min(linkage.find(" global "),
+                                            linkage.find(" constant ")));
+        }
+
+        llvm::SmallVector<llvm::StringRef, 8> words;
+        linkage.split(words, ' ', -1, false);
+        bool local = false, weak = false, external = declared;
+        bool copy = false;
+        for(llvm::StringRef word : words) {
+          if(word == "private" or word == "internal")
+            local = true;
+          else if(word == "available_externally")
+            copy = true;
+          else if(word == "weak" or word == "weak_odr" or word == "linkonce"
+                  or word == "linkonce_odr" or word == "common")
+            weak = true;
+          else if(word == "external" or word == "extern_weak")
+            external = true;
+        }
+        if(not local)
+          symbols.add(get_ir_name(name.get_text(ir)),
+                      SymbolRef{id, nullptr, weak},
+                      (defined or not external) and not copy);
+      }
+    }
+    line = next;
+  }
+
+  return true;
+}
+
+bool
+Project::index_file(unsigned id) {
+  // Nothing is parsed, so the file doesn't need to be null-terminated and
+  // can be mapped
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> file_or_err
+      = llvm::MemoryBuffer::getFile(files[id], false, false);
+  if(not file_or_err) {
+    error() << "Could not open file: " << files[id] << "\n";
+    return false;
+  }
+
+  llvm::MemoryBufferRef buf = file_or_err.get()->getMemBufferRef();
+  const auto* begin
+      = reinterpret_cast<const unsigned char*>(buf.getBufferStart());
+  const auto* end = reinterpret_cast<const unsigned char*>(buf.getBufferEnd());
+  bool indexed    = llvm::isBitcode(begin, end) ? index_bitcode(buf, id)
+                                                : index_ir(buf.getBuffer(), id);
+  if(not indexed)
+    error() << "Could not index file: " << files[id] << "\n";
+  return indexed;
+}
+
+unsigned
+Project::get_num_files() const {
+  return files.size();
+}
+
+const std::string&
+Project::get_file(unsigned id) const {
+  return files.at(id);
+}
+
+const std::string&
+Project::get_file(const Module& module) const {
+  return files.at(ids.lookup(&module));
+}
+
+const SymbolIndex&
+Project::get_symbols() const {
+  return symbols;
+}
+
+const Module*
+Project::get_module(unsigned id) const {
+  if(not attempted.at(id)) {
+    attempted[id] = true;
+    if((modules[id] = Module::create(files[id], options)))
+      ids[modules[id].get()] = id;
+    else
+      error() << "Could not load module: " << files[id] << "\n";
+  }
+  return modules[id].get();
+}
+
+bool
+Project::is_loaded(unsigned id) const {
+  return modules.at(id).get();
+}
+
+const INavigable*
+Project::resolve(const SymbolRef& ref, llvm::StringRef name) const {
+  if(ref.entity or ref.module == SymbolRef::NO_MODULE)
+    return ref.entity;
+
+  // The symbol was read from the file without loading the module, so it has
+  // to be looked up by name once the module has been loaded
+  const Module* module = get_module(ref.module);
+  if(not module)
+    return nullptr;
+  const llvm::GlobalValue* g = module->get_llvm().getNamedValue(name);
+  if(not g)
+    return nullptr;
+  else if(const auto* f = llvm::dyn_cast<llvm::Function>(g))
+    return &module->get(*f);
+  else if(const auto* v = llvm::dyn_cast<llvm::GlobalVariable>(g))
+    return &module->get(*v);
+  else if(const auto* a = llvm::dyn_cast<llvm::GlobalAlias>(g))
+    return &module->get(*a);
+  return nullptr;
+}
+
+const INavigable*
+Project::get_definition(const INavigable& n) const {
+  const llvm::GlobalValue* g = get_global(n);
+  if(not g or g->hasLocalLinkage())
+    return nullptr;
+  return resolve(symbols.get_definition(g->getName()), g->getName());
+}
+
+std::vector<Use>
+Project::get_uses(const INavigable& n) const {
+  std::vector<Use> uses;
+  const llvm::GlobalValue* g = get_global(n);
+  if(not g or g->hasLocalLinkage()) {
+    append_uses(n, uses);
+    return uses;
+  }
+
+  // The uses of a symbol in a module are the uses of whichever definition or
+  // declaration of it is in that module
+  for(const SymbolRef& defn : symbols.get_definitions(g->getName()))
+    if(const INavigable* entity = resolve(defn, g->getName()))
+      append_uses(*entity, uses);
+  for(const SymbolRef& decl : symbols.get_declarations(g->getName()))
+    if(const INavigable* entity = resolve(decl, g->getName()))
+      append_uses(*entity, uses);
+  return uses;
+}
+
+std::unique_ptr<const Project>
+Project::create(const std::vector<std::string>& files,
+                const LoadOptions& options) {
+  message() << "Loading " << files.size() << " modules\n";
+  std::unique_ptr<Project> project(new Project(files, options));
+
+  // The progress of the project is the number of modules that have been
+  // loaded
+  std::mutex progress_lock;
+  unsigned done = 0;
+  run(options.num_threads, files.size(), [&](unsigned j) {
+    if((project->modules[j] = Module::create(files[j], project->options)))
+      project->symbols.add(*project->modules[j], j);
+    else
+      error() << "Could not load module: " << files[j] << "\n";
+    if(options.progress) {
+      std::lock_guard<std::mutex> lock(progress_lock);
+      options.progress(LoadPhase::Parsing, ++done, files.size());
+    }
+  });
+  project->symbols.finish();
+
+  // The flags are packed into bits, so they can't be set by the threads
+  // loading neighbouring modules
+  project->attempted.assign(files.size(), true);
+  for(unsigned j = 0; j < files.size(); j++)
+    if(project->modules[j])
+      project->ids[project->modules[j].get()] = j;
+  if(project->ids.empty())
+    return nullptr;
+
+  if(options.progress)
+    options.progress(LoadPhase::Done, files.size(), files.size());
+  return std::unique_ptr<const Project>(project.release());
+}
+
+std::unique_ptr<const Project>
+Project::index(const std::vector<std::string>& files,
+               const LoadOptions& options) {
+  message() << "Indexing " << files.size() << " files\n";
+  std::unique_ptr<Project> project(new Project(files, options));
+
+  std::mutex progress_lock;
+  std::atomic<unsigned> indexed(0);
+  unsigned done = 0;
+  run(options.num_threads, files.size(), [&](unsigned j) {
+    if(project->index_file(j))
+      indexed++;
+    if(options.progress) {
+      std::lock_guard<std::mutex> lock(progress_lock);
+      options.progress(LoadPhase::Indexing, ++done, files.size());
+    }
+  });
+  project->symbols.finish();
+  if(not indexed)
+    return nullptr;
+
+  if(options.progress)
+    options.progress(LoadPhase::Done, files.size(), files.size());
+  return std::unique_ptr<const Project>(project.release());
+}
+
+} // namespace lb
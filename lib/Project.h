@@ -0,0 +1,110 @@
+#ifndef LLVM_BROWSE_PROJECT_H
+#define LLVM_BROWSE_PROJECT_H
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LoadOptions.h"
+#include "SymbolIndex.h"
+#include "Typedefs.h"
+
+namespace lb {
+
+class INavigable;
+class Module;
+class Use;
+
+// A set of modules that are browsed together, typically one for each
+// translation unit of a program. The symbols with external linkage in all
+// of them are indexed. That is what lets a declaration in one module lead to
+// the definition in another and the uses of a function be found in all the
+// modules that call it.
+//
+// A project can be created by loading all the modules, in parallel, each
+// with its own context. Or it can be created by only indexing the files, in
+// which case the symbols are read from the symbol table in each bitcode file
+// and from the top-level declarations in each text file. Nothing is parsed
+// or linked until a module is opened, which, for a large build tree, is the
+// difference between seconds and hours. The modules are opened the first
+// time they are needed, so following a declaration to its definition loads
+// only the module that defines it. Finding all the uses of a symbol loads
+// every module that refers to it.
+//
+// Every module is loaded on a single thread. The number of threads in the
+// load options is the number of files that are loaded or indexed at the same
+// time
+//
+class alignas(ALIGN_OBJ) Project {
+protected:
+  std::vector<std::string> files;
+  LoadOptions options;
+  SymbolIndex symbols;
+
+  // The modules that have been loaded indexed by file. A module is nullptr
+  // if it hasn't been loaded yet or could not be loaded
+  mutable std::vector<std::unique_ptr<const Module>> modules;
+  mutable std::vector<bool> attempted;
+
+  // The index of the file from which each module was loaded
+  mutable llvm::DenseMap<const Module*, unsigned> ids;
+
+protected:
+  Project(const std::vector<std::string>& files, const LoadOptions& options);
+
+  bool index_file(unsigned id);
+  bool index_bitcode(llvm::MemoryBufferRef buf, unsigned id);
+  bool index_ir(llvm::StringRef ir, unsigned id);
+  const INavigable* resolve(const SymbolRef& ref, llvm::StringRef name) const;
+
+  template<typename F>
+  static void run(unsigned threads, unsigned size, F f);
+
+public:
+  Project()               = delete;
+  Project(const Project&) = delete;
+  Project(Project&&)      = delete;
+  virtual ~Project()      = default;
+
+  unsigned get_num_files() const;
+  const std::string& get_file(unsigned id) const;
+  const std::string& get_file(const Module& module) const;
+  const SymbolIndex& get_symbols() const;
+
+  // Returns the module in the file, loading it if necessary. This is
+  // nullptr if the module could not be loaded
+  const Module* get_module(unsigned id) const;
+  bool is_loaded(unsigned id) const;
+
+  // The definition of a function, global variable or alias in whichever
+  // module defines it. If the entity is itself a definition, it is returned
+  // unless another module has a strong definition that would be preferred
+  // when linking. Returns nullptr if the symbol is local or is not defined in
+  // any module of the project
+  const INavigable* get_definition(const INavigable& n) const;
+
+  // The uses of the symbol in all the modules of the project. If the entity
+  // has local linkage, these are only its uses in its own module
+  std::vector<Use> get_uses(const INavigable& n) const;
+
+public:
+  // Load all the modules. Returns nullptr only if none of the files could be
+  // loaded
+  static std::unique_ptr<const Project>
+  create(const std::vector<std::string>& files,
+         const LoadOptions& options = LoadOptions());
+
+  // Index the symbols in the files without loading any of the modules.
+  // Returns nullptr only if none of the files could be indexed
+  static std::unique_ptr<const Project>
+  index(const std::vector<std::string>& files,
+        const LoadOptions& options = LoadOptions());
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_PROJECT_H
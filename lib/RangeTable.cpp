@@ -0,0 +1,194 @@
+#include "RangeTable.h"
+
+#include <algorithm>
+
+namespace lb {
+
+constexpr size_t RangeTable::npos;
+
+RangeTable::RangeTable() : wide(false) {
+  ;
+}
+
+size_t
+RangeTable::size() const {
+  return values.size();
+}
+
+Offset
+RangeTable::get_begin(size_t idx) const {
+  return wide ? begins64[idx] : begins32[idx];
+}
+
+Offset
+RangeTable::get_end(size_t idx) const {
+  return wide ? ends64[idx] : ends32[idx];
+}
+
+const INavigable&
+RangeTable::get_value(size_t idx) const {
+  return *values[idx];
+}
+
+template<typename Int>
+size_t
+RangeTable::find(const std::vector<Int>& begins,
+                 const std::vector<Int>& ends,
+                 Offset offset) {
+  if(offset > std::numeric_limits<Int>::max())
+    return npos;
+
+  // The ranges don't overlap, so only those that begin where the last one
+  // that begins at or before the offset does could contain it. There can
+  // be more than one of those because the definition of a basic block is
+  // empty and begins where that of its first instruction does. The
+  // instruction is the one that is wanted. Its definition is at least as
+  // long as that of the block and is added before it
+  auto it = std::upper_bound(begins.begin(), begins.end(), offset);
+  if(it == begins.begin())
+    return npos;
+  size_t idx = std::distance(begins.begin(), it) - 1;
+  for(size_t i = idx; i and begins[i - 1] == begins[idx]; i--)
+    if(ends[i - 1] >= ends[idx])
+      idx = i - 1;
+  if(offset > ends[idx])
+    return npos;
+  return idx;
+}
+
+size_t
+RangeTable::find(Offset offset) const {
+  if(wide)
+    return find(begins64, ends64, offset);
+  return find(begins32, ends32, offset);
+}
+
+size_t
+RangeTable::lower_bound(Offset offset) const {
+  if(wide)
+    return std::distance(
+        begins64.begin(),
+        std::lower_bound(begins64.begin(), begins64.end(), offset));
+  if(offset > std::numeric_limits<uint32_t>::max())
+    return size();
+  return std::distance(
+      begins32.begin(),
+      std::lower_bound(begins32.begin(), begins32.end(), offset));
+}
+
+void
+RangeTable::reset(bool wide, size_t size) {
+  this->wide = wide;
+  begins32.clear();
+  ends32.clear();
+  begins64.clear();
+  ends64.clear();
+  values.clear();
+  if(wide) {
+    begins64.reserve(size);
+    ends64.reserve(size);
+  } else {
+    begins32.reserve(size);
+    ends32.reserve(size);
+  }
+  values.reserve(size);
+}
+
+void
+RangeTable::push_back(Offset begin, Offset end, const INavigable* value) {
+  if(wide) {
+    begins64.push_back(begin);
+    ends64.push_back(end);
+  } else {
+    begins32.push_back(begin);
+    ends32.push_back(end);
+  }
+  values.push_back(value);
+}
+
+void
+RangeTable::assign(std::vector<Entry>& entries) {
+  std::stable_sort(entries.begin(),
+                   entries.end(),
+                   [](const Entry& l, const Entry& r) {
+                     return l.begin < r.begin;
+                   });
+
+  Offset max = 0;
+  for(const Entry& e : entries)
+    max = std::max(max, e.end);
+  reset(max > std::numeric_limits<uint32_t>::max(), entries.size());
+  for(const Entry& e : entries)
+    push_back(e.begin, e.end, e.value);
+}
+
+void
+RangeTable::merge(RangeTable& other) {
+  if(not other.size())
+    return;
+  if(not size()) {
+    swap(other);
+    return;
+  }
+
+  // The merged rows are written to a new table, so both have to be in
+  // memory at once, but only for as long as it takes to merge them
+  RangeTable merged;
+  size_t n = size();
+  size_t m = other.size();
+  merged.reset(wide or other.wide, n + m);
+
+  size_t i = 0;
+  size_t j = 0;
+  while((i < n) or (j < m)) {
+    if((j == m) or ((i < n) and (get_begin(i) <= other.get_begin(j)))) {
+      merged.push_back(get_begin(i), get_end(i), values[i]);
+      i++;
+    } else {
+      merged.push_back(other.get_begin(j), other.get_end(j), other.values[j]);
+      j++;
+    }
+  }
+  swap(merged);
+  other.clear();
+}
+
+void
+RangeTable::move(Offset begin, Offset end, Offset size) {
+  size_t first = lower_bound(begin);
+  size_t last  = lower_bound(end);
+  if((first == last) and (last == this->size()))
+    return;
+
+  // Only the text after the range moves, so the rows keep their order
+  RangeTable moved;
+  Offset max = 0;
+  for(size_t i = last; i < this->size(); i++)
+    max = std::max(max, get_end(i) - end + begin + size);
+  moved.reset(wide or (max > std::numeric_limits<uint32_t>::max()),
+              this->size() - (last - first));
+  for(size_t i = 0; i < first; i++)
+    moved.push_back(get_begin(i), get_end(i), values[i]);
+  for(size_t i = last; i < this->size(); i++)
+    moved.push_back(get_begin(i) - end + begin + size,
+                    get_end(i) - end + begin + size,
+                    values[i]);
+  swap(moved);
+}
+
+void
+RangeTable::swap(RangeTable& other) {
+  std::swap(wide, other.wide);
+  begins32.swap(other.begins32);
+  ends32.swap(other.ends32);
+  begins64.swap(other.begins64);
+  ends64.swap(other.ends64);
+  values.swap(other.values);
+}
+
+void
+RangeTable::clear() {
+  reset(false, 0);
+}
+
+} // namespace lb
@@ -0,0 +1,96 @@
+#ifndef LLVM_BROWSE_RANGE_TABLE_H
+#define LLVM_BROWSE_RANGE_TABLE_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "Typedefs.h"
+
+namespace lb {
+
+class INavigable;
+
+// The uses or definitions of a module sorted by where they begin in the
+// IR. They are not kept as objects. Each one is a row in flat arrays of
+// their beginnings, ends and the entity that is used or defined, and the
+// Use or Definition is only made when it is asked for. Finding the one at
+// an offset is a binary search over the beginnings only, which are packed
+// tightly enough that most of the search stays in the cache even when
+// there are tens of millions of them.
+//
+// The offsets are kept in 32 bits unless one of them doesn't fit
+//
+class alignas(ALIGN_OBJ) RangeTable {
+public:
+  // A row that has been added but not sorted into a table yet
+  struct Entry {
+    Offset begin;
+    Offset end;
+    INavigable* value;
+  };
+
+protected:
+  std::vector<uint32_t> begins32;
+  std::vector<uint32_t> ends32;
+  std::vector<uint64_t> begins64;
+  std::vector<uint64_t> ends64;
+  std::vector<const INavigable*> values;
+  bool wide;
+
+protected:
+  template<typename Int>
+  static size_t find(const std::vector<Int>& begins,
+                     const std::vector<Int>& ends,
+                     Offset offset);
+
+  void reset(bool wide, size_t size);
+  void push_back(Offset begin, Offset end, const INavigable* value);
+  void swap(RangeTable& other);
+
+public:
+  static constexpr size_t npos = ~static_cast<size_t>(0);
+
+public:
+  RangeTable();
+  RangeTable(const RangeTable&) = delete;
+  RangeTable(RangeTable&&)      = delete;
+  virtual ~RangeTable()         = default;
+
+  size_t size() const;
+  Offset get_begin(size_t idx) const;
+  Offset get_end(size_t idx) const;
+  const INavigable& get_value(size_t idx) const;
+
+  // The index of the range containing the offset or npos if there is none.
+  // A range contains both its ends
+  size_t find(Offset offset) const;
+
+  // The index of the first range that begins at or after the offset
+  size_t lower_bound(Offset offset) const;
+
+  // Replace the rows with the entries, which are sorted by their
+  // beginnings first. The sort is stable, so entries that begin at the same
+  // offset stay in the order in which they were added. The entries must not
+  // overlap otherwise
+  void assign(std::vector<Entry>& entries);
+
+  // Move the rows of the other table into this one, keeping them sorted.
+  // The other table is left empty. At the same offset, the rows of this
+  // table come first
+  void merge(RangeTable& other);
+
+  // The text in [begin, end) was replaced with size bytes of other text.
+  // The rows that begin in the range are dropped and those that begin after
+  // it are moved along with the text that follows it
+  void move(Offset begin, Offset end, Offset size);
+
+  // Remove all the rows
+  void clear();
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_RANGE_TABLE_H
@@ -0,0 +1,67 @@
+#include "SourceLocation.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace lb {
+
+static uint16_t
+clamp_column(unsigned column) {
+  return std::min<unsigned>(column, std::numeric_limits<uint16_t>::max());
+}
+
+SourceLocation::SourceLocation() :
+    file(0), begin_line(0), end_line(0), begin_column(0), end_column(0) {
+  ;
+}
+
+SourceLocation::SourceLocation(unsigned file,
+                               unsigned begin_line,
+                               unsigned begin_column) :
+    file(file),
+    begin_line(begin_line),
+    end_line(0),
+    begin_column(clamp_column(begin_column)),
+    end_column(0) {
+  ;
+}
+
+SourceLocation::SourceLocation(unsigned file,
+                               unsigned begin_line,
+                               unsigned begin_column,
+                               unsigned end_line,
+                               unsigned end_column) :
+    file(file),
+    begin_line(begin_line),
+    end_line(end_line),
+    begin_column(clamp_column(begin_column)),
+    end_column(clamp_column(end_column)) {
+  ;
+}
+
+unsigned
+SourceLocation::get_file() const {
+  return file;
+}
+
+unsigned
+SourceLocation::get_begin_line() const {
+  return begin_line;
+}
+
+unsigned
+SourceLocation::get_begin_column() const {
+  return begin_column;
+}
+
+unsigned
+SourceLocation::get_end_line() const {
+  return end_line;
+}
+
+unsigned
+SourceLocation::get_end_column() const {
+  return end_column;
+}
+
+} // namespace lb
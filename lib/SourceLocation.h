@@ -0,0 +1,51 @@
+#ifndef LLVM_BROWSE_SOURCE_LOCATION_H
+#define LLVM_BROWSE_SOURCE_LOCATION_H
+
+#include <stdint.h>
+
+namespace lb {
+
+// A range in a source file as it is kept by the entities. With debug info,
+// almost every instruction has one of these, so it is packed into 16 bytes.
+// The file is an index into the file table of the module, which is the only
+// thing that can turn this into a SourceRange. That is only done when the
+// location is handed out to Python. Columns past what fits are clamped.
+//
+// Unlike most other classes here, this is not aligned to ALIGN_OBJ because
+// it is never handed out as a handle
+//
+class SourceLocation {
+protected:
+  // This is 0 if there is no location. Otherwise, it is one more than the
+  // index of the file in the file table
+  uint32_t file;
+  uint32_t begin_line;
+  uint32_t end_line;
+  uint16_t begin_column;
+  uint16_t end_column;
+
+public:
+  SourceLocation();
+  SourceLocation(unsigned file, unsigned begin_line, unsigned begin_col);
+  SourceLocation(unsigned file,
+                 unsigned begin_line,
+                 unsigned begin_col,
+                 unsigned end_line,
+                 unsigned end_col);
+
+  unsigned get_file() const;
+  unsigned get_begin_line() const;
+  unsigned get_begin_column() const;
+  unsigned get_end_line() const;
+  unsigned get_end_column() const;
+
+  operator bool() const {
+    // The end line and end column are optional, as they are for a
+    // SourceRange
+    return file and (begin_line > 0) and (begin_column > 0);
+  }
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_SOURCE_LOCATION_H
@@ -0,0 +1,33 @@
+#include "StringMemoryBuffer.h"
+
+#include <utility>
+
+namespace lb {
+
+StringMemoryBuffer::StringMemoryBuffer(std::string contents,
+                                       llvm::StringRef name) :
+    contents(std::move(contents)), name(name.str()) {
+  // std::string is always null-terminated, which is what the IR parser
+  // expects of its buffers
+  init(this->contents.data(),
+       this->contents.data() + this->contents.size(),
+       true);
+}
+
+llvm::StringRef
+StringMemoryBuffer::getBufferIdentifier() const {
+  return name;
+}
+
+llvm::MemoryBuffer::BufferKind
+StringMemoryBuffer::getBufferKind() const {
+  return llvm::MemoryBuffer::MemoryBuffer_Malloc;
+}
+
+std::unique_ptr<llvm::MemoryBuffer>
+StringMemoryBuffer::make(std::string contents, llvm::StringRef name) {
+  return std::unique_ptr<llvm::MemoryBuffer>(
+      new StringMemoryBuffer(std::move(contents), name));
+}
+
+} // namespace lb
@@ -0,0 +1,41 @@
+#ifndef LLVM_BROWSE_STRING_MEMORY_BUFFER_H
+#define LLVM_BROWSE_STRING_MEMORY_BUFFER_H
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <memory>
+#include <string>
+
+namespace lb {
+
+// A memory buffer that owns the string that it wraps. This is used when the
+// IR is generated in memory (for instance, when it is printed from a
+// bitcode file) so it can be handed off to the module without having to
+// make a copy of it the way llvm::MemoryBuffer::getMemBufferCopy() would
+//
+class StringMemoryBuffer : public llvm::MemoryBuffer {
+protected:
+  std::string contents;
+  std::string name;
+
+protected:
+  StringMemoryBuffer(std::string contents, llvm::StringRef name);
+
+public:
+  StringMemoryBuffer()                          = delete;
+  StringMemoryBuffer(const StringMemoryBuffer&) = delete;
+  StringMemoryBuffer(StringMemoryBuffer&&)      = delete;
+  virtual ~StringMemoryBuffer()                 = default;
+
+  virtual llvm::StringRef getBufferIdentifier() const override;
+  virtual BufferKind getBufferKind() const override;
+
+public:
+  static std::unique_ptr<llvm::MemoryBuffer> make(std::string contents,
+                                                  llvm::StringRef name);
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_STRING_MEMORY_BUFFER_H
@@ -11,7 +11,7 @@ StructType::StructType(llvm::StructType* llvm, Module& module) :
     IWrapper<llvm::StructType*>(llvm, module) {
 
   if(llvm->hasName())
-    set_tag(llvm->getName(), "%");
+    set_tag(module.get_arena(), llvm->getName(), "%");
   else
     critical() << "Cannot set tag for unnamed struct: " << *get_llvm() << "\n";
 
@@ -76,7 +76,8 @@ StructType::is_artificial() const {
 
 StructType&
 StructType::make(llvm::StructType* llvm_sty, Module& module) {
-  auto* sty = new StructType(llvm_sty, module);
+  void* mem = module.arena.allocate<StructType>();
+  auto* sty = new(mem) StructType(llvm_sty, module);
   module.m_structs.emplace_back(sty);
   module.tmap[llvm_sty] = sty;
 
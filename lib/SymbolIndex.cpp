@@ -0,0 +1,108 @@
+#include "SymbolIndex.h"
+#include "Function.h"
+#include "GlobalAlias.h"
+#include "GlobalVariable.h"
+#include "Module.h"
+
+#include <llvm/ADT/Hashing.h>
+
+#include <algorithm>
+
+namespace lb {
+
+SymbolIndex::Shard&
+SymbolIndex::get_shard(llvm::StringRef name) {
+  return shards[llvm::hash_value(name) % NUM_SHARDS];
+}
+
+const SymbolIndex::Shard&
+SymbolIndex::get_shard(llvm::StringRef name) const {
+  return shards[llvm::hash_value(name) % NUM_SHARDS];
+}
+
+void
+SymbolIndex::add(llvm::StringRef name, const SymbolRef& ref, bool defined) {
+  Shard& shard = get_shard(name);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  Symbol& symbol = shard.symbols[name];
+  if(defined)
+    symbol.defns.push_back(ref);
+  else
+    symbol.decls.push_back(ref);
+}
+
+void
+SymbolIndex::add(const llvm::GlobalValue& g,
+                 unsigned id,
+                 const INavigable* entity) {
+  if(g.hasLocalLinkage())
+    return;
+
+  bool weak = g.hasWeakLinkage() or g.hasLinkOnceLinkage()
+              or g.hasExternalWeakLinkage() or g.hasCommonLinkage();
+  add(g.getName(), SymbolRef{id, entity, weak}, not g.isDeclarationForLinker());
+}
+
+void
+SymbolIndex::add(const Module& module, unsigned id) {
+  for(const Function& f : module.functions())
+    add(f.get_llvm(), id, &f);
+  for(const Function& f : module.decls())
+    add(f.get_llvm(), id, &f);
+  for(const GlobalVariable& g : module.globals())
+    add(g.get_llvm(), id, &g);
+  for(const GlobalAlias& a : module.aliases())
+    add(a.get_llvm(), id, &a);
+}
+
+void
+SymbolIndex::finish() {
+  auto by_module = [](const SymbolRef& l, const SymbolRef& r) {
+    return l.module < r.module;
+  };
+  for(Shard& shard : shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for(auto& it : shard.symbols) {
+      Symbol& symbol = it.second;
+      std::stable_sort(symbol.defns.begin(), symbol.defns.end(), by_module);
+      std::stable_sort(symbol.decls.begin(), symbol.decls.end(), by_module);
+    }
+  }
+}
+
+SymbolRef
+SymbolIndex::get_definition(llvm::StringRef name) const {
+  const Shard& shard = get_shard(name);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.symbols.find(name);
+  if(it == shard.symbols.end() or it->second.defns.empty())
+    return SymbolRef{SymbolRef::NO_MODULE, nullptr, false};
+
+  const std::vector<SymbolRef>& defns = it->second.defns;
+  for(const SymbolRef& defn : defns)
+    if(not defn.weak)
+      return defn;
+  return defns.front();
+}
+
+std::vector<SymbolRef>
+SymbolIndex::get_definitions(llvm::StringRef name) const {
+  const Shard& shard = get_shard(name);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.symbols.find(name);
+  if(it != shard.symbols.end())
+    return it->second.defns;
+  return std::vector<SymbolRef>();
+}
+
+std::vector<SymbolRef>
+SymbolIndex::get_declarations(llvm::StringRef name) const {
+  const Shard& shard = get_shard(name);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.symbols.find(name);
+  if(it != shard.symbols.end())
+    return it->second.decls;
+  return std::vector<SymbolRef>();
+}
+
+} // namespace lb
@@ -0,0 +1,96 @@
+#ifndef LLVM_BROWSE_SYMBOL_INDEX_H
+#define LLVM_BROWSE_SYMBOL_INDEX_H
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+#include "Typedefs.h"
+
+namespace llvm {
+class GlobalValue;
+} // namespace llvm
+
+namespace lb {
+
+class INavigable;
+class Module;
+
+// A definition or declaration of a symbol in one of the modules of a project
+struct SymbolRef {
+  static constexpr unsigned NO_MODULE = ~0U;
+
+  // The index of the file of the module in the project
+  unsigned module;
+
+  // This is nullptr if the symbol was read from the symbol table of the file
+  // without loading the module
+  const INavigable* entity;
+
+  // Weak and linkonce definitions may be replaced by another definition
+  // when the modules are linked, so a strong definition is preferred
+  bool weak;
+};
+
+// An index of the symbols with external linkage in a set of modules. Symbols
+// with local linkage cannot be referenced from other modules, so they are
+// left out. The index is split into shards by the hash of the name, each
+// with its own lock, so modules that are loaded on different threads can add
+// their symbols at the same time without contending for a single lock.
+//
+// Modules may be added in any order. Once they all have been, finish()
+// sorts the definitions and declarations of each symbol by module so that
+// lookups don't depend on which module happened to be loaded first
+//
+class SymbolIndex {
+protected:
+  struct Symbol {
+    std::vector<SymbolRef> defns;
+    std::vector<SymbolRef> decls;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    llvm::StringMap<Symbol> symbols;
+  };
+
+  static constexpr unsigned NUM_SHARDS = 64;
+  std::array<Shard, NUM_SHARDS> shards;
+
+protected:
+  Shard& get_shard(llvm::StringRef name);
+  const Shard& get_shard(llvm::StringRef name) const;
+
+public:
+  SymbolIndex()                   = default;
+  SymbolIndex(const SymbolIndex&) = delete;
+  SymbolIndex(SymbolIndex&&)      = delete;
+  virtual ~SymbolIndex()          = default;
+
+  // Add the functions, global variables and aliases in the module. This may
+  // be called from several threads at once
+  void add(const Module& module, unsigned id);
+
+  // Add a single symbol. This may also be called from several threads
+  void add(llvm::StringRef name, const SymbolRef& ref, bool defined);
+
+  // Add a function, global variable or alias unless it has local linkage.
+  // The entity is nullptr if the module has not been loaded. Definitions
+  // that are available_externally are only copies of a definition in
+  // another module that may be inlined, so they are added as declarations
+  void add(const llvm::GlobalValue& g, unsigned id, const INavigable* entity);
+  void finish();
+
+  // The preferred definition of the symbol. The module will be NO_MODULE if
+  // the symbol is not defined in any module
+  SymbolRef get_definition(llvm::StringRef name) const;
+  std::vector<SymbolRef> get_definitions(llvm::StringRef name) const;
+  std::vector<SymbolRef> get_declarations(llvm::StringRef name) const;
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_SYMBOL_INDEX_H
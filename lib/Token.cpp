@@ -0,0 +1,45 @@
+#include "Token.h"
+
+namespace lb {
+
+Token::Token() : kind(TokenKind::Line), begin(0), end(0) {
+  ;
+}
+
+Token::Token(TokenKind kind, Offset begin, Offset end) :
+    kind(kind), begin(begin), end(end) {
+  ;
+}
+
+TokenKind
+Token::get_kind() const {
+  return kind;
+}
+
+Offset
+Token::get_begin() const {
+  return begin;
+}
+
+Offset
+Token::get_end() const {
+  return end;
+}
+
+bool
+Token::is(TokenKind kind) const {
+  return this->kind == kind;
+}
+
+bool
+Token::is_identifier() const {
+  return is(TokenKind::Local) or is(TokenKind::Global)
+         or is(TokenKind::Metadata) or is(TokenKind::Comdat);
+}
+
+llvm::StringRef
+Token::get_text(llvm::StringRef ir) const {
+  return ir.substr(begin, end - begin);
+}
+
+} // namespace lb
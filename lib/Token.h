@@ -0,0 +1,55 @@
+#ifndef LLVM_BROWSE_TOKEN_H
+#define LLVM_BROWSE_TOKEN_H
+
+#include "Typedefs.h"
+
+#include <llvm/ADT/StringRef.h>
+
+namespace lb {
+
+// These are the only kinds of tokens in the IR that we care about when
+// linking. Everything else (types, opcodes, constants, keywords, comments)
+// is skipped by the lexer
+enum class TokenKind {
+  // The start of a line. The token begins at the first character of the line
+  // and ends at the first non-whitespace character on the line, so it covers
+  // the indentation, if any
+  Line,
+
+  // Identifiers of the form %<name> or %<slot>
+  Local,
+
+  // Identifiers of the form @<name> or @<slot>
+  Global,
+
+  // Identifiers of the form !<name> or !<slot>
+  Metadata,
+
+  // Identifiers of the form $<name>
+  Comdat,
+
+  // An "=" sign
+  Equals,
+};
+
+class Token {
+protected:
+  TokenKind kind;
+  Offset begin;
+  Offset end;
+
+public:
+  Token();
+  Token(TokenKind kind, Offset begin, Offset end);
+
+  TokenKind get_kind() const;
+  Offset get_begin() const;
+  Offset get_end() const;
+  bool is(TokenKind kind) const;
+  bool is_identifier() const;
+  llvm::StringRef get_text(llvm::StringRef ir) const;
+};
+
+} // namespace lb
+
+#endif // LLVM_BROWSE_TOKEN_H
@@ -1,19 +1,9 @@
 #include "Use.h"
-#include "Module.h"
-
-#include <llvm/Support/Casting.h>
-
-using llvm::cast;
-using llvm::dyn_cast;
-using llvm::isa;
 
 namespace lb {
 
-Use::Use(Offset begin,
-         Offset end,
-         const INavigable& used,
-         const Instruction* inst) :
-    range(begin, end), used(used), inst(inst) {
+Use::Use(Offset begin, Offset end, const INavigable& used) :
+    range(begin, end), used(&used) {
   ;
 }
 
@@ -29,24 +19,7 @@ Use::get_end() const {
 
 const INavigable&
 Use::get_used() const {
-  return used;
-}
-
-const Instruction*
-Use::get_instruction() const {
-  return inst;
-}
-
-Use&
-Use::make(Offset begin,
-          Offset end,
-          const INavigable& used,
-          Module& module,
-          const Instruction* inst) {
-  auto* use = new Use(begin, end, used, inst);
-  module.uses.emplace_back(use);
-
-  return *use;
+  return *used;
 }
 
-} // namespace lb
\ No newline at end of file
+} // namespace lb
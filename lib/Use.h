@@ -4,67 +4,53 @@
 #include "LLVMRange.h"
 #include "Typedefs.h"
 
-#include <memory>
-
 namespace lb {
 
 class INavigable;
-class Instruction;
-class Module;
 
 // The use is analogous to an LLVM use but we won't treat it as a wrapper
 // around an LLVM use. Unlike an LLVM use, this has some "source information"
 // associated with it, namely a range of offsets in the LLVM IR that it
 // corresponds to.
 //
+// A large module has tens of millions of uses, so the module doesn't keep
+// them as objects. They are rows in its tables and in the lists of the
+// entities that they use, and a Use is made from those when it is asked
+// for. A use could be present in a few different places:
+//  - As an instruction operand. The instruction is the one whose span
+//    contains the use, which Module::get_instruction_at() will find
+//  - In an llvm::ConstantExpr but these don't have a "definition", so aren't
+//		navigable in which case there isn't much we can do about it
+//  - In an llvm::MDNode. In this case, the MDNode could have uses in a number
+//    of different places including other MDNodes but also in metadata
+//    attached to instructions. We don't care about sorting those out,
+///   so we don't bother with them
+//
 class alignas(ALIGN_OBJ) Use {
 protected:
   // The range in the LLVM IR that this use corresponds to
   lb::LLVMRange range;
 
   // The value at this location in the IR
-  const INavigable& used;
-
-  // The instruction is for when this Use corresponds to an instruction
-  // operand. A use could also be present in two other places:
-  //  - In an llvm::ConstantExpr but these don't have a "definition", so aren't
-  //		navigable in which case there isn't much we can do about it
-  //  - In an llvm::MDNode. In this case, the MDNode could have uses in a number
-  //    of different places including other MDNodes but also in metadata
-  //    attached to instructions. We don't care about sorting those out,
-  ///   so we don't bother with them
-  const Instruction* inst;
-
-protected:
-  Use(Offset begin,
-      Offset end,
-      const INavigable& used,
-      const Instruction* inst = nullptr);
+  const INavigable* used;
 
 public:
-  Use()          = delete;
-  Use(Use&)      = delete;
-  Use(Use&&)     = delete;
-  virtual ~Use() = default;
+  Use(Offset begin, Offset end, const INavigable& used);
+  Use()           = delete;
+  Use(const Use&) = default;
+  ~Use()          = default;
+
+  Use& operator=(const Use&) = default;
 
-  bool has_user() const;
   Offset get_begin() const;
   Offset get_end() const;
   const INavigable& get_used() const;
-  const Instruction* get_instruction() const;
 
   operator bool() const {
     return (range.get_begin() > 0) and (range.get_end() > 0);
   }
-
-public:
-  static Use& make(Offset begin,
-                   Offset end,
-                   const INavigable& used,
-                   Module& module,
-                   const Instruction* inst = nullptr);
 };
 
 } // namespace lb
 
-#endif // LLVM_BROWSE_USE_H
\ No newline at end of file
+#endif // LLVM_BROWSE_USE_H
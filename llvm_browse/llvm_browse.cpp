@@ -5,6 +5,7 @@
 #include "lib/BasicBlock.h"
 #include "lib/Comdat.h"
 #include "lib/Definition.h"
+#include "lib/Document.h"
 #include "lib/Function.h"
 #include "lib/GlobalAlias.h"
 #include "lib/GlobalVariable.h"
@@ -12,6 +13,10 @@
 #include "lib/Logging.h"
 #include "lib/MDNode.h"
 #include "lib/Module.h"
+#include "lib/ModuleDiff.h"
+#include "lib/ModuleLoader.h"
+#include "lib/PassDump.h"
+#include "lib/Project.h"
 #include "lib/StructType.h"
 #include "lib/Use.h"
 
@@ -28,7 +33,8 @@ using llvm::isa;
 // Typedefs
 
 // The tags are added to the Handle to be able to determine the dynamic type
-// of the object from the handle
+// of the object from the handle. Only the module and the entities in it are
+// handles. The objects that hold or compare modules are capsules
 enum class HandleKind {
   Invalid        = 0x0,
   Module         = 0x1,
@@ -162,6 +168,80 @@ get_handle_kind_name(Handle handle) {
   }
 }
 
+// The loaders, diffs, pass dumps and projects are capsules and not handles.
+// There are only ever a few of them, so they don't need to be compared or
+// hashed like the entities, and they would use up the tags that are left.
+// The name of the capsule is checked whenever it is used, so passing the
+// wrong kind of object raises an exception instead of crashing
+template<typename T>
+static const char* get_capsule_name();
+
+template<>
+const char*
+get_capsule_name<lb::ModuleLoader>() {
+  return "llvm_browse.Loader";
+}
+
+template<>
+const char*
+get_capsule_name<lb::ModuleDiff>() {
+  return "llvm_browse.Diff";
+}
+
+template<>
+const char*
+get_capsule_name<lb::PassDump>() {
+  return "llvm_browse.PassDump";
+}
+
+template<>
+const char*
+get_capsule_name<lb::Project>() {
+  return "llvm_browse.Project";
+}
+
+// A freed capsule is renamed so it can't be used again
+static const char* CAPSULE_FREED = "llvm_browse.Freed";
+
+template<typename T>
+static PyObject*
+get_py_capsule(const T& obj) {
+  return PyCapsule_New(const_cast<T*>(&obj), get_capsule_name<T>(), nullptr);
+}
+
+// Returns nullptr and sets the exception if this is not a capsule of the
+// right kind
+template<typename T>
+static T*
+get_container(PyObject* capsule) {
+  return static_cast<T*>(PyCapsule_GetPointer(capsule, get_capsule_name<T>()));
+}
+
+template<typename T>
+static T*
+parse_container(PyObject* args) {
+  PyObject* capsule = nullptr;
+  if(!PyArg_ParseTuple(args, "O", &capsule))
+    return nullptr;
+  return get_container<T>(capsule);
+}
+
+template<typename T>
+static PyObject*
+free_container(PyObject* args) {
+  PyObject* capsule = nullptr;
+  if(!PyArg_ParseTuple(args, "O", &capsule))
+    return nullptr;
+  T* obj = get_container<T>(capsule);
+  if(!obj)
+    return nullptr;
+  delete obj;
+  PyCapsule_SetName(capsule, CAPSULE_FREED);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
 static Handle
 parse_handle(PyObject* args) {
   Handle handle = HANDLE_NULL;
@@ -170,6 +250,76 @@ parse_handle(PyObject* args) {
   return handle;
 }
 
+// The number of threads is parsed as a signed int so that Python ints that
+// are negative or too large are reported instead of wrapping around. 0 is
+// allowed and means as many threads as there are cores
+static bool
+check_num_threads(int num_threads) {
+  if(num_threads < 0) {
+    PyErr_SetString(PyExc_ValueError, "Number of threads cannot be negative");
+    return false;
+  }
+  return true;
+}
+
+// The options with which a module is loaded are always the last arguments
+// of the functions that load one. All of them are optional and they are in
+// the order of the fields of lb::LoadOptions. offset is the number of
+// arguments that come before them, which are parsed by the caller with
+// parse_leading_args()
+static bool
+parse_load_options(PyObject* args,
+                   Py_ssize_t offset,
+                   lb::LoadOptions& options) {
+  int num_threads      = options.num_threads;
+  int canonical        = options.canonical;
+  int eager_metadata   = options.eager_metadata;
+  int lazy_functions   = options.lazy_functions;
+  int use_cache        = options.use_cache;
+  int lazy_bitcode     = options.lazy_bitcode;
+  int virtual_document = options.virtual_document;
+
+  PyObject* rest = PyTuple_GetSlice(args, offset, PyTuple_Size(args));
+  if(!rest)
+    return false;
+  int parsed = PyArg_ParseTuple(rest,
+                                "|ipppppp",
+                                &num_threads,
+                                &canonical,
+                                &eager_metadata,
+                                &lazy_functions,
+                                &use_cache,
+                                &lazy_bitcode,
+                                &virtual_document);
+  Py_DECREF(rest);
+  if(!parsed or !check_num_threads(num_threads))
+    return false;
+
+  options.num_threads      = num_threads;
+  options.canonical        = canonical;
+  options.eager_metadata   = eager_metadata;
+  options.lazy_functions   = lazy_functions;
+  options.use_cache        = use_cache;
+  options.lazy_bitcode     = lazy_bitcode;
+  options.virtual_document = virtual_document;
+  return true;
+}
+
+// Parse the first count arguments, which come before the load options
+template<typename... Args>
+static bool
+parse_leading_args(PyObject* args,
+                   Py_ssize_t count,
+                   const char* format,
+                   Args... out) {
+  PyObject* leading = PyTuple_GetSlice(args, 0, count);
+  if(!leading)
+    return false;
+  int parsed = PyArg_ParseTuple(leading, format, out...);
+  Py_DECREF(leading);
+  return parsed;
+}
+
 static PyStructSequence_Field PySourcePointFields[] = {
     {"line", nullptr},
     {"column", nullptr},
@@ -232,9 +382,9 @@ convert(lb::Offset offset) {
 
 static PyObject*
 convert(llvm::StringRef s) {
-  if(s.size())
-    return PyUnicode_FromString(s.data());
-  return PyUnicode_FromString("");
+  // The string may be a slice of a larger buffer, so it need not be
+  // terminated
+  return PyUnicode_FromStringAndSize(s.data(), s.size());
 }
 
 static PyObject*
@@ -274,6 +424,14 @@ convert(const lb::SourceRange& range) {
   return py;
 }
 
+// The entities only keep compact source locations. They are turned into
+// ranges with the file names from the module when they are handed out
+template<typename T>
+static PyObject*
+convert_source_defn(const T& n) {
+  return convert(n.get_module().get_source_range(n.get_source_defn()));
+}
+
 static PyObject*
 convert(const lb::LLVMRange& range) {
   PyObject* py = Py_None;
@@ -287,16 +445,57 @@ convert(const lb::LLVMRange& range) {
   return py;
 }
 
-static PyObject*
-convert(llvm::iterator_range<lb::INavigable::Iterator> uses) {
+// The module that contains the entity. Every entity is a wrapper, but the
+// wrappers don't have a common base
+static const lb::Module&
+get_module(const lb::INavigable& n) {
+  if(const auto* alias = dyn_cast<lb::GlobalAlias>(&n))
+    return alias->get_module();
+  else if(const auto* arg = dyn_cast<lb::Argument>(&n))
+    return arg->get_module();
+  else if(const auto* bb = dyn_cast<lb::BasicBlock>(&n))
+    return bb->get_module();
+  else if(const auto* comdat = dyn_cast<lb::Comdat>(&n))
+    return comdat->get_module();
+  else if(const auto* f = dyn_cast<lb::Function>(&n))
+    return f->get_module();
+  else if(const auto* g = dyn_cast<lb::GlobalVariable>(&n))
+    return g->get_module();
+  else if(const auto* inst = dyn_cast<lb::Instruction>(&n))
+    return inst->get_module();
+  else if(const auto* md = dyn_cast<lb::MDNode>(&n))
+    return md->get_module();
+  return cast<lb::StructType>(&n)->get_module();
+}
+
+// The uses are not kept as objects in the module, so the ones that are
+// handed out are kept by the module that they are in until it is freed
+static PyObject*
+convert(const std::vector<lb::Use>& uses) {
   PyObject* list = PyList_New(0);
-  for(const lb::Use* use : uses)
-    PyList_Append(list, get_py_handle(*use, HandleKind::Use));
+  for(const lb::Use& use : uses)
+    PyList_Append(list,
+                  get_py_handle(get_module(use.get_used()).keep(use),
+                                HandleKind::Use));
 
   Py_INCREF(list);
   return list;
 }
 
+// Like the uses, the definitions are only kept once they are handed out
+template<typename T>
+static PyObject*
+convert_llvm_defn(const T& n) {
+  if(not n.has_llvm_defn())
+    return get_py_handle();
+
+  const lb::LLVMRange& defn = n.get_llvm_defn();
+  return get_py_handle(
+      n.get_module().keep(
+          lb::Definition(defn.get_begin(), defn.get_end(), n)),
+      HandleKind::Definition);
+}
+
 // PUBLIC methods
 
 // Utils
@@ -374,24 +573,309 @@ is_def(PyObject* self, PyObject* args) {
   return convert(get_handle_kind(parse_handle(args)) == HandleKind::Definition);
 }
 
+// Loader interface
+
+static PyObject*
+loader_create(PyObject* self, PyObject* args) {
+  const char* file = "";
+  lb::LoadOptions options;
+  if(!parse_leading_args(args, 1, "s", &file)
+     or !parse_load_options(args, 1, options))
+    return nullptr;
+
+  // The caller polls the loader for progress instead of passing a callback
+  // because the loader thread cannot call into Python without the GIL. It
+  // is the caller's responsibility to call loader_free() to release it
+  return get_py_capsule(*new lb::ModuleLoader(file, options));
+}
+
+static PyObject*
+loader_reload(PyObject* self, PyObject* args) {
+  Handle handle    = HANDLE_NULL;
+  const char* file = "";
+  lb::LoadOptions options;
+  if(!parse_leading_args(args, 2, "ks", &handle, &file)
+     or !parse_load_options(args, 2, options))
+    return nullptr;
+
+  // The loader takes ownership of the previous module and frees it once the
+  // new one has been loaded, so the caller must not use it after this
+  std::unique_ptr<const lb::Module> previous(
+      &get_object<lb::Module>(handle));
+  return get_py_capsule(
+      *new lb::ModuleLoader(file, options, std::move(previous)));
+}
+
+static PyObject*
+loader_is_done(PyObject* self, PyObject* args) {
+  const auto* loader = parse_container<lb::ModuleLoader>(args);
+  if(!loader)
+    return nullptr;
+  return convert(loader->is_done());
+}
+
+static PyObject*
+loader_get_progress(PyObject* self, PyObject* args) {
+  const auto* loader = parse_container<lb::ModuleLoader>(args);
+  if(!loader)
+    return nullptr;
+  return Py_BuildValue("(sKK)",
+                       lb::ModuleLoader::get_phase_name(loader->get_phase()),
+                       loader->get_progress_done(),
+                       loader->get_progress_total());
+}
+
+static PyObject*
+loader_take_module(PyObject* self, PyObject* args) {
+  auto* loader = parse_container<lb::ModuleLoader>(args);
+  if(!loader)
+    return nullptr;
+  if(const lb::Module* module = loader->take().release())
+    return get_py_handle(*module, HandleKind::Module);
+  return get_py_handle();
+}
+
+static PyObject*
+loader_free(PyObject* self, PyObject* args) {
+  return free_container<lb::ModuleLoader>(args);
+}
+
+// Pass dump interface
+
+static PyObject*
+dump_create(PyObject* self, PyObject* args) {
+  const char* file = "";
+  if(!PyArg_ParseTuple(args, "s", &file))
+    return nullptr;
+
+  // It is the caller's responsibility to call dump_free() to release it
+  if(const lb::PassDump* dump = lb::PassDump::create(file).release())
+    return get_py_capsule(*dump);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject*
+dump_free(PyObject* self, PyObject* args) {
+  return free_container<lb::PassDump>(args);
+}
+
+static const char*
+get_snapshot_kind_name(lb::SnapshotKind kind) {
+  switch(kind) {
+  case lb::SnapshotKind::Start:
+    return "Start";
+  case lb::SnapshotKind::Before:
+    return "Before";
+  case lb::SnapshotKind::After:
+    return "After";
+  }
+  return "<<UNKNOWN>>";
+}
+
+static PyObject*
+dump_get_snapshots(PyObject* self, PyObject* args) {
+  const auto* dump = parse_container<lb::PassDump>(args);
+  if(!dump)
+    return nullptr;
+  PyObject* snapshots = PyList_New(0);
+  for(const lb::Snapshot& s : dump->get_snapshots())
+    PyList_Append(snapshots,
+                  Py_BuildValue("(sNNN)",
+                                get_snapshot_kind_name(s.kind),
+                                convert(s.pass),
+                                convert(s.target),
+                                convert(s.omitted)));
+
+  Py_INCREF(snapshots);
+  return snapshots;
+}
+
+static PyObject*
+convert(llvm::ArrayRef<unsigned> indices) {
+  PyObject* list = PyList_New(0);
+  for(unsigned i : indices)
+    PyList_Append(list, convert(i));
+
+  Py_INCREF(list);
+  return list;
+}
+
+static PyObject*
+dump_get_snapshots_for_pass(PyObject* self, PyObject* args) {
+  PyObject* capsule = nullptr;
+  const char* pass  = "";
+  if(!PyArg_ParseTuple(args, "Os", &capsule, &pass))
+    return nullptr;
+
+  const auto* dump = get_container<lb::PassDump>(capsule);
+  if(!dump)
+    return nullptr;
+  return convert(dump->get_snapshots_for_pass(pass));
+}
+
+static PyObject*
+dump_get_snapshots_for_function(PyObject* self, PyObject* args) {
+  PyObject* capsule = nullptr;
+  const char* tag   = "";
+  if(!PyArg_ParseTuple(args, "Os", &capsule, &tag))
+    return nullptr;
+
+  const auto* dump = get_container<lb::PassDump>(capsule);
+  if(!dump)
+    return nullptr;
+  return convert(dump->get_snapshots_for_function(tag));
+}
+
+static PyObject*
+dump_load(PyObject* self, PyObject* args) {
+  PyObject* capsule = nullptr;
+  unsigned index    = 0;
+  Handle previous   = HANDLE_NULL;
+  lb::LoadOptions options;
+  if(!parse_leading_args(args, 3, "OI|k", &capsule, &index, &previous)
+     or !parse_load_options(args, 3, options))
+    return nullptr;
+
+  const auto* dump = get_container<lb::PassDump>(capsule);
+  if(!dump)
+    return nullptr;
+  if(index >= dump->get_num_snapshots())
+    return get_py_handle();
+
+  // The previous module is only read and must still be freed by the caller,
+  // who also owns the new module
+  const lb::Module* prev = nullptr;
+  if(previous != HANDLE_NULL)
+    prev = &get_object<lb::Module>(previous);
+  if(const lb::Module* module = dump->load(index, options, prev).release())
+    return get_py_handle(*module, HandleKind::Module);
+  return get_py_handle();
+}
+
 // Module interface
 
 static PyObject*
 module_create(PyObject* self, PyObject* args) {
   const char* file = "";
-  if(!PyArg_ParseTuple(args, "s", &file))
+  lb::LoadOptions options;
+  if(!parse_leading_args(args, 1, "s", &file)
+     or !parse_load_options(args, 1, options))
     return nullptr;
 
   // Module::create returns a std::unique_ptr. We don't want the caller to
   // own this, so we just release it from the returned pointer and hand
   // the pointer off to the caller. It is the caller's responsibilty to
   // call lb_module_free() to release the Module
-  return get_py_handle(*lb::Module::create(file).release(), HandleKind::Module);
+  return get_py_handle(*lb::Module::create(file, options).release(),
+                       HandleKind::Module);
+}
+
+static PyObject*
+module_edit(PyObject* self, PyObject* args) {
+  Handle handle    = HANDLE_NULL;
+  lb::Offset begin = 0;
+  lb::Offset end   = 0;
+  const char* text = "";
+  Py_ssize_t len   = 0;
+  lb::LoadOptions options;
+  if(!parse_leading_args(args, 4, "kkks#", &handle, &begin, &end, &text, &len)
+     or !parse_load_options(args, 4, options))
+    return nullptr;
+
+  // The module that was edited is not changed and must still be freed by
+  // the caller. As with module_create, the caller owns the new module
+  const auto& module = get_object<lb::Module>(handle);
+  if(const lb::Module* edited
+     = module.edit(begin, end, llvm::StringRef(text, len), options).release())
+    return get_py_handle(*edited, HandleKind::Module);
+  return get_py_handle();
+}
+
+static PyObject*
+module_run_passes(PyObject* self, PyObject* args) {
+  Handle handle        = HANDLE_NULL;
+  const char* pipeline = "";
+  lb::LoadOptions options;
+  if(!parse_leading_args(args, 2, "ks", &handle, &pipeline)
+     or !parse_load_options(args, 2, options))
+    return nullptr;
+
+  // As with module_edit, the original module must still be freed by the
+  // caller, who also owns the new module
+  const auto& module = get_object<lb::Module>(handle);
+  if(const lb::Module* optimized
+     = module.run_passes(pipeline, options).release())
+    return get_py_handle(*optimized, HandleKind::Module);
+  return get_py_handle();
 }
 
 static PyObject*
 module_get_code(PyObject* self, PyObject* args) {
-  return convert(get_object<lb::Module>(parse_handle(args)).get_code());
+  // The text of a virtual document is assembled just for the caller instead
+  // of being kept in the module the way get_code() would keep it
+  const auto& module           = get_object<lb::Module>(parse_handle(args));
+  const lb::Document& document = module.get_document();
+  if(document.is_virtual())
+    return convert(document.get_text(0, document.get_size()));
+  return convert(module.get_code());
+}
+
+static PyObject*
+module_get_text(PyObject* self, PyObject* args) {
+  Handle handle    = HANDLE_NULL;
+  lb::Offset begin = 0;
+  lb::Offset end   = 0;
+  if(!PyArg_ParseTuple(args, "kkk", &handle, &begin, &end))
+    return nullptr;
+
+  return convert(get_object<lb::Module>(handle).get_text(begin, end));
+}
+
+static PyObject*
+module_get_code_size(PyObject* self, PyObject* args) {
+  return convert(get_object<lb::Module>(parse_handle(args)).get_code_size());
+}
+
+static PyObject*
+module_is_virtual(PyObject* self, PyObject* args) {
+  return convert(
+      get_object<lb::Module>(parse_handle(args)).get_document().is_virtual());
+}
+
+static const char*
+get_fragment_kind_name(lb::FragmentKind kind) {
+  switch(kind) {
+  case lb::FragmentKind::Header:
+    return "Header";
+  case lb::FragmentKind::Global:
+    return "Global";
+  case lb::FragmentKind::Function:
+    return "Function";
+  case lb::FragmentKind::Metadata:
+    return "Metadata";
+  case lb::FragmentKind::Text:
+    return "Text";
+  }
+  return "<<UNKNOWN>>";
+}
+
+static PyObject*
+module_get_fragments(PyObject* self, PyObject* args) {
+  const auto& module  = get_object<lb::Module>(parse_handle(args));
+  PyObject* fragments = PyList_New(0);
+  for(const lb::Fragment& f : module.get_document().get_fragments())
+    PyList_Append(fragments,
+                  Py_BuildValue("(sNNN)",
+                                get_fragment_kind_name(f.kind),
+                                convert(f.begin),
+                                convert(f.end),
+                                f.entity ? get_py_handle(*f.entity)
+                                         : get_py_handle()));
+
+  Py_INCREF(fragments);
+  return fragments;
 }
 
 static PyObject*
@@ -450,6 +934,20 @@ module_get_structs(PyObject* self, PyObject* args) {
   return structs;
 }
 
+static PyObject*
+module_read_body(PyObject* self, PyObject* args) {
+  Handle handle = HANDLE_NULL;
+  Handle func   = HANDLE_NULL;
+  if(!PyArg_ParseTuple(args, "kk", &handle, &func))
+    return nullptr;
+
+  // The body is read into the module itself, so the handles into it stay
+  // valid, but the offsets of everything after the function change
+  const auto& module = get_object<lb::Module>(handle);
+  const auto& f      = get_object<lb::Function>(func);
+  return convert(module.read_body(f));
+}
+
 static PyObject*
 module_free(PyObject* self, PyObject* args) {
   delete &get_object<lb::Module>(parse_handle(args));
@@ -536,6 +1034,331 @@ module_get_instruction_at(PyObject* self, PyObject* args) {
   return get_py_handle();
 }
 
+// Diff interface
+
+template<typename T>
+static PyObject*
+convert(const lb::DiffPair<T>& pair, HandleKind kind) {
+  return Py_BuildValue("(NNs)",
+                       pair.left ? get_py_handle(*pair.left, kind)
+                                 : get_py_handle(),
+                       pair.right ? get_py_handle(*pair.right, kind)
+                                  : get_py_handle(),
+                       lb::ModuleDiff::get_kind_name(pair.kind));
+}
+
+static PyObject*
+diff_create(PyObject* self, PyObject* args) {
+  Handle left          = HANDLE_NULL;
+  Handle right         = HANDLE_NULL;
+  int num_threads      = 1;
+  if(!PyArg_ParseTuple(args, "kk|i", &left, &right, &num_threads)
+     or !check_num_threads(num_threads))
+    return nullptr;
+
+  // The modules must outlive the diff. It is the caller's responsibility to
+  // call diff_free() to release it
+  return get_py_capsule(*new lb::ModuleDiff(get_object<lb::Module>(left),
+                                            get_object<lb::Module>(right),
+                                            num_threads));
+}
+
+static PyObject*
+diff_free(PyObject* self, PyObject* args) {
+  return free_container<lb::ModuleDiff>(args);
+}
+
+static PyObject*
+diff_get_stats(PyObject* self, PyObject* args) {
+  const auto* diff = parse_container<lb::ModuleDiff>(args);
+  if(!diff)
+    return nullptr;
+  return Py_BuildValue("(III)",
+                       diff->get_num_changed(),
+                       diff->get_num_added(),
+                       diff->get_num_removed());
+}
+
+static PyObject*
+diff_get_functions(PyObject* self, PyObject* args) {
+  const auto* diff = parse_container<lb::ModuleDiff>(args);
+  if(!diff)
+    return nullptr;
+  PyObject* functions = PyList_New(0);
+  for(const lb::FunctionDiff& f : diff->functions())
+    PyList_Append(functions,
+                  convert(lb::DiffPair<lb::Function>{f.get_left(),
+                                                     f.get_right(),
+                                                     f.get_kind()},
+                          HandleKind::Function));
+
+  Py_INCREF(functions);
+  return functions;
+}
+
+// Returns nullptr with the exception set if the arguments are wrong and
+// without it if the function is not in either module
+static const lb::FunctionDiff*
+parse_function_diff(PyObject* args) {
+  PyObject* capsule = nullptr;
+  Handle function   = HANDLE_NULL;
+  if(!PyArg_ParseTuple(args, "Ok", &capsule, &function))
+    return nullptr;
+
+  const auto* diff = get_container<lb::ModuleDiff>(capsule);
+  if(!diff)
+    return nullptr;
+  return diff->get_diff(get_object<lb::Function>(function));
+}
+
+static PyObject*
+diff_get_blocks(PyObject* self, PyObject* args) {
+  const lb::FunctionDiff* diff = parse_function_diff(args);
+  if(PyErr_Occurred())
+    return nullptr;
+  PyObject* blocks = PyList_New(0);
+  if(diff)
+    for(const lb::DiffPair<lb::BasicBlock>& pair : diff->blocks())
+      PyList_Append(blocks, convert(pair, HandleKind::BasicBlock));
+
+  Py_INCREF(blocks);
+  return blocks;
+}
+
+static PyObject*
+diff_get_instructions(PyObject* self, PyObject* args) {
+  const lb::FunctionDiff* diff = parse_function_diff(args);
+  if(PyErr_Occurred())
+    return nullptr;
+  PyObject* insts = PyList_New(0);
+  if(diff)
+    for(const lb::DiffPair<lb::Instruction>& pair : diff->instructions())
+      PyList_Append(insts, convert(pair, HandleKind::Instruction));
+
+  Py_INCREF(insts);
+  return insts;
+}
+
+static PyObject*
+diff_is_renamed(PyObject* self, PyObject* args) {
+  const lb::FunctionDiff* diff = parse_function_diff(args);
+  if(PyErr_Occurred())
+    return nullptr;
+  return convert(diff and diff->is_renamed());
+}
+
+static PyObject*
+diff_get_counterpart(PyObject* self, PyObject* args) {
+  PyObject* capsule = nullptr;
+  Handle entity     = HANDLE_NULL;
+  if(!PyArg_ParseTuple(args, "Ok", &capsule, &entity))
+    return nullptr;
+
+  const auto* diff = get_container<lb::ModuleDiff>(capsule);
+  if(!diff)
+    return nullptr;
+  const lb::INavigable* counterpart = nullptr;
+  switch(get_handle_kind(entity)) {
+  case HandleKind::Function:
+    counterpart = diff->get_counterpart(get_object<lb::Function>(entity));
+    break;
+  case HandleKind::BasicBlock:
+    counterpart = diff->get_counterpart(get_object<lb::BasicBlock>(entity));
+    break;
+  case HandleKind::Instruction:
+    counterpart = diff->get_counterpart(get_object<lb::Instruction>(entity));
+    break;
+  default:
+    break;
+  }
+  if(counterpart)
+    return get_py_handle(*counterpart);
+  return get_py_handle();
+}
+
+// Project interface
+
+static const lb::INavigable*
+get_navigable(Handle handle) {
+  switch(get_handle_kind(handle)) {
+  case HandleKind::GlobalAlias:
+    return &get_object<lb::GlobalAlias>(handle);
+  case HandleKind::Argument:
+    return &get_object<lb::Argument>(handle);
+  case HandleKind::BasicBlock:
+    return &get_object<lb::BasicBlock>(handle);
+  case HandleKind::Comdat:
+    return &get_object<lb::Comdat>(handle);
+  case HandleKind::Function:
+    return &get_object<lb::Function>(handle);
+  case HandleKind::GlobalVariable:
+    return &get_object<lb::GlobalVariable>(handle);
+  case HandleKind::Instruction:
+    return &get_object<lb::Instruction>(handle);
+  case HandleKind::MDNode:
+    return &get_object<lb::MDNode>(handle);
+  case HandleKind::StructType:
+    return &get_object<lb::StructType>(handle);
+  default:
+    return nullptr;
+  }
+}
+
+// The arguments of project_create and project_index are the same
+static PyObject*
+project_make(PyObject* args,
+             std::unique_ptr<const lb::Project> (*make)(
+                 const std::vector<std::string>&, const lb::LoadOptions&)) {
+  PyObject* py_files = nullptr;
+  lb::LoadOptions options;
+  if(!parse_leading_args(args, 1, "O", &py_files)
+     or !parse_load_options(args, 1, options))
+    return nullptr;
+
+  PyObject* seq = PySequence_Fast(py_files, "Expected a list of files");
+  if(!seq)
+    return nullptr;
+  std::vector<std::string> files;
+  for(Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+    const char* file = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(seq, i));
+    if(!file) {
+      Py_DECREF(seq);
+      return nullptr;
+    }
+    files.push_back(file);
+  }
+  Py_DECREF(seq);
+
+  // It is the caller's responsibility to call project_free() to release it.
+  // The modules are owned by the project and must not be freed
+  if(std::unique_ptr<const lb::Project> project = make(files, options))
+    return get_py_capsule(*project.release());
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject*
+project_create(PyObject* self, PyObject* args) {
+  return project_make(args, lb::Project::create);
+}
+
+static PyObject*
+project_index(PyObject* self, PyObject* args) {
+  return project_make(args, lb::Project::index);
+}
+
+static PyObject*
+project_free(PyObject* self, PyObject* args) {
+  return free_container<lb::Project>(args);
+}
+
+static PyObject*
+project_get_num_files(PyObject* self, PyObject* args) {
+  const auto* project = parse_container<lb::Project>(args);
+  if(!project)
+    return nullptr;
+  return convert(project->get_num_files());
+}
+
+static const lb::Project*
+parse_project_file(PyObject* args, unsigned& id) {
+  PyObject* capsule = nullptr;
+  if(!PyArg_ParseTuple(args, "OI", &capsule, &id))
+    return nullptr;
+
+  const auto* project = get_container<lb::Project>(capsule);
+  if(project and id >= project->get_num_files()) {
+    PyErr_SetString(PyExc_IndexError, "File index out of range");
+    return nullptr;
+  }
+  return project;
+}
+
+static PyObject*
+project_get_file(PyObject* self, PyObject* args) {
+  unsigned id         = 0;
+  const auto* project = parse_project_file(args, id);
+  if(!project)
+    return nullptr;
+  return convert(project->get_file(id));
+}
+
+static PyObject*
+project_is_loaded(PyObject* self, PyObject* args) {
+  unsigned id         = 0;
+  const auto* project = parse_project_file(args, id);
+  if(!project)
+    return nullptr;
+  return convert(project->is_loaded(id));
+}
+
+static PyObject*
+project_get_module(PyObject* self, PyObject* args) {
+  unsigned id         = 0;
+  const auto* project = parse_project_file(args, id);
+  if(!project)
+    return nullptr;
+  if(const lb::Module* module = project->get_module(id))
+    return get_py_handle(*module, HandleKind::Module);
+  return get_py_handle();
+}
+
+static const lb::Project*
+parse_project_entity(PyObject* args, const lb::INavigable*& n) {
+  PyObject* capsule = nullptr;
+  Handle entity     = HANDLE_NULL;
+  if(!PyArg_ParseTuple(args, "Ok", &capsule, &entity))
+    return nullptr;
+
+  const auto* project = get_container<lb::Project>(capsule);
+  if(project and !(n = get_navigable(entity))) {
+    PyErr_SetString(PyExc_TypeError, "Handle is not an entity");
+    return nullptr;
+  }
+  return project;
+}
+
+static PyObject*
+project_get_definition(PyObject* self, PyObject* args) {
+  const lb::INavigable* n = nullptr;
+  const auto* project     = parse_project_entity(args, n);
+  if(!project)
+    return nullptr;
+
+  // The definition may be in a module that has just been loaded, so the
+  // module is returned along with it
+  if(const lb::INavigable* defn = project->get_definition(*n))
+    return Py_BuildValue(
+        "(NN)",
+        get_py_handle(get_module(*defn), HandleKind::Module),
+        get_py_handle(*defn));
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject*
+project_get_uses(PyObject* self, PyObject* args) {
+  const lb::INavigable* n = nullptr;
+  const auto* project     = parse_project_entity(args, n);
+  if(!project)
+    return nullptr;
+
+  PyObject* uses = PyList_New(0);
+  for(const lb::Use& use : project->get_uses(*n)) {
+    const lb::Module& module = get_module(use.get_used());
+    PyList_Append(uses,
+                  Py_BuildValue("(NN)",
+                                get_py_handle(module, HandleKind::Module),
+                                get_py_handle(module.keep(use),
+                                              HandleKind::Use)));
+  }
+
+  Py_INCREF(uses);
+  return uses;
+}
+
 // Alias interface
 
 static PyObject*
@@ -546,10 +1369,7 @@ alias_has_llvm_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 alias_get_llvm_defn(PyObject* self, PyObject* args) {
-  const auto& alias = get_object<lb::GlobalAlias>(parse_handle(args));
-  if(alias.has_llvm_defn())
-    return get_py_handle(alias.get_llvm_defn(), HandleKind::Definition);
-  return get_py_handle();
+  return convert_llvm_defn(get_object<lb::GlobalAlias>(parse_handle(args)));
 }
 
 static PyObject*
@@ -605,10 +1425,7 @@ arg_has_llvm_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 arg_get_llvm_defn(PyObject* self, PyObject* args) {
-  const auto& arg = get_object<lb::Argument>(parse_handle(args));
-  if(arg.has_llvm_defn())
-    return get_py_handle(arg.get_llvm_defn(), HandleKind::Definition);
-  return get_py_handle();
+  return convert_llvm_defn(get_object<lb::Argument>(parse_handle(args)));
 }
 
 static PyObject*
@@ -624,8 +1441,7 @@ arg_has_source_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 arg_get_source_defn(PyObject* self, PyObject* args) {
-  return convert(
-      get_object<lb::Argument>(parse_handle(args)).get_source_defn());
+  return convert_source_defn(get_object<lb::Argument>(parse_handle(args)));
 }
 
 static PyObject*
@@ -681,10 +1497,7 @@ block_has_llvm_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 block_get_llvm_defn(PyObject* self, PyObject* args) {
-  const auto& bb = get_object<lb::BasicBlock>(parse_handle(args));
-  if(bb.has_llvm_defn())
-    return get_py_handle(bb.get_llvm_defn(), HandleKind::Definition);
-  return get_py_handle();
+  return convert_llvm_defn(get_object<lb::BasicBlock>(parse_handle(args)));
 }
 
 static PyObject*
@@ -701,8 +1514,7 @@ block_has_source_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 block_get_source_defn(PyObject* self, PyObject* args) {
-  return convert(
-      get_object<lb::BasicBlock>(parse_handle(args)).get_source_defn());
+  return convert_source_defn(get_object<lb::BasicBlock>(parse_handle(args)));
 }
 
 static PyObject*
@@ -759,10 +1571,7 @@ comdat_has_llvm_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 comdat_get_llvm_defn(PyObject* self, PyObject* args) {
-  const auto& comdat = get_object<lb::Comdat>(parse_handle(args));
-  if(comdat.has_llvm_defn())
-    return get_py_handle(comdat.get_llvm_defn(), HandleKind::Definition);
-  return get_py_handle();
+  return convert_llvm_defn(get_object<lb::Comdat>(parse_handle(args)));
 }
 
 static PyObject*
@@ -810,10 +1619,7 @@ func_has_llvm_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 func_get_llvm_defn(PyObject* self, PyObject* args) {
-  const auto& f = get_object<lb::Function>(parse_handle(args));
-  if(f.has_llvm_defn())
-    return get_py_handle(f.get_llvm_defn(), HandleKind::Definition);
-  return get_py_handle();
+  return convert_llvm_defn(get_object<lb::Function>(parse_handle(args)));
 }
 
 static PyObject*
@@ -829,8 +1635,7 @@ func_has_source_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 func_get_source_defn(PyObject* self, PyObject* args) {
-  return convert(
-      get_object<lb::Function>(parse_handle(args)).get_source_defn());
+  return convert_source_defn(get_object<lb::Function>(parse_handle(args)));
 }
 
 static PyObject*
@@ -887,6 +1692,11 @@ func_is_artificial(PyObject* self, PyObject* args) {
   return convert(get_object<lb::Function>(parse_handle(args)).is_artificial());
 }
 
+static PyObject*
+func_is_body_read(PyObject* self, PyObject* args) {
+  return convert(get_object<lb::Function>(parse_handle(args)).is_body_read());
+}
+
 static PyObject*
 func_is_mangled(PyObject* self, PyObject* args) {
   return convert(get_object<lb::Function>(parse_handle(args)).is_mangled());
@@ -932,10 +1742,7 @@ global_has_llvm_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 global_get_llvm_defn(PyObject* self, PyObject* args) {
-  const auto& g = get_object<lb::GlobalVariable>(parse_handle(args));
-  if(g.has_llvm_defn())
-    return get_py_handle(g.get_llvm_defn(), HandleKind::Definition);
-  return get_py_handle();
+  return convert_llvm_defn(get_object<lb::GlobalVariable>(parse_handle(args)));
 }
 
 static PyObject*
@@ -952,8 +1759,8 @@ global_has_source_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 global_get_source_defn(PyObject* self, PyObject* args) {
-  return convert(
-      get_object<lb::GlobalVariable>(parse_handle(args)).get_source_defn());
+  return convert_source_defn(
+      get_object<lb::GlobalVariable>(parse_handle(args)));
 }
 
 static PyObject*
@@ -1038,10 +1845,7 @@ inst_has_llvm_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 inst_get_llvm_defn(PyObject* self, PyObject* args) {
-  const auto& inst = get_object<lb::Instruction>(parse_handle(args));
-  if(inst.has_llvm_defn())
-    return get_py_handle(inst.get_llvm_defn(), HandleKind::Definition);
-  return get_py_handle();
+  return convert_llvm_defn(get_object<lb::Instruction>(parse_handle(args)));
 }
 
 static PyObject*
@@ -1058,8 +1862,7 @@ inst_has_source_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 inst_get_source_defn(PyObject* self, PyObject* args) {
-  return convert(
-      get_object<lb::Instruction>(parse_handle(args)).get_source_defn());
+  return convert_source_defn(get_object<lb::Instruction>(parse_handle(args)));
 }
 
 static PyObject*
@@ -1132,10 +1935,7 @@ md_has_llvm_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 md_get_llvm_defn(PyObject* self, PyObject* args) {
-  const auto& md = get_object<lb::MDNode>(parse_handle(args));
-  if(md.has_llvm_defn())
-    return get_py_handle(md.get_llvm_defn(), HandleKind::Definition);
-  return get_py_handle();
+  return convert_llvm_defn(get_object<lb::MDNode>(parse_handle(args)));
 }
 
 static PyObject*
@@ -1183,10 +1983,7 @@ struct_has_llvm_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 struct_get_llvm_defn(PyObject* self, PyObject* args) {
-  const auto& s = get_object<lb::StructType>(parse_handle(args));
-  if(s.has_llvm_defn())
-    return get_py_handle(s.get_llvm_defn(), HandleKind::Definition);
-  return get_py_handle();
+  return convert_llvm_defn(get_object<lb::StructType>(parse_handle(args)));
 }
 
 static PyObject*
@@ -1203,8 +2000,7 @@ struct_has_source_defn(PyObject* self, PyObject* args) {
 
 static PyObject*
 struct_get_source_defn(PyObject* self, PyObject* args) {
-  return convert(
-      get_object<lb::StructType>(parse_handle(args)).get_source_defn());
+  return convert_source_defn(get_object<lb::StructType>(parse_handle(args)));
 }
 
 static PyObject*
@@ -1279,8 +2075,9 @@ use_get_end(PyObject* self, PyObject* args) {
 
 static PyObject*
 use_get_instruction(PyObject* self, PyObject* args) {
-  const auto& use = get_object<lb::Use>(parse_handle(args));
-  if(const lb::Instruction* inst = use.get_instruction())
+  const auto& use          = get_object<lb::Use>(parse_handle(args));
+  const lb::Module& module = get_module(use.get_used());
+  if(const lb::Instruction* inst = module.get_instruction_at(use.get_begin()))
     return get_py_handle(*inst, HandleKind::Instruction);
   return get_py_handle();
 }
@@ -1747,10 +2544,89 @@ static PyMethodDef module_methods[] = {
     FUNC(is_null_handle, "True if the handle is None"),
     FUNC(get_null_handle, "Returns a handle representing None"),
 
+    // Loader interface
+    FUNC(loader_create,
+         "Start loading a module in the background and return the loader. The "
+         "optional arguments are the same as module_create"),
+    FUNC(loader_reload,
+         "Start loading a new version of a module in the background and "
+         "return the loader. The links of the functions that "
+         "haven't changed are copied from the module, which is freed by the "
+         "loader and must not be used after this. The remaining arguments "
+         "are the same as loader_create"),
+    FUNC(loader_is_done, "True if the loader has finished"),
+    FUNC(loader_get_progress,
+         "A tuple of the name of the current phase of the loader and the "
+         "work done and total work in that phase. The total is 0 if unknown"),
+    FUNC(loader_take_module,
+         "Wait for the loader to finish and return a handle to the module "
+         "or HANDLE_NULL if it could not be loaded. The module must be freed "
+         "with module_free"),
+    FUNC(loader_free,
+         "Free a loader created by loader_create or loader_reload"),
+
+    // Pass dump interface
+    FUNC(dump_create,
+         "Index the IR dumps in a log written by -print-after-all, "
+         "-print-before-all or -print-changed and return it or None if the "
+         "file could not be opened"),
+    FUNC(dump_free, "Free a dump created by dump_create"),
+    FUNC(dump_get_snapshots,
+         "A list of (kind, pass, target, omitted) tuples, one for each "
+         "snapshot in the log"),
+    FUNC(dump_get_snapshots_for_pass,
+         "The indices of the snapshots printed after a pass"),
+    FUNC(dump_get_snapshots_for_function,
+         "The indices of the snapshots that contain a function. The name must "
+         "include the sigil"),
+    FUNC(dump_load,
+         "Load the module as it was at a snapshot and return a handle to it or "
+         "HANDLE_NULL if it could not be parsed. If the module loaded for "
+         "another snapshot is given, the functions that haven't changed since "
+         "are not relinked. The remaining optional arguments are the same as "
+         "module_edit"),
+
     // Module interface
-    FUNC(module_create, "Create a new module and return a handle to it"),
+    FUNC(module_create,
+         "Create a new module and return a handle to it. The optional "
+         "arguments are the number of threads to use (0 for all cores), "
+         "whether to show the IR as printed by LLVM with exact offsets, "
+         "whether to link all the metadata when the module is loaded, "
+         "whether to link the function bodies only when they are needed, "
+         "whether to cache the links on disk, whether to read the bodies "
+         "of the functions in a bitcode file only when they are needed and "
+         "whether to drop the IR printed by LLVM once the module is linked "
+         "and print the fragments that are asked for again"),
+    FUNC(module_edit,
+         "Replace the text between two offsets in the body of a function "
+         "and return a handle to the module that results or HANDLE_NULL if "
+         "it could not be parsed. Only the edited function is relinked. The "
+         "original module is not changed. The optional arguments are the "
+         "same as module_create except for the cache"),
+    FUNC(module_run_passes,
+         "Run an opt-style pass pipeline on a copy of the module and return "
+         "a handle to the module that results or HANDLE_NULL if it could not "
+         "be parsed. Functions that the passes do not change are not "
+         "relinked. The original module is not changed. The optional "
+         "arguments are the same as module_edit"),
+    FUNC(module_read_body,
+         "Read the body of a function from the bitcode of a module that was "
+         "loaded lazily into the module. Returns False on failure. The "
+         "handles into the module stay valid, but the offsets of everything "
+         "after the function change, so the text must be fetched again"),
     FUNC(module_free, "Free a module created by module_create"),
     FUNC(module_get_code, "LLVM-IR for the module"),
+    FUNC(module_get_text,
+         "The LLVM-IR between two offsets. If the module is virtual, only "
+         "the fragments in the range are printed"),
+    FUNC(module_get_code_size, "The size of the LLVM-IR for the module"),
+    FUNC(module_is_virtual,
+         "True if the IR is printed again when it is needed instead of being "
+         "kept in memory"),
+    FUNC(module_get_fragments,
+         "A list of (kind, begin, end, handle) tuples, one for each fragment "
+         "of the IR in order. The handle is to the global variable, function "
+         "or metadata node in the fragment or HANDLE_NULL"),
     FUNC(module_get_aliases, "A list of handles to the aliases in the module"),
     FUNC(module_get_comdats, "A list of handles to the comdats in the module"),
     FUNC(module_get_functions,
@@ -1766,6 +2642,60 @@ static PyMethodDef module_methods[] = {
     FUNC(module_get_instruction_at,
          "Gets the instruction at the offset or HANDLE_NULL"),
 
+    // Diff interface
+    FUNC(diff_create,
+         "Compare the functions in two modules. The optional argument is the "
+         "number of threads used to hash the functions (0 for all cores). "
+         "Both modules must outlive the diff"),
+    FUNC(diff_free, "Free a diff created by diff_create"),
+    FUNC(diff_get_stats,
+         "The number of functions that were changed, added and removed"),
+    FUNC(diff_get_functions,
+         "A list of (left, right, kind) tuples for the functions in both "
+         "modules. One of the handles is HANDLE_NULL if the function was "
+         "added or removed"),
+    FUNC(diff_get_blocks,
+         "A list of (left, right, kind) tuples aligning the blocks of a "
+         "function in either module with those of the function it matches"),
+    FUNC(diff_get_instructions,
+         "A list of (left, right, kind) tuples aligning the instructions of "
+         "a function in either module with those of the function it matches"),
+    FUNC(diff_is_renamed,
+         "True if the function was matched by its structure and not by name"),
+    FUNC(diff_get_counterpart,
+         "The function, block or instruction in the other module that "
+         "corresponds to the given one or HANDLE_NULL"),
+
+    // Project interface
+    FUNC(project_create,
+         "Load all the modules in a list of files, each on a single thread, "
+         "and return the project or None if none could be loaded. The "
+         "optional arguments are the same as module_create. The number of "
+         "threads is the number of modules loaded at the same time. The "
+         "modules are owned by the project"),
+    FUNC(project_index,
+         "Index the symbols in a list of files without loading any of the "
+         "modules and return the project or None if none could be indexed. "
+         "The modules are loaded the first time they are needed. The "
+         "arguments are the same as project_create"),
+    FUNC(project_free,
+         "Free a project created by project_create or project_index"),
+    FUNC(project_get_num_files, "The number of files in the project"),
+    FUNC(project_get_file, "The file with the given index"),
+    FUNC(project_is_loaded,
+         "True if the module in the file with the given index has been "
+         "loaded"),
+    FUNC(project_get_module,
+         "The module in the file with the given index, loading it if "
+         "necessary, or HANDLE_NULL if it could not be loaded"),
+    FUNC(project_get_definition,
+         "A tuple of the module and the definition of a function, global "
+         "variable or alias in whichever module defines it or None if it is "
+         "local or not defined in the project"),
+    FUNC(project_get_uses,
+         "A list of (module, use) tuples for the uses of a symbol in all the "
+         "modules of the project"),
+
     // Alias interface
     FUNC(alias_has_llvm_defn, "Check if the alias has an LLVM definition"),
     FUNC(alias_get_llvm_defn, "LLVM definition range of the alias"),
@@ -1843,6 +2773,8 @@ static PyMethodDef module_methods[] = {
     FUNC(func_is_artificial,
          "True if the function was generated by the compiler"),
     FUNC(func_is_mangled, "True if the LLVM name of the function is mangled"),
+    FUNC(func_is_body_read,
+         "False if the body of the function is still in the bitcode"),
     FUNC(func_get_args, "List of handles to the function arguments"),
     FUNC(func_get_blocks,
          "List of handles to the basic blocks in the function"),
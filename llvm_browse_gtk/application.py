@@ -6,11 +6,12 @@ import llvm_browse as lb
 from .options import Options
 from .ui import UI
 import gi
+gi.require_version('Gio', '${PY_GIO_VERSION}')
 gi.require_version('GLib', '${PY_GLIB_VERSION}')
 gi.require_version('GObject', '${PY_GOBJECT_VERSION}')
 gi.require_version('Gtk', '${PY_GTK_VERSION}')
 gi.require_version('GtkSource', '${PY_GTKSOURCE_VERSION}')
-from gi.repository import GLib, GObject, Gtk, GtkSource  # NOQA: E402
+from gi.repository import Gio, GLib, GObject, Gtk, GtkSource  # NOQA: E402
 
 # Not sure why I need to register the GtkSourceView, but best to do it
 # here so we can be sure that it gets registered before anything else
@@ -112,6 +113,16 @@ class Application(Gtk.Application):
         self.options: Options = Options(self)
         self.ui: UI = UI(self)
 
+        # The loader while a module is being loaded in the background. This
+        # is only set between action_open and the module being ready
+        self.loader: object = None
+
+        # Watches the file that is shown if the watch-file option is set.
+        # If the file changes while it is being loaded, it is reloaded again
+        # once the loader is done
+        self.monitor: Gio.FileMonitor = None
+        self.reload_pending: bool = False
+
         # The user has to explicitly set a mark. When one is set, prev-use
         # and next-use will be enabled and the user can navigate this list
         self.marks: List[Tuple[int, int]] = []
@@ -130,11 +141,33 @@ class Application(Gtk.Application):
         self.connect('notify::func', self.on_function_changed)
 
     def _reset(self):
+        # The marks and the current entities are all handles into the module,
+        # which is freed here or, when reloading, by the loader
+        self._clear_handles()
+        if self.monitor:
+            self.monitor.cancel()
+            self.monitor = None
+        self.reload_pending = False
+        if self.loader:
+            lb.loader_free(self.loader)
+            self.loader = None
+            self.ui.do_show_progress('', 0, 0)
         if self.module:
             lb.module_free(self.module)
         self.module = lb.get_null_handle()
         self.llvm = ''
 
+    def _clear_handles(self):
+        self.marks.clear()
+        self.uses_map.clear()
+        self.uses_indexes_map.clear()
+        self.set_mark(lb.get_null_handle())
+        self.entity = lb.get_null_handle()
+        self.inst = lb.get_null_handle()
+        self.func = lb.get_null_handle()
+        self.entity_with_source = lb.get_null_handle()
+        self.entity_with_def = lb.get_null_handle()
+
     def do_activate(self, *args) -> bool:
         self.options.load()
         self.add_window(self.ui.get_application_window())
@@ -145,15 +178,31 @@ class Application(Gtk.Application):
             self.action_open(self.argv.file)
         return False
 
-    # Returns true if the file could be opened
+    # Returns true if the file is being opened. The module is loaded in the
+    # background and the UI is only updated once the module is ready
     def action_open(self, file: str) -> bool:
+        if self.loader:
+            return False
         self.llvm = file
-        self.module = lb.module_create(file)
-        if not self.module:
-            self._reset()
-        else:
-            self.ui.do_open()
-        return bool(self.module)
+        self.loader = lb.loader_create(file, *self._get_load_options())
+        self._watch(file)
+        GLib.timeout_add(100, self.on_loader_poll)
+        return True
+
+    def _get_load_options(self) -> tuple:
+        return (self.options.link_threads,
+                self.options.canonical_llvm,
+                self.options.eager_metadata,
+                self.options.lazy_functions,
+                self.options.link_cache,
+                self.options.lazy_bitcode,
+                self.options.virtual_document)
+
+    def _watch(self, file: str):
+        if self.options.watch_file:
+            self.monitor = Gio.File.new_for_path(file).monitor_file(
+                Gio.FileMonitorFlags.NONE, None)
+            self.monitor.connect('changed', self.on_file_changed)
 
     # Returns true if the file could be closed
     def action_close(self) -> bool:
@@ -162,10 +211,27 @@ class Application(Gtk.Application):
 
     # Returns true if the file could be reloaded
     def action_reload(self) -> bool:
+        if self.loader:
+            self.reload_pending = True
+            return False
         if self.llvm:
             llvm = self.llvm
+            if not self.module:
+                self._reset()
+                return self.action_open(llvm)
+            # Only the functions that have changed are relinked. The rest
+            # are copied from the module that is shown, which is handed over
+            # to the loader and freed by it
+            module = self.module
+            self.module = lb.get_null_handle()
             self._reset()
-            return self.action_open(llvm)
+            self.llvm = llvm
+            self.loader = lb.loader_reload(module,
+                                           llvm,
+                                           *self._get_load_options())
+            self._watch(llvm)
+            GLib.timeout_add(100, self.on_loader_poll)
+            return True
         return False
 
     # Returns true on success. Not sure if this will actually return
@@ -176,13 +242,30 @@ class Application(Gtk.Application):
 
     def action_goto_definition(self) -> bool:
         if self.entity_with_def:
-            defn = lb.entity_get_llvm_defn(self.entity_with_def)
+            entity = self.entity_with_def
+            if lb.is_function(entity) and not lb.func_is_body_read(entity):
+                entity = self._read_body(entity)
+                if not entity:
+                    return False
+            defn = lb.entity_get_llvm_defn(entity)
             offset = lb.def_get_begin(defn)
-            tag = lb.entity_get_tag(self.entity_with_def)
+            tag = lb.entity_get_tag(entity)
             self.ui.do_scroll_llvm_to_offset(offset, len(tag))
             return True
         return False
 
+    # If the module was loaded lazily from bitcode, the body of a function is
+    # read the first time it is navigated to. It is read into the module that
+    # is shown, but the text after it moves, so the marks are dropped and the
+    # text is shown again. Returns the function or a null handle if the body
+    # could not be read
+    def _read_body(self, func: int) -> int:
+        if not lb.module_read_body(self.module, func):
+            return lb.get_null_handle()
+        self._clear_handles()
+        self.ui.do_open()
+        return func
+
     def action_goto_prev_use(self) -> bool:
         if self.marks:
             if self.mark_uses_count:
@@ -289,6 +372,36 @@ class Application(Gtk.Application):
 
         return True
 
+    def on_loader_poll(self) -> bool:
+        # The loader will have been freed if the file was closed while it
+        # was still being loaded
+        if not self.loader:
+            return False
+        if not lb.loader_is_done(self.loader):
+            self.ui.do_show_progress(*lb.loader_get_progress(self.loader))
+            return True
+
+        self.module = lb.loader_take_module(self.loader)
+        lb.loader_free(self.loader)
+        self.loader = None
+        self.ui.do_show_progress('', 0, 0)
+        if not self.module:
+            self._reset()
+        else:
+            self.ui.do_open()
+            if self.reload_pending:
+                self.reload_pending = False
+                self.action_reload()
+        return False
+
+    def on_file_changed(self, monitor: Gio.FileMonitor, file: Gio.File,
+                        other: Gio.File, event: Gio.FileMonitorEvent):
+        # Files that are regenerated are either rewritten in place or
+        # replaced, so wait until the writer is done with it
+        if event in (Gio.FileMonitorEvent.CHANGES_DONE_HINT,
+                     Gio.FileMonitorEvent.CREATED):
+            self.action_reload()
+
     def on_entity_changed(self, *args):
         self.entity_with_def = lb.get_null_handle()
         if self.entity:
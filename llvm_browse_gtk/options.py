@@ -100,6 +100,65 @@ class Options(GObject.GObject):
         nick='max-marks',
         blurb='The maximum number of marks that can be added')
 
+    link_threads = GObject.Property(
+        type=int,
+        default=1,
+        minimum=0,
+        nick='link-threads',
+        blurb=('The number of threads used to link the functions when a '
+               'module is opened. 0 uses all available cores'))
+
+    canonical_llvm = GObject.Property(
+        type=bool,
+        default=False,
+        nick='canonical-llvm',
+        blurb=('Show the LLVM IR as printed by LLVM instead of the contents '
+               'of the file. The IR is linked exactly, without any searching'))
+
+    eager_metadata = GObject.Property(
+        type=bool,
+        default=False,
+        nick='eager-metadata',
+        blurb=('Link the operands of all metadata nodes when a module is '
+               'opened instead of when they are first needed'))
+
+    lazy_functions = GObject.Property(
+        type=bool,
+        default=False,
+        nick='lazy-functions',
+        blurb=('Only link the body of a function when it is first viewed. '
+               'This makes large modules open much faster'))
+
+    lazy_bitcode = GObject.Property(
+        type=bool,
+        default=False,
+        nick='lazy-bitcode',
+        blurb=('Only read the body of a function in a bitcode file when it is '
+               'first navigated to. Very large bitcode files open almost '
+               'immediately and use memory only for what has been viewed'))
+
+    virtual_document = GObject.Property(
+        type=bool,
+        default=False,
+        nick='virtual-document',
+        blurb=('Do not keep a copy of the IR printed by LLVM for a bitcode '
+               'file once it has been linked. Text that is needed again is '
+               'printed from the module'))
+
+    link_cache = GObject.Property(
+        type=bool,
+        default=False,
+        nick='link-cache',
+        blurb=('Save the links to a cache on disk and use them the next '
+               'time the same file is opened'))
+
+    watch_file = GObject.Property(
+        type=bool,
+        default=False,
+        nick='watch-file',
+        blurb=('Reload the file when it changes on disk. Only the functions '
+               'that have changed are relinked'))
+
     @classmethod
     def get_properties(cls) -> List[GObject.Property]:
         return [p for p in cls.__dict__.values()
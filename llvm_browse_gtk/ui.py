@@ -380,6 +380,16 @@ class UI(GObject.GObject):
 
         self.trvw_contents.set_model(self.trsrt_contents)
 
+    def do_show_progress(self, phase: str, done: int, total: int):
+        sbar = self['sbar_main']
+        context = sbar.get_context_id('progress')
+        sbar.remove_all(context)
+        if phase:
+            if total:
+                sbar.push(context, '{}: {}%'.format(phase, done * 100 // total))
+            else:
+                sbar.push(context, '{}...'.format(phase))
+
     def do_open(self):
         self['lbl_llvm_filename'].set_text(self.app.llvm)
         self.srcbuf_llvm.set_text(lb.module_get_code(self.app.module))
@@ -485,8 +495,6 @@ class UI(GObject.GObject):
         response = dlg.run()
         dlg.hide()
         if response == Gtk.ResponseType.OK:
-            # FIXME: Do this in a separate thread instead of blocking the
-            # UI by doing this here
             self.app.action_open(dlg.get_filename())
         return False
 
@@ -496,8 +504,6 @@ class UI(GObject.GObject):
         return False
 
     def on_reload(self, *args) -> bool:
-        # FIXME: Do this in a separate thread instead of blocking the UI
-        # by doing this
         self.app.action_reload()
         return False
 
@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+
+import sys
+from typing import Tuple
+import llvm_browse as lb
+
+# The positional load options of module_create in order
+OPTIONS = ('num_threads', 'canonical', 'eager_metadata', 'lazy_functions',
+           'use_cache', 'lazy_bitcode', 'virtual_document')
+
+
+def load(path: str, **kwargs) -> int:
+    args = [kwargs.pop(name, 0 if name == 'num_threads' else False)
+            for name in OPTIONS]
+    assert not kwargs, 'Unknown options: {}'.format(', '.join(kwargs))
+    module = lb.module_create(path, *args)
+    check(not lb.is_null_handle(module), 'Could not load {}'.format(path))
+    return module
+
+
+def check(cond: bool, message: str):
+    if not cond:
+        print('FAIL: {}'.format(message))
+        sys.exit(1)
+
+
+# Check that the text of every use and definition in the module is the tag
+# of the entity that is used or defined. Returns the number of uses and the
+# number of definitions
+def check_links(module: int, name: str) -> Tuple[int, int]:
+    code = lb.module_get_code(module)
+    check(len(code) == lb.module_get_code_size(module),
+          '{}: size of code'.format(name))
+    uses = set()
+    defs = set()
+    for offset in range(len(code) + 1):
+        use = lb.module_get_use_at(module, offset)
+        if not lb.is_null_handle(use):
+            used = lb.use_get_used(use)
+            begin, end = lb.use_get_begin(use), lb.use_get_end(use)
+            check(code[begin:end] == lb.entity_get_tag(used),
+                  '{}: use at {} is {!r}, not {}'.format(
+                      name, begin, code[begin:end],
+                      lb.entity_get_tag(used)))
+            check(use in lb.entity_get_uses(used),
+                  '{}: use at {} is not a use of its entity'.format(
+                      name, begin))
+            uses.add(begin)
+        defn = lb.module_get_def_at(module, offset)
+        if not lb.is_null_handle(defn):
+            defined = lb.def_get_defined(defn)
+            begin, end = lb.def_get_begin(defn), lb.def_get_end(defn)
+            # The definitions of basic blocks without a label are empty
+            check(begin == end
+                  or code[begin:end] == lb.entity_get_tag(defined),
+                  '{}: definition at {} is {!r}, not {}'.format(
+                      name, begin, code[begin:end],
+                      lb.entity_get_tag(defined)))
+            defs.add(begin)
+    return len(uses), len(defs)
@@ -0,0 +1,15 @@
+; Calls a function that is defined in two.ll
+source_filename = "main.c"
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@total = external dso_local global i32, align 4
+
+declare dso_local i32 @add(i32, i32)
+
+define dso_local i32 @main() {
+entry:
+  %r = call i32 @add(i32 1, i32 2)
+  store i32 %r, i32* @total, align 4
+  ret i32 0
+}
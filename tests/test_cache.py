@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+
+# Usage: test_cache.py <module.ll> <cache dir>
+#
+# Checks that the link cache is used when it matches the module and that a
+# cache file that is truncated, corrupt or was saved with other options is
+# ignored and replaced
+
+import glob
+import os
+import shutil
+import struct
+import sys
+
+# The cache directory must be set before the module is imported
+os.environ['XDG_CACHE_HOME'] = sys.argv[2]
+
+import llvm_browse as lb  # NOQA: E402
+from common import check, check_links, load  # NOQA: E402
+
+# The layout of the cache file. See LinkCache.cpp
+HEADER = struct.Struct('<8sIIQQQIIQQQ')
+RECORD = struct.Struct('<IIQQ')
+PASSES = 5
+NUM_USES = 10
+
+
+def load_cached(path: str, name: str, expected, **kwargs):
+    module = load(path, use_cache=True, **kwargs)
+    links = check_links(module, name)
+    check(links == expected,
+          '{}: found {} links, not {}'.format(name, links, expected))
+    lb.module_free(module)
+
+
+def read(path: str) -> bytes:
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def write(path: str, contents: bytes):
+    with open(path, 'wb') as f:
+        f.write(contents)
+
+
+def patch_header(contents: bytes, field: int, value: int) -> bytes:
+    header = list(HEADER.unpack_from(contents))
+    header[field] = value
+    return HEADER.pack(*header) + contents[HEADER.size:]
+
+
+def check_cache(text_ll: str, cache_dir: str):
+    shutil.rmtree(cache_dir, ignore_errors=True)
+    module = load(text_ll)
+    expected = check_links(module, 'uncached')
+    lb.module_free(module)
+
+    load_cached(text_ll, 'saved', expected)
+    files = glob.glob(os.path.join(cache_dir, 'llvm-browse', '*.lbc'))
+    check(len(files) == 1, 'saved {} cache files, not 1'.format(len(files)))
+    path = files[0]
+    saved = read(path)
+    header = HEADER.unpack_from(saved)
+    check(len(saved) == HEADER.size + RECORD.size * sum(header[-3:]),
+          'cache file is {} bytes'.format(len(saved)))
+    check(header[PASSES] == 0, 'cache was saved with a pipeline')
+
+    load_cached(text_ll, 'loaded', expected)
+    check(read(path) == saved, 'cache was changed when it was loaded')
+
+    # Every one of these must be ignored and the file saved again once the
+    # module has been linked as usual
+    num_uses = header[NUM_USES]
+    end = bytearray(saved)
+    for offset in range(HEADER.size, len(saved), RECORD.size):
+        RECORD.pack_into(end, offset, *RECORD.unpack_from(saved, offset)[:3],
+                         1 << 40)
+    for name, contents in [
+            ('empty', b''),
+            ('truncated header', saved[:HEADER.size - 1]),
+            ('truncated records', saved[:-RECORD.size]),
+            ('trailing bytes', saved + b'\0'),
+            ('bad magic', b'X' + saved[1:]),
+            ('too many uses', patch_header(saved, NUM_USES, num_uses + 1)),
+            ('overflowing uses', patch_header(saved, NUM_USES, 1 << 63)),
+            ('past the end', bytes(end)),
+            ('pipeline', patch_header(saved, PASSES, 1))]:
+        write(path, contents)
+        load_cached(text_ll, name, expected)
+        check(read(path) == saved, '{}: cache was not saved again'.format(name))
+
+    # The cache for a module printed in canonical mode is kept apart. If it
+    # is replaced with the one for the module as it is in the file, it must
+    # not be used for the canonical one
+    module = load(text_ll, canonical=True)
+    canonical = check_links(module, 'canonical')
+    lb.module_free(module)
+    load_cached(text_ll, 'canonical saved', canonical, canonical=True)
+    canonical_path = os.path.splitext(path)[0] + '.c.lbc'
+    check(os.path.exists(canonical_path), 'canonical cache was not saved')
+    canonical_saved = read(canonical_path)
+    shutil.copyfile(path, canonical_path)
+    load_cached(text_ll, 'canonical mismatch', canonical, canonical=True)
+    check(read(canonical_path) == canonical_saved,
+          'canonical mismatch: cache was not saved again')
+
+
+if __name__ == '__main__':
+    check_cache(sys.argv[1], sys.argv[2])
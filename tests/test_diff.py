@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+
+# Usage: test_diff.py <module.ll>
+#
+# Checks the diff of a module against itself and against a copy in which
+# one instruction of one function was edited
+
+import sys
+import llvm_browse as lb
+from common import check, load
+
+
+def tags(pairs, get_tag):
+    return [(None if lb.is_null_handle(left) else get_tag(left),
+             None if lb.is_null_handle(right) else get_tag(right),
+             kind)
+            for left, right, kind in pairs]
+
+
+def check_diff(text_ll: str):
+    left = load(text_ll)
+    code = lb.module_get_code(left)
+    begin = code.index('%new = add') + len('%new = ')
+    right = lb.module_edit(left, begin, begin + len('add'), 'sub')
+    check(not lb.is_null_handle(right), 'could not edit module')
+
+    for num_threads in [1, 4]:
+        diff = lb.diff_create(left, left, num_threads)
+        check(lb.diff_get_stats(diff) == (0, 0, 0),
+              'same: stats are {}'.format(lb.diff_get_stats(diff)))
+        functions = tags(lb.diff_get_functions(diff), lb.func_get_tag)
+        check(functions == [('@square', '@square', 'Same'),
+                            ('@add', '@add', 'Same')],
+              'same: functions are {}'.format(functions))
+        lb.diff_free(diff)
+
+        diff = lb.diff_create(left, right, num_threads)
+        check(lb.diff_get_stats(diff) == (1, 0, 0),
+              'edited: stats are {}'.format(lb.diff_get_stats(diff)))
+        functions = lb.diff_get_functions(diff)
+        check(tags(functions, lb.func_get_tag)
+              == [('@square', '@square', 'Same'),
+                  ('@add', '@add', 'Changed')],
+              'edited: functions are {}'.format(
+                  tags(functions, lb.func_get_tag)))
+        add_left, add_right, _ = functions[1]
+        check(not lb.diff_is_renamed(diff, add_left), 'edited: @add renamed')
+        check(lb.diff_get_counterpart(diff, add_left) == add_right,
+              'edited: wrong counterpart of @add')
+        check(lb.diff_get_counterpart(diff, add_right) == add_left,
+              'edited: wrong counterpart of @add')
+
+        blocks = tags(lb.diff_get_blocks(diff, add_left), lb.block_get_tag)
+        check(blocks == [('%entry', '%entry', 'Same'),
+                         ('%then', '%then', 'Same'),
+                         ('%done', '%done', 'Changed')],
+              'edited: blocks are {}'.format(blocks))
+
+        # The instructions that use the edited one are changed too
+        insts = tags(lb.diff_get_instructions(diff, add_left),
+                     lb.inst_get_tag)
+        check([kind for _, _, kind in insts]
+              == ['Same'] * 8 + ['Changed'] * 3,
+              'edited: instructions are {}'.format(insts))
+        check(insts[8][:2] == ('%new', '%new'),
+              'edited: instructions are {}'.format(insts))
+        lb.diff_free(diff)
+
+    lb.module_free(right)
+    lb.module_free(left)
+
+
+if __name__ == '__main__':
+    check_diff(sys.argv[1])
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+
+# Usage: test_dump.py <log>
+#
+# Checks the snapshots found in a log written by opt -print-after-all for
+# function(instcombine,simplifycfg) on two.ll and the modules loaded from
+# them
+
+import sys
+import llvm_browse as lb
+from common import check, check_links
+
+
+def check_dump(log: str):
+    dump = lb.dump_create(log)
+    check(dump is not None, 'could not read {}'.format(log))
+
+    snapshots = lb.dump_get_snapshots(dump)
+    check(snapshots == [('After', 'VerifierPass', '[module]', False),
+                        ('After', 'InstCombinePass', 'square', False),
+                        ('After', 'SimplifyCFGPass', 'square', False),
+                        ('After', 'InstCombinePass', 'add', False),
+                        ('After', 'SimplifyCFGPass', 'add', False),
+                        ('After', 'VerifierPass', '[module]', False)],
+          'snapshots are {}'.format(snapshots))
+    for pass_name, expected in [('InstCombinePass', [1, 3]),
+                                ('SimplifyCFGPass', [2, 4]),
+                                ('VerifierPass', [0, 5]),
+                                ('GVNPass', [])]:
+        indices = lb.dump_get_snapshots_for_pass(dump, pass_name)
+        check(indices == expected,
+              'snapshots for {} are {}'.format(pass_name, indices))
+    for tag, expected in [('@square', [0, 1, 2, 5]),
+                          ('@add', [0, 3, 4, 5]),
+                          ('@sum', [])]:
+        indices = lb.dump_get_snapshots_for_function(dump, tag)
+        check(indices == expected,
+              'snapshots for {} are {}'.format(tag, indices))
+
+    # Only @add is changed by instcombine, which folds the getelementptr
+    # into the store
+    modules = []
+    for i in range(len(snapshots)):
+        previous = modules[-1] if modules else lb.get_null_handle()
+        module = lb.dump_load(dump, i, previous)
+        check(not lb.is_null_handle(module),
+              'could not load snapshot {}'.format(i))
+        check_links(module, 'snapshot {}'.format(i))
+        functions = [lb.func_get_tag(f)
+                     for f in lb.module_get_functions(module)]
+        check(functions == ['@square', '@add'],
+              'snapshot {}: functions are {}'.format(i, functions))
+        folded = 'getelementptr inbounds (' in lb.module_get_code(module)
+        check(folded == (i >= 3),
+              'snapshot {}: getelementptr folded is {}'.format(i, folded))
+        modules.append(module)
+    check(lb.is_null_handle(lb.dump_load(dump, len(snapshots))),
+          'loaded a snapshot past the end')
+
+    for i, (stats, kinds) in enumerate([((0, 0, 0), ['Same', 'Same']),
+                                        ((0, 0, 0), ['Same', 'Same']),
+                                        ((1, 0, 0), ['Same', 'Changed']),
+                                        ((0, 0, 0), ['Same', 'Same']),
+                                        ((0, 0, 0), ['Same', 'Same'])]):
+        diff = lb.diff_create(modules[i], modules[i + 1])
+        check(lb.diff_get_stats(diff) == stats,
+              'snapshots {} and {}: stats are {}'.format(
+                  i, i + 1, lb.diff_get_stats(diff)))
+        functions = [kind for _, _, kind in lb.diff_get_functions(diff)]
+        check(functions == kinds,
+              'snapshots {} and {}: functions are {}'.format(
+                  i, i + 1, functions))
+        lb.diff_free(diff)
+
+    for module in modules:
+        lb.module_free(module)
+    lb.dump_free(dump)
+
+
+if __name__ == '__main__':
+    check_dump(sys.argv[1])
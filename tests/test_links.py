@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+
+# Usage: test_links.py <module.ll> <module.bc> <cache dir>
+#
+# Checks that the uses and definitions found with every combination of load
+# options match the text of the IR
+
+import os
+import sys
+
+# The cache directory must be set before the module is imported
+os.environ['XDG_CACHE_HOME'] = sys.argv[3]
+
+import llvm_browse as lb  # NOQA: E402
+from common import check, check_links, load  # NOQA: E402
+
+
+def check_text(text_ll: str, text_bc: str):
+    # With the default options, the IR in the file is shown as it is, so
+    # every other option that doesn't print it again must find the same links
+    module = load(text_ll)
+    expected = check_links(module, 'default')
+    check(all(expected), 'default: found {} links'.format(expected))
+    lb.module_free(module)
+
+    for name, kwargs in [('threads', {'num_threads': 4}),
+                         ('eager_metadata', {'eager_metadata': True}),
+                         ('lazy', {'lazy_functions': True}),
+                         ('lazy_threads', {'lazy_functions': True,
+                                           'num_threads': 4})]:
+        module = load(text_ll, **kwargs)
+        links = check_links(module, name)
+        check(links == expected,
+              '{}: found {} links, not {}'.format(name, links, expected))
+        lb.module_free(module)
+
+    # The cache is written the first time and read the second
+    for i in range(2):
+        module = load(text_ll, use_cache=True)
+        links = check_links(module, 'use_cache {}'.format(i))
+        check(links == expected,
+              'use_cache {}: found {} links, not {}'.format(
+                  i, links, expected))
+        lb.module_free(module)
+
+    # The IR is printed by LLVM in canonical mode and for bitcode, so the
+    # links are different but there should be as many
+    module = load(text_ll, canonical=True)
+    canonical = check_links(module, 'canonical')
+    canonical_code = lb.module_get_code(module)
+    lb.module_free(module)
+
+    module = load(text_bc)
+    bitcode = check_links(module, 'bitcode')
+    bitcode_code = lb.module_get_code(module)
+    lb.module_free(module)
+    check(canonical == bitcode,
+          'canonical: found {} links, not {}'.format(canonical, bitcode))
+
+    # Only IR that was printed by LLVM can be printed again, so a virtual
+    # document must have the same text as the one that was kept
+    for name, path, kwargs, code, expected in [
+            ('canonical_virtual', text_ll,
+             {'canonical': True, 'virtual_document': True},
+             canonical_code, canonical),
+            ('virtual_document', text_bc, {'virtual_document': True},
+             bitcode_code, bitcode)]:
+        module = load(path, **kwargs)
+        check(lb.module_is_virtual(module), '{}: not virtual'.format(name))
+        links = check_links(module, name)
+        check(links == expected,
+              '{}: found {} links, not {}'.format(name, links, expected))
+        check(lb.module_get_code(module) == code,
+              '{}: code differs from the IR that was kept'.format(name))
+        lb.module_free(module)
+
+    # The bodies are read one at a time. Once they all have been, the module
+    # should have as many links as one that was read in full. The metadata
+    # nodes are numbered in the order in which the bodies are read, so the
+    # text is only the same if they are read in the order of the module
+    for name, kwargs, ordered in [
+            ('lazy_bitcode', {'lazy_bitcode': True}, True),
+            ('lazy_bitcode_reversed', {'lazy_bitcode': True}, False),
+            ('lazy_bitcode_virtual', {'lazy_bitcode': True,
+                                      'virtual_document': True}, True),
+            ('lazy_bitcode_virtual_reversed', {'lazy_bitcode': True,
+                                               'virtual_document': True},
+             False)]:
+        # Only the declarations of the functions have been read, so there
+        # are no uses yet
+        module = load(text_bc, **kwargs)
+        check(check_links(module, name)[0] == 0,
+              '{}: found uses before any body was read'.format(name))
+        functions = lb.module_get_functions(module)
+        for f in functions if ordered else reversed(functions):
+            tag = lb.func_get_tag(f)
+            check(not lb.func_is_body_read(f),
+                  '{}: {} was read'.format(name, tag))
+            check(lb.module_read_body(module, f),
+                  '{}: could not read {}'.format(name, tag))
+            check(lb.func_is_body_read(f),
+                  '{}: {} was not read'.format(name, tag))
+            check(lb.module_read_body(module, f),
+                  '{}: could not read {} again'.format(name, tag))
+            check_links(module, '{} {}'.format(name, tag))
+        links = check_links(module, name)
+        check(links == bitcode,
+              '{}: found {} links, not {}'.format(name, links, bitcode))
+        if ordered:
+            check(lb.module_get_code(module) == bitcode_code,
+                  '{}: code differs from bitcode'.format(name))
+        lb.module_free(module)
+
+
+if __name__ == '__main__':
+    check_text(sys.argv[1], sys.argv[2])
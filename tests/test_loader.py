@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+
+# Usage: test_loader.py <module.ll> <module.bc> <scratch dir>
+#
+# Checks that modules loaded in the background, reloaded after the file
+# changed and produced by running passes are linked correctly
+
+import os
+import sys
+import time
+import llvm_browse as lb
+from common import check, check_links, load
+
+
+def wait(loader) -> int:
+    while not lb.loader_is_done(loader):
+        phase, done, total = lb.loader_get_progress(loader)
+        check(total == 0 or done <= total,
+              '{}: done {} of {}'.format(phase, done, total))
+        time.sleep(0.01)
+    module = lb.loader_take_module(loader)
+    lb.loader_free(loader)
+    return module
+
+
+def check_loader(text_ll: str, text_bc: str, scratch: str):
+    module = load(text_ll)
+    expected = check_links(module, 'module')
+    code = lb.module_get_code(module)
+    lb.module_free(module)
+
+    module = wait(lb.loader_create(text_ll))
+    check(not lb.is_null_handle(module), 'loader: could not load')
+    check(check_links(module, 'loader') == expected,
+          'loader: wrong number of links')
+    check(lb.module_get_code(module) == code, 'loader: code differs')
+
+    # Only @add changes, so @square is copied from the previous module
+    os.makedirs(scratch, exist_ok=True)
+    path = os.path.join(scratch, 'reloaded.ll')
+    with open(path, 'w') as f:
+        f.write(code.replace('%new = add nsw', '%new = sub nsw'))
+    module = wait(lb.loader_reload(module, path))
+    check(not lb.is_null_handle(module), 'reload: could not load')
+    check(check_links(module, 'reload') == expected,
+          'reload: wrong number of links')
+    check('%new = sub nsw' in lb.module_get_code(module),
+          'reload: not reloaded')
+    lb.module_free(module)
+
+    missing = wait(lb.loader_create(os.path.join(scratch, 'missing.ll')))
+    check(lb.is_null_handle(missing), 'loader: loaded a missing file')
+
+    # instcombine folds the getelementptr in @add into the store. The bodies
+    # of a module read lazily from bitcode are read before the passes run
+    for name, path, kwargs in [('passes', text_ll, {}),
+                               ('passes lazy_bitcode', text_bc,
+                                {'lazy_bitcode': True})]:
+        module = load(path, **kwargs)
+        optimized = lb.module_run_passes(module, 'function(instcombine)')
+        check(not lb.is_null_handle(optimized),
+              '{}: could not run passes'.format(name))
+        check_links(optimized, name)
+        check('getelementptr inbounds (' in lb.module_get_code(optimized),
+              '{}: getelementptr was not folded'.format(name))
+        check(all(lb.func_is_body_read(f)
+                  for f in lb.module_get_functions(optimized)),
+              '{}: not all bodies were read'.format(name))
+        lb.module_free(optimized)
+        check(lb.is_null_handle(lb.module_run_passes(module, 'no-such-pass')),
+              '{}: ran an invalid pipeline'.format(name))
+        lb.module_free(module)
+
+
+if __name__ == '__main__':
+    check_loader(sys.argv[1], sys.argv[2], sys.argv[3])
@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+
+# Usage: test_project.py <two.ll> <main.ll> <two.bc> <main.bc>
+#
+# Checks that a symbol declared in one module of a project is resolved to
+# its definition in another, whether the modules are loaded up front or
+# only indexed
+
+import sys
+import llvm_browse as lb
+from common import check
+
+
+def get_used(module: int, text: str) -> int:
+    code = lb.module_get_code(module)
+    use = lb.module_get_use_at(module, code.index(text) + 1)
+    check(not lb.is_null_handle(use), 'no use at {!r}'.format(text))
+    return lb.use_get_used(use)
+
+
+def get_text(module: int, use: int) -> str:
+    code = lb.module_get_code(module)
+    return code[lb.use_get_begin(use):lb.use_get_end(use)]
+
+
+def check_project(name: str, project, indexed: bool):
+    check(project is not None, '{}: could not create project'.format(name))
+    check(lb.project_get_num_files(project) == 2,
+          '{}: {} files'.format(name, lb.project_get_num_files(project)))
+    loaded = [lb.project_is_loaded(project, i) for i in range(2)]
+    check(loaded == [not indexed] * 2,
+          '{}: loaded is {}'.format(name, loaded))
+
+    main = lb.project_get_module(project, 1)
+    check(not lb.is_null_handle(main), '{}: could not load main'.format(name))
+    loaded = [lb.project_is_loaded(project, i) for i in range(2)]
+    check(loaded == [not indexed, True],
+          '{}: loaded is {}'.format(name, loaded))
+
+    # The definition is looked up in the index, which loads the module that
+    # it is in
+    decl = get_used(main, '@add(i32 1')
+    defn = lb.project_get_definition(project, decl)
+    check(defn is not None, '{}: @add is not defined'.format(name))
+    two, add = defn
+    check(two == lb.project_get_module(project, 0),
+          '{}: @add is defined in the wrong module'.format(name))
+    check(lb.project_is_loaded(project, 0),
+          '{}: two is not loaded'.format(name))
+    check(lb.is_function(add) and lb.func_get_tag(add) == '@add'
+          and lb.func_get_blocks(add),
+          '{}: wrong definition of @add'.format(name))
+
+    uses = [(module == main, get_text(module, use))
+            for module, use in lb.project_get_uses(project, add)]
+    check(uses == [(True, '@add')],
+          '{}: uses of @add are {}'.format(name, uses))
+
+    total = get_used(main, '@total,')
+    defn = lb.project_get_definition(project, total)
+    check(defn is not None and defn[0] == two,
+          '{}: wrong definition of @total'.format(name))
+    uses = [(module == main, get_text(module, use))
+            for module, use in lb.project_get_uses(project, total)]
+    check(sorted(uses) == [(False, '@total'),
+                           (False, '@total'),
+                           (True, '@total')],
+          '{}: uses of @total are {}'.format(name, uses))
+
+    # A symbol that is only used where it is defined resolves to itself
+    square = get_used(two, '@square(i32 %a')
+    defn = lb.project_get_definition(project, square)
+    check(defn is not None and defn == (two, square),
+          '{}: wrong definition of @square'.format(name))
+    lb.project_free(project)
+
+
+if __name__ == '__main__':
+    two_ll, main_ll, two_bc, main_bc = sys.argv[1:5]
+    check_project('create', lb.project_create([two_ll, main_ll]), False)
+    check_project('create threads',
+                  lb.project_create([two_ll, main_ll], 2), False)
+    check_project('index', lb.project_index([two_ll, main_ll]), True)
+    check_project('index bitcode', lb.project_index([two_bc, main_bc]), True)
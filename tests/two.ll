@@ -0,0 +1,59 @@
+; Two functions that between them use every kind of entity that is linked
+source_filename = "two.c"
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+%struct.pair = type { i32, i32 }
+
+$square = comdat any
+
+@total = dso_local global i32 0, align 4
+@origin = dso_local global %struct.pair zeroinitializer, align 4
+@sum = dso_local alias i32 (i32, i32), i32 (i32, i32)* @add
+
+define linkonce_odr dso_local i32 @square(i32 %x) #0 comdat !dbg !7 {
+entry:
+  %mul = mul nsw i32 %x, %x, !dbg !11
+  ret i32 %mul, !dbg !12
+}
+
+define dso_local i32 @add(i32 %a, i32 %b) #0 !dbg !13 {
+entry:
+  %cmp = icmp sgt i32 %a, %b, !dbg !14
+  br i1 %cmp, label %then, label %done, !dbg !14, !prof !16
+
+then:
+  %sq = call i32 @square(i32 %a) #1, !dbg !15
+  %p = getelementptr inbounds %struct.pair, %struct.pair* @origin, i32 0, i32 1
+  store i32 %sq, i32* %p, align 4
+  br label %done
+
+done:
+  %r = phi i32 [ %sq, %then ], [ %b, %entry ]
+  %old = load i32, i32* @total, align 4
+  %new = add nsw i32 %old, %r
+  store i32 %new, i32* @total, align 4
+  ret i32 %new
+}
+
+attributes #0 = { noinline nounwind }
+attributes #1 = { nounwind readnone }
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!3, !4}
+!llvm.ident = !{!5}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug, enums: !2)
+!1 = !DIFile(filename: "two.c", directory: "/tmp")
+!2 = !{}
+!3 = !{i32 7, !"Dwarf Version", i32 4}
+!4 = !{i32 2, !"Debug Info Version", i32 3}
+!5 = !{!"clang"}
+!6 = !DISubroutineType(types: !2)
+!7 = distinct !DISubprogram(name: "square", scope: !1, file: !1, line: 1, type: !6, scopeLine: 1, spFlags: DISPFlagDefinition, unit: !0, retainedNodes: !2)
+!11 = !DILocation(line: 2, column: 12, scope: !7)
+!12 = !DILocation(line: 2, column: 3, scope: !7)
+!13 = distinct !DISubprogram(name: "add", scope: !1, file: !1, line: 5, type: !6, scopeLine: 5, spFlags: DISPFlagDefinition, unit: !0, retainedNodes: !2)
+!14 = !DILocation(line: 6, column: 9, scope: !13)
+!15 = !DILocation(line: 7, column: 10, scope: !13)
+!16 = !{!"branch_weights", i32 1, i32 3}